@@ -0,0 +1,160 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+
+namespace sis {
+
+double Benchmark::Measurement::throughput() const {
+    return (medianTime > 0.0) ? work / (medianTime / 1000.0) : 0.0;
+}
+
+Benchmark::Benchmark() :
+    Benchmark(1, 5) {
+}
+
+Benchmark::Benchmark(const int numWarmups, const int numRepetitions) :
+    _numWarmups(std::max(numWarmups, 0)),
+    _numRepetitions(std::max(numRepetitions, 1)),
+    _measurements() {
+}
+
+void Benchmark::run(const std::string&             name,
+                    const std::string&             unit,
+                    const std::function<double()>& function) {
+
+    for (int i = 0; i < _numWarmups; ++i) {
+        function();
+    }
+
+    std::vector<double> times(_numRepetitions);
+    double              work = 0.0;
+    for (int i = 0; i < _numRepetitions; ++i) {
+        const auto beginTime = std::chrono::steady_clock::now();
+        work = function();
+        const auto endTime = std::chrono::steady_clock::now();
+
+        times[i] = std::chrono::duration<double, std::milli>(endTime - beginTime).count();
+    }
+
+    Measurement measurement;
+    measurement.name           = name;
+    measurement.unit           = unit;
+    measurement.work           = work;
+    measurement.numRepetitions = _numRepetitions;
+
+    std::sort(times.begin(), times.end());
+    const int middle = _numRepetitions / 2;
+    measurement.minTime    = times.front();
+    measurement.medianTime = (_numRepetitions % 2 == 1) ?
+                             times[middle] :
+                             0.5 * (times[middle - 1] + times[middle]);
+
+    double sumTime  = 0.0;
+    double sumTime2 = 0.0;
+    for (auto& time : times) {
+        sumTime  += time;
+        sumTime2 += time * time;
+    }
+    measurement.meanTime   = sumTime / _numRepetitions;
+    measurement.stddevTime = std::sqrt(std::max(sumTime2 / _numRepetitions -
+                                                measurement.meanTime * measurement.meanTime, 0.0));
+
+    std::cout << "    " << std::left << std::setw(48) << name << std::right
+              << std::fixed << std::setprecision(2)
+              << std::setw(10) << measurement.medianTime << " ms"
+              << " (+- " << measurement.stddevTime << ")"
+              << std::setw(12) << measurement.throughput() << " " << unit << "/s"
+              << std::endl;
+
+    _measurements.push_back(measurement);
+}
+
+const std::vector<Benchmark::Measurement>& Benchmark::measurements() const {
+    return _measurements;
+}
+
+bool Benchmark::writeBaseline(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file) {
+        return false;
+    }
+
+    // one case per line, so compareBaseline only needs line matching
+    file << std::setprecision(6)
+         << "{\n  \"cases\": [";
+    for (std::size_t i = 0; i < _measurements.size(); ++i) {
+        const Measurement& measurement = _measurements[i];
+
+        file << (i == 0 ? "\n" : ",\n")
+             << "    {\"name\": \"" << measurement.name << "\""
+             << ", \"unit\": \"" << measurement.unit << "/s\""
+             << ", \"throughput\": " << measurement.throughput()
+             << ", \"work\": " << measurement.work
+             << ", \"repetitions\": " << measurement.numRepetitions
+             << ", \"min\": " << measurement.minTime
+             << ", \"median\": " << measurement.medianTime
+             << ", \"mean\": " << measurement.meanTime
+             << ", \"stddev\": " << measurement.stddevTime
+             << "}";
+    }
+    file << "\n  ]\n}\n";
+
+    return static_cast<bool>(file);
+}
+
+int Benchmark::compareBaseline(const std::string& filename, const float threshold) const {
+    std::ifstream file(filename);
+    if (!file) {
+        return -1;
+    }
+
+    std::map<std::string, double> baselineThroughputs;
+
+    const std::regex caseRegex("\"name\": \"([^\"]*)\".*\"throughput\": ([-+0-9.eE]+)");
+    std::string      line;
+    while (std::getline(file, line)) {
+        std::smatch match;
+        if (std::regex_search(line, match, caseRegex)) {
+            baselineThroughputs[match[1].str()] = std::stod(match[2].str());
+        }
+    }
+
+    std::cout << "# Compare with baseline: " << filename
+              << " (regression threshold: " << threshold * 100.0f << "%)"
+              << std::endl;
+
+    int numRegressions = 0;
+    for (const auto& measurement : _measurements) {
+        const auto& baseline = baselineThroughputs.find(measurement.name);
+        if (baseline == baselineThroughputs.end() || baseline->second <= 0.0) {
+            std::cout << "    " << std::left << std::setw(48) << measurement.name << std::right
+                      << "   (no baseline)"
+                      << std::endl;
+
+            continue;
+        }
+
+        const double ratio       = measurement.throughput() / baseline->second;
+        const bool   isRegressed = ratio < 1.0 - threshold;
+        if (isRegressed) {
+            ++numRegressions;
+        }
+
+        std::cout << "    " << std::left << std::setw(48) << measurement.name << std::right
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(8) << (ratio - 1.0) * 100.0 << "%"
+                  << (isRegressed ? "   REGRESSION" : "")
+                  << std::endl;
+    }
+
+    return numRegressions;
+}
+
+} // namespace sis
\ No newline at end of file
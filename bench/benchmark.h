@@ -0,0 +1,60 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sis {
+
+/*
+    Benchmark runs each case several times after warm-up runs,
+    and keeps statistics of run times (in milliseconds).
+
+    A case function returns its amount of work of one run
+    (ex. megapixels, features or matches), so throughput is
+    work per second of the median run time.
+
+    Measurements can be written as a JSON baseline, and a later
+    run can be compared against it, a case regresses if its
+    throughput is lower than (1 - threshold) x baseline's.
+
+    Case functions are timed with their output, stages they run
+    should log to a muted Logger.
+*/
+class Benchmark {
+public:
+    struct Measurement {
+        std::string name;
+        std::string unit;
+        double      work;
+        int         numRepetitions;
+        double      minTime;
+        double      medianTime;
+        double      meanTime;
+        double      stddevTime;
+
+        double throughput() const;
+    };
+
+    Benchmark();
+    Benchmark(const int numWarmups, const int numRepetitions);
+
+    void run(const std::string&             name,
+             const std::string&             unit,
+             const std::function<double()>& function);
+
+    const std::vector<Measurement>& measurements() const;
+
+    bool writeBaseline(const std::string& filename) const;
+
+    // returns number of regressed cases, or -1 if baseline can't be read
+    int compareBaseline(const std::string& filename, const float threshold) const;
+
+private:
+    int _numWarmups;
+    int _numRepetitions;
+
+    std::vector<Measurement> _measurements;
+};
+
+} // namespace sis
\ No newline at end of file
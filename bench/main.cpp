@@ -0,0 +1,500 @@
+#include "benchmark.h"
+
+#include "bundleAdjuster/levenbergMarquardtBundleAdjuster.h"
+#include "core/logger.h"
+#include "core/taskScheduler.h"
+#include "exposureCompensator/gainExposureCompensator.h"
+#include "featureDescriptor/siftFeatureDescriptor.h"
+#include "featureDetector/harrisFeatureDetector.h"
+#include "featureMatcher/bruteForceFeatureMatcher.h"
+#include "imageBlender/linearAlphaImageBlender.h"
+#include "imageBlender/multiBandImageBlender.h"
+#include "imageBlender/seamImageBlender.h"
+#include "imageMatcher/phaseCorrelationImageMatcher.h"
+#include "imageMatcher/prosacImageMatcher.h"
+#include "imageMatcher/ransacImageMatcher.h"
+#include "imageWarpper/cylindricalImageWarpper.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if (defined(_MSC_VER) || \
+     (defined(__GNUC__) && (__GNUC_MAJOR__ >= 8)))
+#include <filesystem>
+    namespace std_fs = std::filesystem;
+#else
+    #include <experimental/filesystem>
+    namespace std_fs = std::experimental::filesystem;
+#endif
+
+#ifndef BENCH_DATA_DIRECTORY
+#define BENCH_DATA_DIRECTORY "./data"
+#endif
+
+using namespace sis;
+
+namespace {
+
+struct Dataset {
+    std::string          name;
+    std::vector<cv::Mat> images;
+    std::vector<float>   focalLengths;
+};
+
+/*
+    Outputs of the whole pipeline at one scale ratio,
+    each stage case takes its inputs from here
+*/
+struct StageInputs {
+    std::vector<cv::Mat>                          images;
+    std::vector<cv::Mat>                          warpImages;
+    std::vector<cv::Mat>                          warpImageIndices;
+    std::vector<std::vector<cv::Point>>           featurePositions;
+    std::vector<std::vector<std::vector<float>>>  featureDescriptors;
+    std::vector<std::vector<std::pair<int, int>>> featureMatchings;
+    std::vector<ImageAlignment>                   pairAlignments;
+    std::vector<ImageAlignment>                   imageAlignments;
+    std::vector<float>                            imageGains;
+};
+
+// stages log their progress and warnings, they are dropped while benchmarking
+const Logger& mutedLogger() {
+    static const Logger logger(nullptr, nullptr);
+
+    return logger;
+}
+
+std::vector<std::string> split(const std::string& string) {
+    std::vector<std::string> tokens;
+    std::stringstream        stream(string);
+    std::string              token;
+    while (std::getline(stream, token, ',')) {
+        if (!token.empty()) {
+            tokens.push_back(token);
+        }
+    }
+
+    return tokens;
+}
+
+bool readDataset(const std::string& directory, const std::string& name, Dataset* const out_dataset) {
+    std::ifstream focalLengthFile(directory + "/" + name + "/focal-length.txt");
+    if (!focalLengthFile) {
+        return false;
+    }
+
+    Dataset& dataset = *out_dataset;
+    dataset.name = name;
+
+    std::string line;
+    while (std::getline(focalLengthFile, line)) {
+        if (!line.empty()) {
+            dataset.focalLengths.push_back(static_cast<float>(std::stold(line)));
+        }
+    }
+
+    std::vector<std::string> imageFilenames;
+    for (const auto& entry : std_fs::directory_iterator(directory + "/" + name + "/image")) {
+        imageFilenames.push_back(entry.path().string());
+    }
+    std::sort(imageFilenames.begin(), imageFilenames.end());
+
+    for (const auto& imageFilename : imageFilenames) {
+        dataset.images.push_back(cv::imread(imageFilename));
+    }
+
+    return !dataset.images.empty() && dataset.images.size() == dataset.focalLengths.size();
+}
+
+double countMegapixels(const std::vector<cv::Mat>& images) {
+    double numPixels = 0.0;
+    for (auto& image : images) {
+        numPixels += static_cast<double>(image.total());
+    }
+
+    return numPixels / 1e6;
+}
+
+double countFeatures(const std::vector<std::vector<cv::Point>>& featurePositions) {
+    double numFeatures = 0.0;
+    for (auto& positions : featurePositions) {
+        numFeatures += static_cast<double>(positions.size());
+    }
+
+    return numFeatures;
+}
+
+double countMatchings(const std::vector<std::vector<std::pair<int, int>>>& featureMatchings) {
+    double numMatchings = 0.0;
+    for (auto& matchings : featureMatchings) {
+        numMatchings += static_cast<double>(matchings.size());
+    }
+
+    return numMatchings;
+}
+
+// per-image (or per-pair) calls run as tasks, the same way ImageStitcher aligns images
+void runTasks(const int numThreads, const int numTasks, const std::function<void(const int)>& function) {
+    TaskScheduler scheduler(numThreads);
+    for (int k = 0; k < numTasks; ++k) {
+        scheduler.addTask(std::to_string(k), [&function, k]() {
+            function(k);
+        });
+    }
+
+    scheduler.run();
+}
+
+void prepareInputs(const Dataset& dataset, const float sizeRatio, StageInputs* const out_inputs) {
+    StageInputs& inputs = *out_inputs;
+
+    for (auto& image : dataset.images) {
+        cv::Mat resizeImage;
+        cv::resize(image, resizeImage,
+                   cv::Size(static_cast<int>(image.cols * sizeRatio), static_cast<int>(image.rows * sizeRatio)),
+                   0.0, 0.0, cv::INTER_LINEAR);
+        inputs.images.push_back(resizeImage);
+    }
+
+    CylindricalImageWarpper          imageWarpper;
+    HarrisFeatureDetector            featureDetector;
+    SiftFeatureDescriptor            featureDescriptor;
+    BruteForceFeatureMatcher         featureMatcher;
+    RansacImageMatcher               imageMatcher;
+    LevenbergMarquardtBundleAdjuster bundleAdjuster;
+    GainExposureCompensator          exposureCompensator;
+    imageWarpper.setLogger(&mutedLogger());
+    featureDetector.setLogger(&mutedLogger());
+    featureDescriptor.setLogger(&mutedLogger());
+    featureMatcher.setLogger(&mutedLogger());
+    imageMatcher.setLogger(&mutedLogger());
+    bundleAdjuster.setLogger(&mutedLogger());
+    exposureCompensator.setLogger(&mutedLogger());
+
+    imageWarpper.warp(inputs.images, dataset.focalLengths, &inputs.warpImages, &inputs.warpImageIndices);
+    featureDetector.detect(inputs.warpImages, &inputs.featurePositions);
+    featureDescriptor.calculate(inputs.warpImages, inputs.featurePositions, &inputs.featureDescriptors);
+    featureMatcher.match(inputs.warpImages, inputs.featurePositions,
+                         inputs.featureDescriptors, &inputs.featureMatchings);
+    imageMatcher.match(inputs.warpImages, inputs.featurePositions,
+                       inputs.featureMatchings, &inputs.pairAlignments);
+    bundleAdjuster.adjust(inputs.warpImages, inputs.featurePositions, inputs.featureMatchings,
+                          inputs.pairAlignments, &inputs.imageAlignments);
+    exposureCompensator.compensate(inputs.warpImages, inputs.imageAlignments,
+                                   inputs.warpImageIndices, &inputs.imageGains);
+}
+
+void runStageCases(const Dataset&     dataset,
+                   const StageInputs& inputs,
+                   const std::string& suffix,
+                   const int          numThreads,
+                   const std::string& filter,
+                   Benchmark* const   benchmark) {
+
+    const int numImages = static_cast<int>(inputs.warpImages.size());
+    const int numPairs  = numImages - 1;
+
+    const auto runCase = [&](const std::string& stage, const std::string& unit, const std::function<double()>& function) {
+        const std::string name = stage + " " + dataset.name + suffix;
+        if (name.find(filter) != std::string::npos) {
+            benchmark->run(name, unit, function);
+        }
+    };
+
+    // per-image stages
+
+    CylindricalImageWarpper imageWarpper;
+    imageWarpper.setLogger(&mutedLogger());
+    runCase("warp/cylindrical", "MP", [&]() {
+        runTasks(numThreads, numImages, [&](const int k) {
+            std::vector<cv::Mat> warpImages;
+            std::vector<cv::Mat> warpImageIndices;
+            imageWarpper.warp({ inputs.images[k] }, { dataset.focalLengths[k] }, &warpImages, &warpImageIndices);
+        });
+
+        return countMegapixels(inputs.images);
+    });
+
+    HarrisFeatureDetector featureDetector;
+    featureDetector.setLogger(&mutedLogger());
+    runCase("detect/harris", "MP", [&]() {
+        runTasks(numThreads, numImages, [&](const int k) {
+            std::vector<std::vector<cv::Point>> featurePositions;
+            featureDetector.detect({ inputs.warpImages[k] }, &featurePositions);
+        });
+
+        return countMegapixels(inputs.warpImages);
+    });
+
+    SiftFeatureDescriptor featureDescriptor;
+    featureDescriptor.setLogger(&mutedLogger());
+    runCase("describe/sift", "features", [&]() {
+        runTasks(numThreads, numImages, [&](const int k) {
+            std::vector<std::vector<std::vector<float>>> featureDescriptors;
+            featureDescriptor.calculate({ inputs.warpImages[k] }, { inputs.featurePositions[k] }, &featureDescriptors);
+        });
+
+        return countFeatures(inputs.featurePositions);
+    });
+
+    // per-pair stages
+
+    BruteForceFeatureMatcher featureMatcher;
+    featureMatcher.setLogger(&mutedLogger());
+    runCase("match/brute-force", "matches", [&]() {
+        runTasks(numThreads, numPairs, [&](const int k) {
+            std::vector<std::vector<std::pair<int, int>>> featureMatchings;
+            featureMatcher.match({ inputs.warpImages[k], inputs.warpImages[k + 1] },
+                                 { inputs.featurePositions[k], inputs.featurePositions[k + 1] },
+                                 { inputs.featureDescriptors[k], inputs.featureDescriptors[k + 1] },
+                                 &featureMatchings);
+        });
+
+        return countMatchings(inputs.featureMatchings);
+    });
+
+    const std::vector<std::pair<std::string, std::shared_ptr<ImageMatcher>>> imageMatchers = {
+        { "ransac",            std::make_shared<RansacImageMatcher>() },
+        { "prosac-affine",     std::make_shared<ProsacImageMatcher>(ProsacImageMatcher::Model::AFFINE) },
+        { "prosac-homography", std::make_shared<ProsacImageMatcher>(ProsacImageMatcher::Model::HOMOGRAPHY) },
+        { "phase",             std::make_shared<PhaseCorrelationImageMatcher>() }
+    };
+    for (const auto& imageMatcher : imageMatchers) {
+        imageMatcher.second->setLogger(&mutedLogger());
+
+        const bool isFeatureBased = imageMatcher.second->isFeatureBased();
+
+        runCase("align/" + imageMatcher.first, isFeatureBased ? "matches" : "MP", [&]() {
+            runTasks(numThreads, numPairs, [&](const int k) {
+                const std::vector<std::vector<cv::Point>> featurePositions = isFeatureBased ?
+                    std::vector<std::vector<cv::Point>>{ inputs.featurePositions[k], inputs.featurePositions[k + 1] } :
+                    std::vector<std::vector<cv::Point>>();
+                const std::vector<std::vector<std::pair<int, int>>> featureMatchings = isFeatureBased ?
+                    std::vector<std::vector<std::pair<int, int>>>{ inputs.featureMatchings[k] } :
+                    std::vector<std::vector<std::pair<int, int>>>();
+
+                std::vector<ImageAlignment> imageAlignments;
+                imageMatcher.second->match({ inputs.warpImages[k], inputs.warpImages[k + 1] },
+                                           featurePositions, featureMatchings, &imageAlignments);
+            });
+
+            return isFeatureBased ? countMatchings(inputs.featureMatchings) : countMegapixels(inputs.warpImages);
+        });
+    }
+
+    // whole-panorama stages, they only use threads of cv::parallel_for_
+
+    cv::setNumThreads(numThreads);
+
+    LevenbergMarquardtBundleAdjuster bundleAdjuster;
+    bundleAdjuster.setLogger(&mutedLogger());
+    runCase("adjust/levenberg-marquardt", "matches", [&]() {
+        std::vector<ImageAlignment> imageAlignments;
+        bundleAdjuster.adjust(inputs.warpImages, inputs.featurePositions, inputs.featureMatchings,
+                              inputs.pairAlignments, &imageAlignments);
+
+        return countMatchings(inputs.featureMatchings);
+    });
+
+    GainExposureCompensator exposureCompensator;
+    exposureCompensator.setLogger(&mutedLogger());
+    runCase("compensate/gain", "MP", [&]() {
+        std::vector<float> imageGains;
+        exposureCompensator.compensate(inputs.warpImages, inputs.imageAlignments,
+                                       inputs.warpImageIndices, &imageGains);
+
+        return countMegapixels(inputs.warpImages);
+    });
+
+    const std::vector<std::pair<std::string, std::shared_ptr<ImageBlender>>> imageBlenders = {
+        { "linear-alpha", std::make_shared<LinearAlphaImageBlender>() },
+        { "multiband",    std::make_shared<MultiBandImageBlender>() },
+        { "seam",         std::make_shared<SeamImageBlender>() }
+    };
+    for (const auto& imageBlender : imageBlenders) {
+        imageBlender.second->setLogger(&mutedLogger());
+
+        runCase("blend/" + imageBlender.first, "MP", [&]() {
+            cv::Mat panorama;
+            imageBlender.second->blend(inputs.warpImages, inputs.imageAlignments, inputs.warpImageIndices,
+                                       inputs.imageGains, true, &panorama);
+
+            return static_cast<double>(panorama.total()) / 1e6;
+        });
+    }
+
+    cv::setNumThreads(-1);
+}
+
+void printHelpMessage() {
+    std::cout << R"(Image-Stitching benchmark
+
+Runs each stage implementation in isolation over the bundled datasets
+(grail, parrington), at each scale ratio and thread count. Each case is
+warmed up, repeated, and reported with its median time and throughput.
+
+Options:
+    -h             Print this help text.
+
+    -d    <dir>    Specify data directory which has grail/ and parrington/.
+
+                   default: <the repo's data directory>
+
+    -scl  <list>   Specify comma-separated scale ratios of input images.
+
+                   default: <0.5,1.0>
+
+    -t    <list>   Specify comma-separated thread counts.
+
+                   default: <1,number of hardware threads>
+
+    -w    <num>    Specify number of warm-up runs of each case.
+
+                   default: <1>
+
+    -r    <num>    Specify number of timed repetitions of each case.
+
+                   default: <5>
+
+    -f    <text>   Only run cases whose name contains text.
+
+    -o    <file>   Write measurements as JSON baseline.
+
+    -b    <file>   Compare throughput with JSON baseline, the exit code is 1
+                   if any case regresses.
+
+    -th   <ratio>  Specify regression threshold of -b comparison.
+
+                   default: <0.1> (10% lower throughput)
+)";
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    std::string dataDirectory    = BENCH_DATA_DIRECTORY;
+    std::string sizeRatios       = "0.5,1.0";
+    std::string threadCounts     = "1," + std::to_string(std::max(static_cast<int>(std::thread::hardware_concurrency()), 1));
+    std::string filter           = "";
+    std::string outputFilename   = "";
+    std::string baselineFilename = "";
+    int         numWarmups       = 1;
+    int         numRepetitions   = 5;
+    float       threshold        = 0.1f;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if (argument == "-h") {
+            printHelpMessage();
+
+            return EXIT_SUCCESS;
+        }
+
+        if (i + 1 >= argc) {
+            std::cout << "Missing value of option: " << argument
+                      << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        const std::string value = argv[++i];
+        if (argument == "-d") {
+            dataDirectory = value;
+        }
+        else if (argument == "-scl") {
+            sizeRatios = value;
+        }
+        else if (argument == "-t") {
+            threadCounts = value;
+        }
+        else if (argument == "-w") {
+            numWarmups = std::stoi(value);
+        }
+        else if (argument == "-r") {
+            numRepetitions = std::stoi(value);
+        }
+        else if (argument == "-f") {
+            filter = value;
+        }
+        else if (argument == "-o") {
+            outputFilename = value;
+        }
+        else if (argument == "-b") {
+            baselineFilename = value;
+        }
+        else if (argument == "-th") {
+            threshold = std::stof(value);
+        }
+        else {
+            std::cout << "Unknown option: " << argument
+                      << std::endl;
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    Benchmark benchmark(numWarmups, numRepetitions);
+
+    for (const std::string name : { "grail", "parrington" }) {
+        Dataset dataset;
+        if (!readDataset(dataDirectory, name, &dataset)) {
+            std::cout << "# Skip dataset " << name << ", it can't be read from " << dataDirectory
+                      << std::endl;
+
+            continue;
+        }
+
+        for (const auto& sizeRatio : split(sizeRatios)) {
+            const float safeSizeRatio = std::min(std::max(std::stof(sizeRatio), 0.1f), 1.0f);
+
+            // pipeline outputs are prepared once
+            StageInputs inputs;
+            prepareInputs(dataset, safeSizeRatio, &inputs);
+
+            for (const auto& threadCount : split(threadCounts)) {
+                const int numThreads = std::max(std::stoi(threadCount), 1);
+
+                std::cout << "# Benchmark " << name << " (" << dataset.images.size() << " images)"
+                          << " at scale ratio " << sizeRatio << " with " << numThreads << " threads"
+                          << std::endl;
+
+                runStageCases(dataset, inputs, " x" + sizeRatio + " t" + std::to_string(numThreads),
+                              numThreads, filter, &benchmark);
+            }
+        }
+    }
+
+    if (!outputFilename.empty()) {
+        if (benchmark.writeBaseline(outputFilename)) {
+            std::cout << "# Write baseline: " << outputFilename
+                      << std::endl;
+        }
+        else {
+            std::cout << "Cannot write baseline file: " << outputFilename
+                      << std::endl;
+        }
+    }
+
+    if (!baselineFilename.empty()) {
+        const int numRegressions = benchmark.compareBaseline(baselineFilename, threshold);
+        if (numRegressions < 0) {
+            std::cout << "Cannot read baseline file: " << baselineFilename
+                      << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "# Total " << numRegressions << " regressed cases"
+                  << std::endl;
+
+        return (numRegressions > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
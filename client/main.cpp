@@ -0,0 +1,170 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+    stitch-client sends requests to a daemon (Image-Stitching -daemon <path>)
+    and prints events of its jobs, one JSON object per line. It returns once
+    every stitch job it requested is finished, failed or cancelled, and with
+    failure if any of them isn't finished (or a request is invalid).
+
+    Requests are arguments, or lines of stdin without request arguments.
+    Closing the client (ex. Ctrl-C) cancels its jobs.
+*/
+
+namespace {
+
+void printHelpMessage() {
+    std::cout << R"(stitch-client <socket path> [<request> ...]
+
+Send JSON requests to an Image-Stitching daemon and print events of the requested jobs.
+Without request arguments, requests are read from stdin, one per line.
+For example:
+stitch-client /tmp/image-stitching.sock '{"type": "stitch", "id": "grail", "imageDirectory": "./data/grail/image", "focalLengthFilename": "./data/grail/focal-length.txt", "outputFilename": "grail.png"}'
+stitch-client /tmp/image-stitching.sock '{"type": "cancel", "id": "grail"}'
+stitch-client /tmp/image-stitching.sock '{"type": "shutdown"}'
+)";
+}
+
+bool hasField(const std::string& object, const std::string& key, const std::string& value) {
+    const std::string field = "\"" + key + "\": \"" + value + "\"";
+    const std::string compactField = "\"" + key + "\":\"" + value + "\"";
+
+    return object.find(field) != std::string::npos ||
+           object.find(compactField) != std::string::npos;
+}
+
+bool sendAll(const int socket, const std::string& data) {
+    std::size_t offset = 0;
+    while (offset < data.size()) {
+        const ssize_t size = ::send(socket, data.data() + offset, data.size() - offset, 0);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            return false;
+        }
+
+        offset += static_cast<std::size_t>(size);
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || std::string(argv[1]) == "-h") {
+        printHelpMessage();
+
+        return (argc < 2) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    const std::string socketPath(argv[1]);
+
+    std::vector<std::string> requests(argv + 2, argv + argc);
+    if (requests.empty()) {
+        std::string request;
+        while (std::getline(std::cin, request)) {
+            if (request.find_first_not_of(" \t\r") != std::string::npos) {
+                requests.push_back(request);
+            }
+        }
+    }
+
+    sockaddr_un address = {};
+    address.sun_family  = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cout << "Daemon socket path is too long: " << socketPath
+                  << std::endl;
+
+        return EXIT_FAILURE;
+    }
+    socketPath.copy(address.sun_path, socketPath.size());
+
+    const int socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket < 0 ||
+        ::connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+
+        std::cout << "Daemon can't connect: " << socketPath << " (" << std::strerror(errno) << ")"
+                  << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    // each stitch request ends with one event, and an invalid request with an error
+    int numWaitingJobs = 0;
+    for (const auto& request : requests) {
+        if (!sendAll(socket, request + "\n")) {
+            std::cout << "Daemon disconnects"
+                      << std::endl;
+            ::close(socket);
+
+            return EXIT_FAILURE;
+        }
+
+        if (hasField(request, "type", "stitch")) {
+            ++numWaitingJobs;
+        }
+    }
+
+    bool isFailed = false;
+
+    std::string buffer;
+    char        data[4096];
+    while (numWaitingJobs > 0) {
+        const ssize_t size = ::recv(socket, data, sizeof(data), 0);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            std::cout << "Daemon disconnects"
+                      << std::endl;
+            isFailed = true;
+
+            break;
+        }
+        buffer.append(data, static_cast<std::size_t>(size));
+
+        std::size_t lineEnd;
+        while ((lineEnd = buffer.find('\n')) != std::string::npos) {
+            const std::string event = buffer.substr(0, lineEnd);
+            buffer.erase(0, lineEnd + 1);
+
+            std::cout << event
+                      << std::endl;
+
+            if (hasField(event, "event", "finished")) {
+                --numWaitingJobs;
+            }
+            else if (hasField(event, "event", "failed")    ||
+                     hasField(event, "event", "cancelled")) {
+                --numWaitingJobs;
+                isFailed = true;
+            }
+            else if (hasField(event, "event", "error")) {
+                isFailed = true;
+
+                // a rejected stitch request has no job to wait for, and
+                // requests of an invalid one are unknown, so it stops
+                if (hasField(event, "request", "stitch")) {
+                    --numWaitingJobs;
+                }
+                else if (!hasField(event, "request", "cancel")) {
+                    numWaitingJobs = 0;
+                }
+            }
+        }
+    }
+
+    ::close(socket);
+
+    return isFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
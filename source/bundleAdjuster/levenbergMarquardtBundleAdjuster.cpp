@@ -0,0 +1,433 @@
+#include "bundleAdjuster/levenbergMarquardtBundleAdjuster.h"
+
+#include "mathUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace sis {
+
+LevenbergMarquardtBundleAdjuster::LevenbergMarquardtBundleAdjuster() :
+    LevenbergMarquardtBundleAdjuster(100, 2.0f) {
+}
+
+LevenbergMarquardtBundleAdjuster::LevenbergMarquardtBundleAdjuster(
+    const int   maxIterations,
+    const float huberThreshold) :
+
+    _maxIterations(maxIterations),
+    _huberThreshold(huberThreshold) {
+}
+
+void LevenbergMarquardtBundleAdjuster::_adjustImpl(
+    const std::vector<cv::Mat>&                          images,
+    const std::vector<std::vector<cv::Point>>&           featurePositions,
+    const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+    const std::vector<ImageAlignment>&                   imageAlignments,
+    std::vector<ImageAlignment>* const                   out_adjustedAlignments) const {
+
+    _log().progress() << "# Begin to do bundle adjustment using Levenberg-Marquardt"
+                      << std::endl;
+
+    const int  numImages = static_cast<int>(images.size());
+    const int  numPairs  = numImages - 1;
+    const bool isClosed  = numImages > 2 && static_cast<int>(imageAlignments.size()) == numImages;
+
+    std::vector<cv::Point2d> centers;
+    centers.reserve(numImages);
+    for (auto& image : images) {
+        centers.push_back(cv::Point2d(image.cols * 0.5, image.rows * 0.5));
+    }
+
+    /*
+        Initial parameters come from accumulated pairwise transforms,
+        translation is the movement of image center, and rotation and
+        scale are read from the movement of a unit x-vector
+    */
+    std::vector<double> params(4 * numPairs + (isClosed ? 1 : 0), 0.0);
+
+    cv::Matx33d accumulateTransform = cv::Matx33d::eye();
+    for (int n = 1; n < numImages; ++n) {
+        accumulateTransform = accumulateTransform * imageAlignments[n - 1].transform;
+
+        const cv::Point2f center(centers[n]);
+        const cv::Point2d moveCenter(mathUtils::transformPoint(accumulateTransform, center));
+        const cv::Point2d moveUnitX(mathUtils::transformPoint(accumulateTransform, center + cv::Point2f(1.0f, 0.0f)));
+        const cv::Point2d unitX = moveUnitX - moveCenter;
+
+        double* imageParams = &params[4 * (n - 1)];
+        imageParams[0] = moveCenter.x - centers[n].x;
+        imageParams[1] = moveCenter.y - centers[n].y;
+        imageParams[2] = std::atan2(unitX.y, unitX.x);
+        imageParams[3] = std::sqrt(unitX.x * unitX.x + unitX.y * unitX.y);
+    }
+
+    /*
+        Panorama width of closed sweep is where the first image
+        is seen again from the last image
+    */
+    if (isClosed) {
+        const cv::Point2d firstCenter(mathUtils::transformPoint(imageAlignments[numPairs].transform,
+                                                                cv::Point2f(centers[0])));
+
+        params.back() = _transformPoint(params, numPairs, centers[numPairs], firstCenter).x - centers[0].x;
+    }
+
+    std::vector<Correspondence> correspondences;
+    _collectCorrespondences(images, featurePositions, featureMatchings, imageAlignments, &correspondences);
+
+    const double initialCost = _calculateCost(correspondences, centers, params);
+    _solve(correspondences, centers, &params);
+    const double finalCost = _calculateCost(correspondences, centers, params);
+
+    _log().progress() << "    Using " << correspondences.size() << " correspondences"
+                      << (isClosed ? ", with loop closure" : "")
+                      << std::endl
+                      << "    Cost: " << initialCost << " -> " << finalCost
+                      << std::endl;
+
+    if (isClosed) {
+        _log().progress() << "    Panorama width of 360 degrees: " << params.back()
+                          << std::endl;
+    }
+
+    /*
+        Rotation and scale which move image corners less than half
+        a pixel are dropped, and translation is rounded, so such
+        images are placed without any resampling while blending
+    */
+    for (int n = 1; n < numImages; ++n) {
+        double*      imageParams = &params[4 * (n - 1)];
+        const double radius      = std::sqrt(centers[n].x * centers[n].x + centers[n].y * centers[n].y);
+
+        if (std::abs(imageParams[2]) * radius < 0.5 &&
+            std::abs(imageParams[3] - 1.0) * radius < 0.5) {
+
+            imageParams[0] = std::round(imageParams[0]);
+            imageParams[1] = std::round(imageParams[1]);
+            imageParams[2] = 0.0;
+            imageParams[3] = 1.0;
+        }
+    }
+
+    /*
+        Pairwise transform is G_n^-1 * G_n+1, residual of each
+        pair is the mean transfer error after adjustment
+    */
+    std::vector<double> sumErrors(numPairs, 0.0);
+    std::vector<int>    numErrors(numPairs, 0);
+    for (auto& correspondence : correspondences) {
+        if (correspondence.isLoop) {
+            continue;
+        }
+
+        const cv::Point2d diff =
+            _transformPoint(params, correspondence.image1, centers[correspondence.image1], correspondence.point1) -
+            _transformPoint(params, correspondence.image2, centers[correspondence.image2], correspondence.point2);
+
+        sumErrors[correspondence.image1] += std::sqrt(diff.x * diff.x + diff.y * diff.y);
+        ++numErrors[correspondence.image1];
+    }
+
+    std::vector<ImageAlignment> adjustedAlignments;
+    adjustedAlignments.reserve(numPairs);
+    for (int n = 0; n < numPairs; ++n) {
+        ImageAlignment alignment = imageAlignments[n];
+        alignment.transform = _getTransform(params, n, centers[n]).inv() *
+                              _getTransform(params, n + 1, centers[n + 1]);
+        alignment.residual  = (numErrors[n] > 0) ? static_cast<float>(sumErrors[n] / numErrors[n]) : 0.0f;
+        alignment.updateTranslation(images[n].cols, images[n + 1].size());
+
+        adjustedAlignments.push_back(alignment);
+    }
+
+    *out_adjustedAlignments = adjustedAlignments;
+
+    _log().progress() << "# Finish bundle adjustment"
+                      << std::endl;
+}
+
+void LevenbergMarquardtBundleAdjuster::_collectCorrespondences(
+    const std::vector<cv::Mat>&                          images,
+    const std::vector<std::vector<cv::Point>>&           featurePositions,
+    const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+    const std::vector<ImageAlignment>&                   imageAlignments,
+    std::vector<Correspondence>* const                   out_correspondences) const {
+
+    const int numImages = static_cast<int>(images.size());
+
+    const float inlierThreshold = 3.0f;
+    const int   minInliers      = 6;
+
+    for (int k = 0; k < static_cast<int>(imageAlignments.size()); ++k) {
+        const bool isLoop = (k == numImages - 1);
+        const int  image1 = k;
+        const int  image2 = isLoop ? 0 : k + 1;
+
+        const cv::Matx33d& transform = imageAlignments[k].transform;
+
+        /*
+            Matchings agreeing with pairwise transform are inliers
+
+            Remain: matching (3, 10) means image2's feature 3
+                    matches image1's feature 10
+        */
+        std::vector<Correspondence> pairCorrespondences;
+        if (k < static_cast<int>(featureMatchings.size())) {
+            for (auto& matching : featureMatchings[k]) {
+                const cv::Point2f point1(featurePositions[image1][matching.second]);
+                const cv::Point2f point2(featurePositions[image2][matching.first]);
+
+                const cv::Point2f diff = mathUtils::transformPoint(transform, point2) - point1;
+                if (diff.x * diff.x + diff.y * diff.y < inlierThreshold * inlierThreshold) {
+                    pairCorrespondences.push_back({ image1, image2, point1, point2, isLoop });
+                }
+            }
+        }
+
+        /*
+            Pairs without enough inliers (ex. feature-free imageMatcher,
+            or re-aligned at another scale) use a grid of points
+            in overlapping region mapped by pairwise transform
+        */
+        if (static_cast<int>(pairCorrespondences.size()) < minInliers) {
+            pairCorrespondences.clear();
+
+            const cv::Size& size2        = images[image2].size();
+            const int       overlapWidth = std::min(std::max(-imageAlignments[k].translation.x, 1), size2.width);
+            for (int gy = 0; gy < 3; ++gy) {
+                for (int gx = 0; gx < 3; ++gx) {
+                    const cv::Point2f point2((gx + 0.5f) / 3.0f * overlapWidth,
+                                             (0.2f + 0.3f * gy) * size2.height);
+                    const cv::Point2f point1 = mathUtils::transformPoint(transform, point2);
+
+                    pairCorrespondences.push_back({ image1, image2, point1, point2, isLoop });
+                }
+            }
+        }
+
+        out_correspondences->insert(out_correspondences->end(),
+                                    pairCorrespondences.begin(), pairCorrespondences.end());
+    }
+}
+
+double LevenbergMarquardtBundleAdjuster::_calculateCost(
+    const std::vector<Correspondence>& correspondences,
+    const std::vector<cv::Point2d>&    centers,
+    const std::vector<double>&         params) const {
+
+    /*
+        Huber cost, it is robust to remaining outliers
+
+        rho(e) = e^2 / 2           , e <= delta
+                 delta * (e - delta / 2), otherwise
+    */
+    const double delta = _huberThreshold;
+
+    double cost = 0.0;
+    for (auto& correspondence : correspondences) {
+        cv::Point2d residual =
+            _transformPoint(params, correspondence.image1, centers[correspondence.image1], correspondence.point1) -
+            _transformPoint(params, correspondence.image2, centers[correspondence.image2], correspondence.point2);
+        if (correspondence.isLoop) {
+            residual.x -= params.back();
+        }
+
+        const double error = std::sqrt(residual.x * residual.x + residual.y * residual.y);
+        cost += (error <= delta) ? 0.5 * error * error : delta * (error - 0.5 * delta);
+    }
+
+    return cost;
+}
+
+void LevenbergMarquardtBundleAdjuster::_solve(
+    const std::vector<Correspondence>& correspondences,
+    const std::vector<cv::Point2d>&    centers,
+    std::vector<double>* const         out_params) const {
+
+    std::vector<double>& params = *out_params;
+    const int numParams = static_cast<int>(params.size());
+    if (numParams == 0) {
+        return;
+    }
+
+    const double delta = _huberThreshold;
+
+    double lambda    = 1e-3;
+    double cost      = _calculateCost(correspondences, centers, params);
+    bool   isUpdated = true;
+
+    cv::Mat H;
+    cv::Mat g;
+    int     numIterations = 0;
+    for (int iteration = 0; iteration < _maxIterations; ++iteration) {
+        ++numIterations;
+
+        /*
+            Build normal equations H = J^T W J and g = J^T W r
+            (W: Huber weights), each residual only has non-zero
+            Jacobian on parameters of its two images (and panorama
+            width for the closing pair)
+        */
+        if (isUpdated) {
+            H = cv::Mat::zeros(numParams, numParams, CV_64FC1);
+            g = cv::Mat::zeros(numParams, 1, CV_64FC1);
+
+            for (auto& correspondence : correspondences) {
+                int    columns[9];
+                double jacobian[2][9];
+                int    numColumns = 0;
+
+                cv::Point2d residual(0.0, 0.0);
+                const auto addImage = [&](const int n, const cv::Point2d& point, const double sign) {
+                    const cv::Point2d movePoint = _transformPoint(params, n, centers[n], point);
+                    residual += movePoint * sign;
+
+                    // the first image is fixed
+                    if (n == 0) {
+                        return;
+                    }
+
+                    /*
+                        d = p - c
+                        dG/dt     = I
+                        dG/dtheta = s * R'(theta) * d
+                        dG/ds     = R(theta) * d
+                    */
+                    const double*     imageParams = &params[4 * (n - 1)];
+                    const double      cosTheta    = std::cos(imageParams[2]);
+                    const double      sinTheta    = std::sin(imageParams[2]);
+                    const double      s           = imageParams[3];
+                    const cv::Point2d d           = point - centers[n];
+
+                    const double dTheta[2] = { s * (-sinTheta * d.x - cosTheta * d.y),
+                                               s * ( cosTheta * d.x - sinTheta * d.y) };
+                    const double dScale[2] = { cosTheta * d.x - sinTheta * d.y,
+                                               sinTheta * d.x + cosTheta * d.y };
+
+                    const double values[2][4] = { { 1.0, 0.0, dTheta[0], dScale[0] },
+                                                  { 0.0, 1.0, dTheta[1], dScale[1] } };
+                    for (int i = 0; i < 4; ++i) {
+                        columns[numColumns]     = 4 * (n - 1) + i;
+                        jacobian[0][numColumns] = sign * values[0][i];
+                        jacobian[1][numColumns] = sign * values[1][i];
+                        ++numColumns;
+                    }
+                };
+
+                addImage(correspondence.image1, correspondence.point1,  1.0);
+                addImage(correspondence.image2, correspondence.point2, -1.0);
+                if (correspondence.isLoop) {
+                    residual.x -= params.back();
+
+                    columns[numColumns]     = numParams - 1;
+                    jacobian[0][numColumns] = -1.0;
+                    jacobian[1][numColumns] = 0.0;
+                    ++numColumns;
+                }
+
+                const double error  = std::sqrt(residual.x * residual.x + residual.y * residual.y);
+                const double weight = (error <= delta) ? 1.0 : delta / error;
+
+                for (int a = 0; a < numColumns; ++a) {
+                    g.at<double>(columns[a], 0) += weight * (jacobian[0][a] * residual.x + jacobian[1][a] * residual.y);
+
+                    for (int b = 0; b < numColumns; ++b) {
+                        H.at<double>(columns[a], columns[b]) +=
+                            weight * (jacobian[0][a] * jacobian[0][b] + jacobian[1][a] * jacobian[1][b]);
+                    }
+                }
+            }
+        }
+
+        /*
+            Damped step (H + lambda * diag(H)) * step = -g,
+            a tiny constant keeps unconstrained parameters solvable
+        */
+        cv::Mat A = H.clone();
+        for (int i = 0; i < numParams; ++i) {
+            A.at<double>(i, i) += lambda * H.at<double>(i, i) + 1e-9;
+        }
+
+        cv::Mat step;
+        if (!cv::solve(A, -g, step, cv::DECOMP_CHOLESKY)) {
+            lambda   *= 10.0;
+            isUpdated = false;
+
+            continue;
+        }
+
+        std::vector<double> newParams(params);
+        for (int i = 0; i < numParams; ++i) {
+            newParams[i] += step.at<double>(i, 0);
+        }
+
+        const double newCost = _calculateCost(correspondences, centers, newParams);
+        if (newCost < cost) {
+            const bool isConverged = (cost - newCost) < 1e-6 * cost;
+
+            params    = newParams;
+            cost      = newCost;
+            lambda    = std::max(lambda * 0.1, 1e-9);
+            isUpdated = true;
+
+            if (isConverged) {
+                break;
+            }
+        }
+        else {
+            lambda   *= 10.0;
+            isUpdated = false;
+
+            if (lambda > 1e8) {
+                break;
+            }
+        }
+    }
+
+    profiler::count("lm iterations", numIterations);
+}
+
+cv::Point2d LevenbergMarquardtBundleAdjuster::_transformPoint(
+    const std::vector<double>& params,
+    const int                  n,
+    const cv::Point2d&         center,
+    const cv::Point2d&         point) const {
+
+    if (n == 0) {
+        return point;
+    }
+
+    const double*     imageParams = &params[4 * (n - 1)];
+    const double      cosTheta    = std::cos(imageParams[2]);
+    const double      sinTheta    = std::sin(imageParams[2]);
+    const double      s           = imageParams[3];
+    const cv::Point2d d           = point - center;
+
+    return cv::Point2d(s * (cosTheta * d.x - sinTheta * d.y) + center.x + imageParams[0],
+                       s * (sinTheta * d.x + cosTheta * d.y) + center.y + imageParams[1]);
+}
+
+cv::Matx33d LevenbergMarquardtBundleAdjuster::_getTransform(
+    const std::vector<double>& params,
+    const int                  n,
+    const cv::Point2d&         center) const {
+
+    if (n == 0) {
+        return cv::Matx33d::eye();
+    }
+
+    /*
+        G = translate(c + t) * [s * R(theta)] * translate(-c)
+    */
+    const double* imageParams = &params[4 * (n - 1)];
+    const double  a           = imageParams[3] * std::cos(imageParams[2]);
+    const double  b           = imageParams[3] * std::sin(imageParams[2]);
+
+    return cv::Matx33d(a, -b, center.x + imageParams[0] - (a * center.x - b * center.y),
+                       b,  a, center.y + imageParams[1] - (b * center.x + a * center.y),
+                       0.0, 0.0, 1.0);
+}
+
+} // namespace sis
\ No newline at end of file
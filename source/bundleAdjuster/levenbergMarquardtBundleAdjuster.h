@@ -0,0 +1,91 @@
+#pragma once
+
+#include "core/bundleAdjuster.h"
+
+namespace sis {
+
+/*
+    LevenbergMarquardtBundleAdjuster jointly optimizes parameters of
+    every image with Levenberg-Marquardt over all pairwise matchings.
+
+    Each image n is placed on the panorama by
+
+        G_n(p) = s_n * R(theta_n) * (p - c_n) + c_n + t_n
+
+    t_n: translation, theta_n: rotation (roll), s_n: scale (focal length
+    error), c_n: image center, and the first image is fixed.
+
+    Residuals are transfer errors of inlier matchings (pairs without
+    enough inliers use points sampled by their pairwise transform),
+    and each residual only touches two images, so normal equations
+    are accumulated from sparse Jacobian blocks.
+
+    For a closed (360 degrees) sweep, the closing pair is added with
+    an unknown panorama width, so drifting is distributed around the
+    loop. Remaining vertical drifting of open sweeps is corrected by
+    imageBlender while compositing.
+*/
+class LevenbergMarquardtBundleAdjuster : public BundleAdjuster {
+public:
+    LevenbergMarquardtBundleAdjuster();
+    LevenbergMarquardtBundleAdjuster(const int maxIterations, const float huberThreshold);
+
+private:
+    void _adjustImpl(
+        const std::vector<cv::Mat>&                          images,
+        const std::vector<std::vector<cv::Point>>&           featurePositions,
+        const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+        const std::vector<ImageAlignment>&                   imageAlignments,
+        std::vector<ImageAlignment>* const                   out_adjustedAlignments) const override;
+
+    /*
+        A point correspondence between image1 and image2,
+        for the closing pair, image1 is the last image and
+        image2 is the first one
+    */
+    struct Correspondence {
+        int         image1;
+        int         image2;
+        cv::Point2d point1;
+        cv::Point2d point2;
+        bool        isLoop;
+    };
+
+    void _collectCorrespondences(
+        const std::vector<cv::Mat>&                          images,
+        const std::vector<std::vector<cv::Point>>&           featurePositions,
+        const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+        const std::vector<ImageAlignment>&                   imageAlignments,
+        std::vector<Correspondence>* const                   out_correspondences) const;
+
+    /*
+        Parameters of image n (n > 0) are
+        params[4(n-1) ... 4(n-1)+3] = (tx, ty, theta, s),
+        and panorama width is the last one for closed sweep
+    */
+    double _calculateCost(
+        const std::vector<Correspondence>& correspondences,
+        const std::vector<cv::Point2d>&    centers,
+        const std::vector<double>&         params) const;
+
+    void _solve(
+        const std::vector<Correspondence>& correspondences,
+        const std::vector<cv::Point2d>&    centers,
+        std::vector<double>* const         out_params) const;
+
+    cv::Point2d _transformPoint(
+        const std::vector<double>& params,
+        const int                  n,
+        const cv::Point2d&         center,
+        const cv::Point2d&         point) const;
+
+    cv::Matx33d _getTransform(
+        const std::vector<double>& params,
+        const int                  n,
+        const cv::Point2d&         center) const;
+
+    int   _maxIterations;
+    float _huberThreshold;
+};
+
+} // namespace sis
\ No newline at end of file
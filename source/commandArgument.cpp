@@ -5,6 +5,11 @@
 
 namespace sis {
 
+CommandArgument::CommandArgument() :
+    _isHelpMessageRequested(false),
+    _arguments() {
+}
+
 CommandArgument::CommandArgument(int argc, char* argv[]) :
     _isHelpMessageRequested(false),
     _arguments() {
@@ -19,6 +24,12 @@ CommandArgument::CommandArgument(int argc, char* argv[]) :
         else if (argument == "-scl") {
             _arguments.insert(std::make_pair("sizeRatio", std::string(argv[i])));
         }
+        else if (argument == "-o") {
+            _arguments.insert(std::make_pair("outputFilename", std::string(argv[i])));
+        }
+        else if (argument == "-rscl") {
+            _arguments.insert(std::make_pair("realignSizeRatio", std::string(argv[i])));
+        }
         else if (argument == "-iw") {
             _arguments.insert(std::make_pair("imageWarpper", std::string(argv[i])));
         }
@@ -34,12 +45,54 @@ CommandArgument::CommandArgument(int argc, char* argv[]) :
         else if (argument == "-im") {
             _arguments.insert(std::make_pair("imageMatcher", std::string(argv[i])));
         }
+        else if (argument == "-ec") {
+            _arguments.insert(std::make_pair("exposureCompensator", std::string(argv[i])));
+        }
         else if (argument == "-ib") {
             _arguments.insert(std::make_pair("imageBlender", std::string(argv[i])));
         }
         else if (argument == "-ba") {
             _arguments.insert(std::make_pair("bundleAdjuster", std::string(argv[i])));
         }
+        else if (argument == "-crop") {
+            _arguments.insert(std::make_pair("autoCrop", std::string(argv[i])));
+        }
+        else if (argument == "-sw") {
+            _arguments.insert(std::make_pair("slidingWindow", std::string(argv[i])));
+        }
+        else if (argument == "-t" || argument == "--threads") {
+            _arguments.insert(std::make_pair("numThreads", std::string(argv[i])));
+        }
+        else if (argument == "-dbg") {
+            _arguments.insert(std::make_pair("debugImages", std::string(argv[i])));
+        }
+        else if (argument == "-cache") {
+            _arguments.insert(std::make_pair("featureCache", std::string(argv[i])));
+        }
+        else if (argument == "-cp") {
+            _arguments.insert(std::make_pair("cacheImagePairs", std::string(argv[i])));
+        }
+        else if (argument == "-pool") {
+            _arguments.insert(std::make_pair("bufferPoolSize", std::string(argv[i])));
+        }
+        else if (argument == "-trace") {
+            _arguments.insert(std::make_pair("traceFilename", std::string(argv[i])));
+        }
+        else if (argument == "-sum") {
+            _arguments.insert(std::make_pair("summaryFilename", std::string(argv[i])));
+        }
+        else if (argument == "-batch") {
+            _arguments.insert(std::make_pair("batchManifest", std::string(argv[i])));
+        }
+        else if (argument == "-j") {
+            _arguments.insert(std::make_pair("maxConcurrentJobs", std::string(argv[i])));
+        }
+        else if (argument == "-mem") {
+            _arguments.insert(std::make_pair("jobMemoryBudget", std::string(argv[i])));
+        }
+        else if (argument == "-daemon") {
+            _arguments.insert(std::make_pair("daemonSocket", std::string(argv[i])));
+        }
     }
 
     _arguments.insert(std::make_pair("imageDirectory", std::string(argv[argc - 2])));
@@ -59,6 +112,10 @@ const std::string CommandArgument::find(const std::string& key,
     }
 }
 
+void CommandArgument::insert(const std::string& key, const std::string& value) {
+    _arguments[key] = value;
+}
+
 bool CommandArgument::isHelpMessageRequested() const {
     return _isHelpMessageRequested;
 }
@@ -72,14 +129,34 @@ Notice you need to specify images 'directory path' and focal length 'file path'.
 For example:
 Image-Stitching ./IMAGES/ ./FOCAL_LENGTH.txt
 
+Or stitch many panoramas listed in a manifest file:
+Image-Stitching -batch ./JOBS.txt
+
+Or serve stitching jobs (JSON requests) of local clients:
+Image-Stitching -daemon /tmp/image-stitching.sock
+
 Options:
     -h             Print this help text.
 
+    -o    <file>   Specify output panorama filename.
+                   With <.tif> or <.tiff> extension, panorama is blended and
+                   written strip by strip as tiled TIFF (streaming mode).
+
+                   default: <./result/panorama_result.png>
+
     -scl  <ratio>  Specify scale ratio of input images used in image stitching.
                    Ratio range is from <0.1> to <1.0>                 
 
                    default: <1.0>
 
+    -rscl <ratio>  Specify scale ratio used to re-align failed or suspicious image pairs
+                   (few inliers, large residual, weak phase correlation peak
+                   or translation far from neighbors').
+                   Only these pairs are re-detected and re-matched at this ratio,
+                   and it is disabled if ratio is not larger than -scl ratio.
+
+                   default: <2 x -scl ratio> (at most <1.0>)
+
     -iw   <method> Specify imageWarpper method used for image warpping.
                    It currently only supports one method.
                    <cylindrical>
@@ -105,22 +182,121 @@ Options:
                    default: <brute-force>
 
     -im   <method> Specify imageMatcher method used for image matching.
-                   It currently only supports one method.
-                   <ransac>
+                   It currently supports four methods.
+                   <ransac>            translation with RANSAC
+                   <phase>             translation with phase correlation,
+                                       feature stages are skipped
+                   <prosac-affine>     affine transform with PROSAC
+                   <prosac-homography> homography with PROSAC
 
                    default: <ransac>
 
+    -ec   <method> Specify exposureCompensator method used for exposure compensation.
+                   It currently supports two methods.
+                   <gain> per-image gains solved from overlapping regions,
+                          they are applied while blending
+                   <none> no exposure compensation
+
+                   default: <none>
+
     -ib   <method> Specify imageBlender method used for image blending (stitching).
-                   It currently only supports one method.
-                   <linear-alpha>
+                   It currently supports three methods.
+                   <linear-alpha> x-direction linear alpha blending
+                   <multiband>    multi-band (Laplacian pyramid) blending
+                   <seam>         optimal seam with narrow feathering
 
                    default: <linear-alpha>
 
     -ba   <method> Specify bundleAdjuster method used for bundle adjustment.
                    It currently only supports one method.
-                   <perspective>
+                   <levenberg-marquardt> global alignment of all images before
+                                         blending, with loop closure for 360 degrees
+
+                   default: <levenberg-marquardt>
+
+    -crop <on|off> Specify whether to crop panorama to the largest rect
+                   fully covered by images (no black borders).
+                   With linear-alpha or multiband blending, only this rect is blended.
+
+                   default: <on>
+
+    -sw   <on|off> Specify whether to stitch in a sliding window for long sequences.
+                   Only two images are kept while aligning, and only images
+                   overlapping the current strip are kept while blending.
+                   Bundle adjustment and re-alignment are skipped, and it
+                   uses linear-alpha blending unless -ib is multiband.
+
+                   default: <off>
+
+    -t    <num>    Specify number of threads which run warpping, feature
+                   and matching tasks of images concurrently (--threads).
+
+                   default: <number of hardware threads>
+
+    -pool <MB>     Specify size of the pool recycling intermediate images of feature
+                   stages between images, or <auto> to keep the largest working set
+                   of images processed at the same time. <0> disables recycling.
+
+                   default: <auto>
+
+    -dbg  <on|off> Specify whether to write intermediate images (warpped images,
+                   features, feature matchings and blended panorama) to the
+                   ./result/ subfolders. They are written in the background.
+
+                   default: <off>
+
+    -cache <dir>   Specify feature cache directory. Features and descriptors of
+                   each image (keyed by image content, focal length, scale ratio
+                   and stages) are stored there, and later runs skip their
+                   feature stages, ex. to try other blenders.
+
+                   default: <disabled>
+
+    -cp   <on|off> Specify whether feature cache also stores feature matchings
+                   and alignment of each image pair.
+
+                   default: <on>
+
+    -trace <file>  Write timing of each stage call and counters (features, matches,
+                   RANSAC iterations, bytes) as Chrome trace JSON, it can be
+                   opened by chrome://tracing or Perfetto.
+
+                   default: <disabled>
+
+    -sum  <file>   Write count, total, min and max of each stage timing (ms)
+                   and each counter as JSON summary.
+
+                   default: <disabled>
+
+    -batch <file>  Stitch every job of a manifest file in one process, one job
+                   per line ('#' begins a comment line):
+                   <images directory> <focal length file> <output> [key=value ...]
+                   keys are the same as stitching options use, ex. imageBlender=seam.
+                   A failed job doesn't stop other jobs.
+
+                   default: <disabled>
+
+    -j    <num>    Specify number of batch or daemon jobs stitched at the same time,
+                   hardware threads are shared among them.
+
+                   default: <number of hardware threads> for batch, <1> for daemon
+
+    -mem  <MB>     Specify memory budget of each batch job, a job estimated
+                   over it is stitched in a sliding window (see -sw).
+
+                   default: <0> (no budget)
+
+    -daemon <path> Serve stitching jobs until a shutdown request, requests and
+                   events are JSON objects, one per line, ex.
+                   {"type": "stitch", "id": "a", "imageDirectory": "./IMAGES/",
+                    "focalLengthFilename": "./FOCAL_LENGTH.txt", "outputFilename": "a.png"}
+                   {"type": "cancel", "id": "a"}
+                   {"type": "shutdown"}
+                   Jobs send queued, started, progress and finished (or failed,
+                   cancelled) events. <path> is a Unix domain socket (see
+                   stitch-client), or <-> to serve stdin and stdout.
 
-                   default: <perspective>
+                   default: <disabled>
 )";
 
 }
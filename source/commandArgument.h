@@ -8,11 +8,15 @@ namespace sis {
 
 class CommandArgument {
 public:
+    CommandArgument();
     CommandArgument(int argc, char* argv[]);
 
     const std::string find(const std::string& key, 
                            const std::string& defaultValue = "") const;
 
+    // set argument programmatically (ex. for appending frames)
+    void insert(const std::string& key, const std::string& value);
+
     bool isHelpMessageRequested() const;
     void printHelpMessage() const;
 
@@ -1,17 +0,0 @@
-#pragma once
-
-/*
-    It defines some user-control MACROs
-*/
-
-// Control if writing images after image warpping
-#define DRAW_WARP_IMAGES
-
-// Control if writing images after feature detection
-#define DRAW_FEATURE_IMAGES
-
-// Control if writing image pairs after feature matching
-#define DRAW_FEATURE_MATCHING_IMAGES
-
-// Control if writing blended image after image blending
-#define DRAW_BLEND_IMAGES
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "core/batchStitcher.h"
+
+#include "commandArgument.h"
+#include "core/imageStitcher.h"
+#include "core/taskScheduler.h"
+#include "panoramaSink/tiffPanoramaSink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if (defined(_MSC_VER) || \
+     (defined(__GNUC__) && (__GNUC_MAJOR__ >= 8)))
+#include <filesystem>
+    namespace std_fs = std::filesystem;
+#else
+    #include <experimental/filesystem>
+    namespace std_fs = std::experimental::filesystem;
+#endif
+
+namespace sis {
+
+BatchStitcher::BatchStitcher() :
+    BatchStitcher(static_cast<int>(std::thread::hardware_concurrency()), 0) {
+}
+
+BatchStitcher::BatchStitcher(const int maxConcurrentJobs, const std::size_t memoryBudget) :
+    BatchStitcher(maxConcurrentJobs, memoryBudget, Logger::console()) {
+}
+
+BatchStitcher::BatchStitcher(const int maxConcurrentJobs, const std::size_t memoryBudget, const Logger& logger) :
+    _maxConcurrentJobs(std::max(maxConcurrentJobs, 1)),
+    _memoryBudget(memoryBudget),
+    _logger(logger) {
+}
+
+bool BatchStitcher::readManifest(const std::string& manifestFilename, std::vector<Job>* const out_jobs) {
+    std::ifstream file(manifestFilename);
+    if (!file) {
+        Logger::console().warning() << "Batch manifest can't open: " << manifestFilename
+                                    << std::endl;
+
+        return false;
+    }
+
+    std::string line;
+    int         lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+
+        std::istringstream stream(line);
+        Job                job;
+        if (!(stream >> job.imageDirectory) || job.imageDirectory[0] == '#') {
+            continue;
+        }
+
+        if (!(stream >> job.focalLengthFilename >> job.outputFilename)) {
+            Logger::console().warning() << "Batch manifest line " << lineNumber
+                                        << " needs <imageDirectory> <focalLengthFile> <output>"
+                                        << std::endl;
+
+            return false;
+        }
+
+        std::string option;
+        while (stream >> option) {
+            const std::size_t separatorPos = option.find('=');
+            if (separatorPos == std::string::npos) {
+                Logger::console().warning() << "Batch manifest line " << lineNumber
+                                            << " has an option without '=': " << option
+                                            << std::endl;
+
+                return false;
+            }
+
+            job.options[option.substr(0, separatorPos)] = option.substr(separatorPos + 1);
+        }
+
+        out_jobs->push_back(job);
+    }
+
+    return true;
+}
+
+int BatchStitcher::run(const std::vector<Job>& jobs) const {
+    const int numJobs = static_cast<int>(jobs.size());
+
+    // tasks of all jobs run on one pool of all hardware threads
+    const auto workerPool = std::make_shared<WorkerPool>();
+
+    _logger.progress() << "# Begin to stitch " << numJobs << " jobs, at most "
+                       << _maxConcurrentJobs << " jobs at the same time on "
+                       << workerPool->numThreads() << " shared threads"
+                       << std::endl;
+
+    std::mutex resultMutex;
+    int        numFailedJobs   = 0;
+    int        numFinishedJobs = 0;
+
+    // jobs themselves only wait for their tasks, so they have threads of their own
+    TaskScheduler scheduler(_maxConcurrentJobs);
+    for (int n = 0; n < numJobs; ++n) {
+        scheduler.addTask("job " + std::to_string(n + 1), [&, n]() {
+            const Job& job = jobs[n];
+
+            const auto beginTime = std::chrono::steady_clock::now();
+
+            // stage progress is dropped, warnings are kept for the result
+            std::ostringstream warnings;
+            const Logger       jobLogger(nullptr, &warnings);
+
+            std::string errorMessage;
+            try {
+                _runJob(job, workerPool, jobLogger);
+            }
+            catch (const std::exception& exception) {
+                errorMessage = exception.what();
+            }
+
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - beginTime).count();
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            ++numFinishedJobs;
+            if (!errorMessage.empty()) {
+                ++numFailedJobs;
+            }
+
+            _logger.progress() << "    [" << numFinishedJobs << "/" << numJobs << "] "
+                               << (errorMessage.empty() ? "Finish " : "Fail ") << job.outputFilename
+                               << " (" << seconds << " s)"
+                               << (errorMessage.empty() ? "" : ": " + errorMessage)
+                               << std::endl;
+
+            std::istringstream warningLines(warnings.str());
+            std::string        warning;
+            while (std::getline(warningLines, warning)) {
+                if (!warning.empty()) {
+                    _logger.warning() << "        " << job.outputFilename << ": " << warning
+                                      << std::endl;
+                }
+            }
+        });
+    }
+
+    scheduler.run();
+
+    _logger.progress() << "# Finish batch stitching, " << numFailedJobs << " of " << numJobs << " jobs failed"
+                       << std::endl;
+
+    return numFailedJobs;
+}
+
+void BatchStitcher::_runJob(
+    const Job&                         job,
+    const std::shared_ptr<WorkerPool>& workerPool,
+    const Logger&                      jobLogger) const {
+
+    CommandArgument arguments;
+    for (const auto& option : job.options) {
+        arguments.insert(option.first, option.second);
+    }
+    arguments.insert("imageDirectory", job.imageDirectory);
+    arguments.insert("focalLengthFilename", job.focalLengthFilename);
+
+    // a job setting numThreads has its own workers
+    const auto& numThreadsOption = job.options.find("numThreads");
+    const bool  hasOwnThreads    = (numThreadsOption != job.options.end());
+    const int   numOwnThreads    = hasOwnThreads ? std::atoi(numThreadsOption->second.c_str()) : 0;
+    const int   numThreads       = !hasOwnThreads  ? workerPool->numThreads() :
+                                   numOwnThreads > 0 ? numOwnThreads :
+                                   static_cast<int>(std::thread::hardware_concurrency());
+
+    // a job over budget keeps only a window of images in memory
+    if (_memoryBudget > 0 && job.options.find("slidingWindow") == job.options.end() &&
+        _estimateMemory(job, numThreads) > _memoryBudget) {
+
+        arguments.insert("slidingWindow", "on");
+    }
+
+    const ImageStitcher imageStitcher(arguments, jobLogger, hasOwnThreads ? nullptr : workerPool);
+
+    const std::size_t extensionPos = job.outputFilename.find_last_of('.');
+    const std::string extension    = (extensionPos == std::string::npos) ?
+                                     "" : job.outputFilename.substr(extensionPos);
+
+    if (extension == ".tif" || extension == ".tiff") {
+        TiffPanoramaSink sink(job.outputFilename);
+        imageStitcher.solve(&sink);
+    }
+    else {
+        cv::Mat panorama;
+        imageStitcher.solve(&panorama);
+        if (!cv::imwrite(job.outputFilename, panorama)) {
+            throw std::runtime_error("Panorama file can't write: " + job.outputFilename);
+        }
+    }
+}
+
+std::size_t BatchStitcher::_estimateMemory(const Job& job, const int numThreads) const {
+    std::vector<std::string> imageFilenames;
+    for (const auto& entry : std_fs::directory_iterator(job.imageDirectory)) {
+        imageFilenames.push_back(entry.path().string());
+    }
+    if (imageFilenames.empty()) {
+        return 0;
+    }
+
+    const auto& sizeRatioOption = job.options.find("sizeRatio");
+    const float sizeRatio       = (sizeRatioOption == job.options.end()) ?
+                                  1.0f :
+                                  std::min(std::max(std::stof(sizeRatioOption->second), 0.1f), 1.0f);
+
+    // image size is taken from the 1/8 scale decode of one image
+    const cv::Mat     image     = cv::imread(imageFilenames[0], cv::IMREAD_REDUCED_COLOR_8);
+    const std::size_t numPixels = static_cast<std::size_t>(image.total() * 64 * sizeRatio * sizeRatio);
+
+    /*
+        Kept per image: input (CV_8UC3, 3 bytes/pixel), warpped image
+        (CV_8UC3, 3) and its index (CV_32FC1, 4), and panorama (3) at
+        most as large as all images side by side
+    */
+    const std::size_t numImages  = imageFilenames.size();
+    const std::size_t imageBytes = numImages * numPixels * (3 + 3 + 4 + 3);
+
+    /*
+        Working buffers of each image being processed (one per thread):
+        warpping converts it to CV_32FC3 and warps into CV_32FC3 (24),
+        SIFT keeps 1 CV_8UC1 and 11 + 2 x 18 + 2 x 8 CV_32FC1 buffers
+        (253), Harris less (66). The buffer pool keeps the larger one.
+    */
+    const std::size_t numWorkImages = std::min(numImages, static_cast<std::size_t>(std::max(numThreads, 1)));
+    const std::size_t workBytes     = numWorkImages * numPixels * std::max<std::size_t>(12 + 12, 1 + 63 * 4);
+
+    return imageBytes + workBytes;
+}
+
+} // namespace sis
\ No newline at end of file
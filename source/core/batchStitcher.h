@@ -0,0 +1,71 @@
+#pragma once
+
+#include "core/logger.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sis {
+
+class WorkerPool;
+
+/*
+    BatchStitcher stitches many panoramas (jobs) in one process.
+
+    Jobs run at most maxConcurrentJobs at the same time, and their
+    tasks run on one WorkerPool of all hardware threads, so threads a
+    job can't keep busy (ex. it has few images) run tasks of other
+    jobs. A job whose options set numThreads has workers of its own.
+
+    memoryBudget: bytes a job may use, a job estimated over it is
+                  stitched in sliding-window mode (0 for no budget).
+
+    Stage progress of concurrent jobs would interleave, so each job
+    gets its own logger which drops it, and only job results and
+    warnings of each job (ex. unknown option types) go to logger.
+    A failed job (ex. unreadable files) doesn't stop other jobs.
+
+    Manifest has one job per line, and '#' begins a comment line
+
+        <imageDirectory> <focalLengthFile> <output> [key=value ...]
+
+    keys are the same as command line arguments use
+        Ex. ./data/grail/image ./data/grail/focal-length.txt grail.png imageBlender=multiband
+*/
+class BatchStitcher {
+public:
+    struct Job {
+        std::string                                  imageDirectory;
+        std::string                                  focalLengthFilename;
+        std::string                                  outputFilename;
+        std::unordered_map<std::string, std::string> options;
+    };
+
+    BatchStitcher();
+    BatchStitcher(const int maxConcurrentJobs, const std::size_t memoryBudget);
+    BatchStitcher(const int maxConcurrentJobs, const std::size_t memoryBudget, const Logger& logger);
+
+    static bool readManifest(const std::string& manifestFilename, std::vector<Job>* const out_jobs);
+
+    // returns number of failed jobs
+    int run(const std::vector<Job>& jobs) const;
+
+private:
+    // throws if the job fails
+    void _runJob(
+        const Job&                         job,
+        const std::shared_ptr<WorkerPool>& workerPool,
+        const Logger&                      jobLogger) const;
+
+    // rough peak bytes of images, panorama and working buffers of numThreads images
+    std::size_t _estimateMemory(const Job& job, const int numThreads) const;
+
+    int         _maxConcurrentJobs;
+    std::size_t _memoryBudget;
+    Logger      _logger;
+};
+
+} // namespace sis
\ No newline at end of file
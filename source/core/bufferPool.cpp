@@ -0,0 +1,116 @@
+#include "core/bufferPool.h"
+
+#include "core/profiler.h"
+
+#include <algorithm>
+
+namespace sis {
+
+BufferPool::Scope::Scope(BufferPool* const pool) :
+    _pool(pool),
+    _buffers(),
+    _numAcquiredBytes(0) {
+}
+
+BufferPool::Scope::~Scope() {
+    for (auto& buffer : _buffers) {
+        _pool->_release(&buffer);
+    }
+
+    _pool->_endScope(_numAcquiredBytes);
+}
+
+cv::Mat& BufferPool::Scope::acquire(const cv::Size& size, const int type) {
+    _buffers.push_back(_pool->_acquire(size, type));
+    _numAcquiredBytes += _buffers.back().total() * _buffers.back().elemSize();
+
+    return _buffers.back();
+}
+
+BufferPool::BufferPool() :
+    _mutex(),
+    _freeBuffers(),
+    _isAutoSized(true),
+    _maxBytes(0),
+    _numPooledBytes(0),
+    _numUsedBytes(0) {
+}
+
+BufferPool::BufferPool(const std::size_t maxBytes) :
+    _mutex(),
+    _freeBuffers(),
+    _isAutoSized(false),
+    _maxBytes(maxBytes),
+    _numPooledBytes(0),
+    _numUsedBytes(0) {
+}
+
+std::size_t BufferPool::numPooledBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _numPooledBytes;
+}
+
+void BufferPool::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _freeBuffers.clear();
+    _numPooledBytes = 0;
+}
+
+cv::Mat BufferPool::_acquire(const cv::Size& size, const int type) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _numUsedBytes += static_cast<std::size_t>(size.area()) * CV_ELEM_SIZE(type);
+        if (_isAutoSized) {
+            _maxBytes = std::max(_maxBytes, _numUsedBytes);
+        }
+
+        const auto& freeBuffers = _freeBuffers.find(BufferKey(size.height, size.width, type));
+        if (freeBuffers != _freeBuffers.end() && !freeBuffers->second.empty()) {
+            cv::Mat buffer = freeBuffers->second.back();
+            freeBuffers->second.pop_back();
+            _numPooledBytes -= buffer.total() * buffer.elemSize();
+
+            return buffer;
+        }
+    }
+
+    cv::Mat buffer(size, type);
+    profiler::count("buffer pool allocated bytes", static_cast<double>(buffer.total() * buffer.elemSize()));
+
+    return buffer;
+}
+
+void BufferPool::_release(cv::Mat* const buffer) {
+    /*
+        Only a whole buffer owned by nobody else goes back,
+        a stage may have replaced it (ex. with an output of
+        another size), so it is keyed by what it is now
+    */
+    if (buffer->empty() || !buffer->u || buffer->u->refcount != 1) {
+        return;
+    }
+
+    const std::size_t numBytes = buffer->total() * buffer->elemSize();
+    if (buffer->data != buffer->datastart || static_cast<std::size_t>(buffer->dataend - buffer->datastart) != numBytes) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_numPooledBytes + numBytes > _maxBytes) {
+        return;
+    }
+
+    _freeBuffers[BufferKey(buffer->rows, buffer->cols, buffer->type())].push_back(*buffer);
+    _numPooledBytes += numBytes;
+}
+
+void BufferPool::_endScope(const std::size_t numAcquiredBytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _numUsedBytes -= numAcquiredBytes;
+}
+
+} // namespace sis
\ No newline at end of file
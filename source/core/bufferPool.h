@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <tuple>
+#include <vector>
+
+namespace sis {
+
+/*
+    BufferPool recycles cv::Mat buffers of per-image intermediate images
+    (ex. derivatives and orientation maps of feature stages), so images
+    of the same size reuse them instead of allocating (and page faulting)
+    dozens of full-size buffers again. It is thread-safe, stages running
+    concurrently on different images share one pool.
+
+    Buffers are acquired through a Scope, and they go back to the pool
+    when the scope ends. A buffer whose Mat is still shared (ex. it is
+    also an output) is released normally instead.
+
+    maxBytes: free buffers kept in the pool at most, buffers released
+              beyond it are freed. By default it follows the peak bytes
+              of buffers acquired at the same time, so the whole working
+              set of concurrently processed images is recycled (ex. SIFT
+              of a 24 MP image acquires ~6 GB), and the pool never keeps
+              more than stages already needed at once.
+*/
+class BufferPool {
+public:
+    class Scope {
+    public:
+        explicit Scope(BufferPool* const pool);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        /*
+            Buffer content is undefined, and the reference
+            is valid until the scope ends
+        */
+        cv::Mat& acquire(const cv::Size& size, const int type);
+
+    private:
+        BufferPool*         _pool;
+        std::deque<cv::Mat> _buffers;
+        std::size_t         _numAcquiredBytes;
+    };
+
+    BufferPool();
+    BufferPool(const std::size_t maxBytes);
+
+    std::size_t numPooledBytes() const;
+
+    // free all pooled buffers
+    void clear();
+
+private:
+    // (rows, cols, type)
+    using BufferKey = std::tuple<int, int, int>;
+
+    cv::Mat _acquire(const cv::Size& size, const int type);
+    void    _release(cv::Mat* const buffer);
+
+    // buffers of an ended scope are no longer in use
+    void _endScope(const std::size_t numAcquiredBytes);
+
+    mutable std::mutex                        _mutex;
+    std::map<BufferKey, std::vector<cv::Mat>> _freeBuffers;
+    bool                                      _isAutoSized;
+    std::size_t                               _maxBytes;
+    std::size_t                               _numPooledBytes;
+    std::size_t                               _numUsedBytes; // acquired by live scopes
+};
+
+} // namespace sis
\ No newline at end of file
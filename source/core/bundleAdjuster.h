@@ -1,17 +1,58 @@
 #pragma once
 
+#include "core/imageAlignment.h"
+#include "core/logger.h"
+#include "core/profiler.h"
+
 #include <opencv2/opencv.hpp>
+#include <vector>
 
 namespace sis {
 
 /*
-    BundleAdjuster: it is used for solving panorama image drifting problem.                
+    BundleAdjuster: it is used for solving panorama image drifting problem.
+
+    It adjusts image alignments globally before blending,
+    so the panorama is rendered only once.
+
+    imageAlignments       : alignment of each adjacent image pair (n, n+1).
+                            For a closed (360 degrees) sweep it has an extra
+                            alignment of image pair (last, first), and
+                            featureMatchings has its matchings too.
+
+    out_adjustedAlignments: adjusted alignment of each adjacent image pair,
+                            without the closing pair.
 */
-class BundleAdjuster {
+class BundleAdjuster : public Loggable {
 public:
-    virtual void adjust(
-        const cv::Mat& panorama,
-        cv::Mat* const out_adjustedPanorama) const = 0;
+    void adjust(
+        const std::vector<cv::Mat>&                          images,
+        const std::vector<std::vector<cv::Point>>&           featurePositions,
+        const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+        const std::vector<ImageAlignment>&                   imageAlignments,
+        std::vector<ImageAlignment>* const                   out_adjustedAlignments) const;
+
+private:
+    virtual void _adjustImpl(
+        const std::vector<cv::Mat>&                          images,
+        const std::vector<std::vector<cv::Point>>&           featurePositions,
+        const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+        const std::vector<ImageAlignment>&                   imageAlignments,
+        std::vector<ImageAlignment>* const                   out_adjustedAlignments) const = 0;
 };
 
+// header implementation
+
+inline void BundleAdjuster::adjust(
+    const std::vector<cv::Mat>&                          images,
+    const std::vector<std::vector<cv::Point>>&           featurePositions,
+    const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+    const std::vector<ImageAlignment>&                   imageAlignments,
+    std::vector<ImageAlignment>* const                   out_adjustedAlignments) const {
+
+    profiler::ScopedTimer timer("bundle adjustment");
+
+    _adjustImpl(images, featurePositions, featureMatchings, imageAlignments, out_adjustedAlignments);
+}
+
 } // namespace sis
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "core/debugImageWriter.h"
+
+#include <cstdio>
+#include <iostream>
+
+#if (defined(_MSC_VER) || \
+     (defined(__GNUC__) && (__GNUC_MAJOR__ >= 8)))
+#include <filesystem>
+    namespace std_fs = std::filesystem;
+#else
+    #include <experimental/filesystem>
+    namespace std_fs = std::experimental::filesystem;
+#endif
+
+namespace sis {
+
+DebugImageWriter::DebugImageWriter() :
+    DebugImageWriter("./result") {
+}
+
+DebugImageWriter::DebugImageWriter(const std::string& directory) :
+    _directory(directory),
+    _mutex(),
+    _queueCondition(),
+    _flushCondition(),
+    _queue(),
+    _isWriting(false),
+    _isStopped(false),
+    _worker() {
+
+    std_fs::create_directories(_directory + "/warp");
+    std_fs::create_directories(_directory + "/feature");
+    std_fs::create_directories(_directory + "/matching");
+    std_fs::create_directories(_directory + "/blend");
+
+    _worker = std::thread(&DebugImageWriter::_runWorker, this);
+}
+
+DebugImageWriter::~DebugImageWriter() {
+    flush();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopped = true;
+    }
+    _queueCondition.notify_one();
+
+    _worker.join();
+}
+
+void DebugImageWriter::writeWarpImage(const int n, const cv::Mat& warpImage) {
+    char filename[100];
+    sprintf(filename, "/warp/warp%02d.png", n);
+
+    _enqueue(filename, [warpImage]() {
+        return warpImage;
+    });
+}
+
+void DebugImageWriter::writeFeatureImage(
+    const int                     n,
+    const cv::Mat&                image,
+    const std::vector<cv::Point>& featurePositions) {
+
+    char filename[100];
+    sprintf(filename, "/feature/feature%02d.png", n);
+
+    _enqueue(filename, [image, featurePositions]() {
+        cv::Mat featureImage = image.clone();
+        for (auto& position : featurePositions) {
+            cv::circle(featureImage, position, 2, cv::Scalar(0, 0, 255), cv::FILLED);
+        }
+
+        return featureImage;
+    });
+}
+
+void DebugImageWriter::writeMatchingImage(
+    const int                               n,
+    const cv::Mat&                          image1,
+    const cv::Mat&                          image2,
+    const std::vector<cv::Point>&           featurePositions1,
+    const std::vector<cv::Point>&           featurePositions2,
+    const std::vector<std::pair<int, int>>& featureMatchings) {
+
+    char filename[100];
+    sprintf(filename, "/matching/matching%02d.png", n);
+
+    _enqueue(filename, [image1, image2, featurePositions1, featurePositions2, featureMatchings]() {
+        cv::Mat concateImage;
+        cv::hconcat(image1, image2, concateImage);
+
+        const cv::Point offset(image1.cols, 0);
+        for (auto& matching : featureMatchings) {
+            const cv::Point& point1 = featurePositions1[matching.second];
+            const cv::Point& point2 = featurePositions2[matching.first];
+
+            cv::line(concateImage, point1, point2 + offset, cv::Scalar(0, 255, 0), 2);
+            cv::circle(concateImage, point1, 1, cv::Scalar(0, 0, 255), cv::FILLED);
+            cv::circle(concateImage, point2 + offset, 1, cv::Scalar(0, 0, 255), cv::FILLED);
+        }
+
+        return concateImage;
+    });
+}
+
+void DebugImageWriter::writeBlendImage(const cv::Mat& blendImage) {
+    _enqueue("/blend/blendImage_result.png", [blendImage]() {
+        return blendImage;
+    });
+}
+
+void DebugImageWriter::flush() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _flushCondition.wait(lock, [this]() {
+        return _queue.empty() && !_isWriting;
+    });
+}
+
+void DebugImageWriter::_enqueue(const std::string& filename, const std::function<cv::Mat()>& drawImage) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(std::make_pair(_directory + filename, drawImage));
+    }
+    _queueCondition.notify_one();
+}
+
+void DebugImageWriter::_runWorker() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queueCondition.wait(lock, [this]() {
+                return !_queue.empty() || _isStopped;
+            });
+
+            if (_queue.empty()) {
+                return;
+            }
+
+            job = std::move(_queue.front());
+            _queue.pop_front();
+            _isWriting = true;
+        }
+
+        // a failed debug image doesn't stop stitching
+        try {
+            cv::imwrite(job.first, job.second());
+        }
+        catch (const std::exception& exception) {
+            _log().warning() << "Cannot write debug image: " << job.first << " (" << exception.what() << ")"
+                             << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _isWriting = false;
+        }
+        _flushCondition.notify_all();
+    }
+}
+
+} // namespace sis
\ No newline at end of file
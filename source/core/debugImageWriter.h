@@ -0,0 +1,78 @@
+#pragma once
+
+#include "core/logger.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sis {
+
+/*
+    DebugImageWriter writes intermediate images of stages to
+    subdirectories of its directory, ex. for image n
+
+        warp/warpNN.png         : warpped image
+        feature/featureNN.png   : detected features
+        matching/matchingNN.png : feature matchings of image pair (n, n+1)
+        blend/blendImage_result.png
+
+    Images are drawn and PNG-encoded by a background thread, so
+    stages only queue them. Queued images share data with the caller
+    (they are not copied), so they must not be modified until flush().
+*/
+class DebugImageWriter : public Loggable {
+public:
+    DebugImageWriter();
+    DebugImageWriter(const std::string& directory);
+
+    // flush and stop the background thread
+    ~DebugImageWriter();
+
+    void writeWarpImage(const int n, const cv::Mat& warpImage);
+
+    void writeFeatureImage(
+        const int                     n,
+        const cv::Mat&                image,
+        const std::vector<cv::Point>& featurePositions);
+
+    void writeMatchingImage(
+        const int                               n,
+        const cv::Mat&                          image1,
+        const cv::Mat&                          image2,
+        const std::vector<cv::Point>&           featurePositions1,
+        const std::vector<cv::Point>&           featurePositions2,
+        const std::vector<std::pair<int, int>>& featureMatchings);
+
+    void writeBlendImage(const cv::Mat& blendImage);
+
+    // wait until all queued images are written
+    void flush();
+
+private:
+    // output filename and function drawing the image
+    using Job = std::pair<std::string, std::function<cv::Mat()>>;
+
+    void _enqueue(const std::string& filename, const std::function<cv::Mat()>& drawImage);
+
+    void _runWorker();
+
+    std::string _directory;
+
+    std::mutex              _mutex;
+    std::condition_variable _queueCondition;
+    std::condition_variable _flushCondition;
+    std::deque<Job>         _queue;
+    bool                    _isWriting;
+    bool                    _isStopped;
+
+    std::thread _worker;
+};
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "core/imageAlignment.h"
+#include "core/logger.h"
+#include "core/profiler.h"
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace sis {
+
+/*
+    ExposureCompensator is used for compensating exposure
+    differences between images (ex. caused by auto-exposure).
+
+    out_imageGains: It stores intensity gain of each image,
+                    gains are not applied to images here,
+                    imageBlender applies them while blending.
+*/
+class ExposureCompensator : public Loggable {
+public:
+    void compensate(
+        const std::vector<cv::Mat>&        images,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        std::vector<float>* const          out_imageGains) const;
+
+private:
+    virtual void _compensateImpl(
+        const std::vector<cv::Mat>&        images,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        std::vector<float>* const          out_imageGains) const = 0;
+};
+
+// header implementation
+
+inline void ExposureCompensator::compensate(
+    const std::vector<cv::Mat>&        images,
+    const std::vector<ImageAlignment>& imageAlignments,
+    const std::vector<cv::Mat>&        warpImageIndices,
+    std::vector<float>* const          out_imageGains) const {
+
+    profiler::ScopedTimer timer("exposure compensation");
+
+    _compensateImpl(images, imageAlignments, warpImageIndices, out_imageGains);
+}
+
+} // namespace sis
\ No newline at end of file
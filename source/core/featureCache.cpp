@@ -0,0 +1,336 @@
+#include "core/featureCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#if defined(_WIN32)
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
+
+#if (defined(_MSC_VER) || \
+     (defined(__GNUC__) && (__GNUC_MAJOR__ >= 8)))
+#include <filesystem>
+    namespace std_fs = std::filesystem;
+#else
+    #include <experimental/filesystem>
+    namespace std_fs = std::experimental::filesystem;
+#endif
+
+namespace sis {
+
+namespace {
+
+// 64-bit FNV-1a hash
+class Hasher {
+public:
+    Hasher() :
+        _hash(14695981039346656037ULL) {
+    }
+
+    void update(const void* const data, const std::size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            _hash = (_hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+
+    template<typename T>
+    void update(const T& value) {
+        update(&value, sizeof(T));
+    }
+
+    void update(const std::string& string) {
+        update(string.data(), string.size());
+    }
+
+    std::uint64_t hash() const {
+        return _hash;
+    }
+
+private:
+    std::uint64_t _hash;
+};
+
+template<typename T>
+void appendData(std::string* const out_data, const T& value) {
+    out_data->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// id of the current process, it tells apart temporary files of concurrent runs
+long long getProcessId() {
+#if defined(_WIN32)
+    return static_cast<long long>(_getpid());
+#else
+    return static_cast<long long>(getpid());
+#endif
+}
+
+bool readFile(const std::string& filename, std::string* const out_data) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    // one read of the whole file, entries are small compared to images
+    file.seekg(0, std::ios::end);
+    const std::streamoff size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (size < 0) {
+        return false;
+    }
+
+    out_data->resize(static_cast<std::size_t>(size));
+    file.read(&(*out_data)[0], size);
+
+    return static_cast<bool>(file);
+}
+
+} // anonymous namespace
+
+FeatureCache::FeatureCache(const std::string& directory,
+                           const std::string& featureParameters,
+                           const std::string& pairParameters,
+                           const bool         isImagePairCached) :
+    _directory(directory),
+    _featureParameters(featureParameters),
+    _pairParameters(pairParameters),
+    _isImagePairCached(isImagePairCached) {
+
+    std_fs::create_directories(_directory);
+}
+
+std::uint64_t FeatureCache::calculateImageKey(
+    const cv::Mat& image,
+    const float    focalLength,
+    const float    sizeRatio) const {
+
+    Hasher hasher;
+    hasher.update(image.rows);
+    hasher.update(image.cols);
+    hasher.update(image.type());
+
+    const std::size_t rowBytes = image.cols * image.elemSize();
+    for (int y = 0; y < image.rows; ++y) {
+        hasher.update(image.ptr(y), rowBytes);
+    }
+
+    hasher.update(focalLength);
+    hasher.update(sizeRatio);
+    hasher.update(_featureParameters);
+    hasher.update(VERSION);
+
+    return hasher.hash();
+}
+
+bool FeatureCache::loadFeatures(
+    const std::uint64_t                    imageKey,
+    std::vector<cv::Point>* const          out_featurePositions,
+    std::vector<std::vector<float>>* const out_featureDescriptors) const {
+
+    std::string data;
+    if (!readFile(_getFilename(imageKey, ".feat"), &data) || data.size() < sizeof(FileHeader)) {
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, data.data(), sizeof(FileHeader));
+
+    const std::size_t count     = header.count;
+    const std::size_t dimension = header.dimension;
+    if (std::memcmp(header.magic, "SISF", 4) != 0 ||
+        header.version != VERSION                  ||
+        data.size() != sizeof(FileHeader) + count * 2 * sizeof(std::int32_t) +
+                                            count * dimension * sizeof(float)) {
+        return false;
+    }
+
+    const char* positionData   = data.data() + sizeof(FileHeader);
+    const char* descriptorData = positionData + count * 2 * sizeof(std::int32_t);
+
+    out_featurePositions->resize(count);
+    out_featureDescriptors->assign(count, std::vector<float>(dimension));
+    for (std::size_t i = 0; i < count; ++i) {
+        std::int32_t position[2];
+        std::memcpy(position, positionData + i * sizeof(position), sizeof(position));
+        (*out_featurePositions)[i] = cv::Point(position[0], position[1]);
+
+        std::memcpy((*out_featureDescriptors)[i].data(),
+                    descriptorData + i * dimension * sizeof(float),
+                    dimension * sizeof(float));
+    }
+
+    return true;
+}
+
+void FeatureCache::storeFeatures(
+    const std::uint64_t                    imageKey,
+    const std::vector<cv::Point>&          featurePositions,
+    const std::vector<std::vector<float>>& featureDescriptors) const {
+
+    const std::size_t count     = featurePositions.size();
+    const std::size_t dimension = featureDescriptors.empty() ? 0 : featureDescriptors[0].size();
+
+    // only fixed-dimension descriptors of every feature can be stored
+    if (featureDescriptors.size() != count) {
+        return;
+    }
+    for (auto& descriptor : featureDescriptors) {
+        if (descriptor.size() != dimension) {
+            return;
+        }
+    }
+
+    const FileHeader header = { { 'S', 'I', 'S', 'F' },
+                                VERSION,
+                                static_cast<std::uint32_t>(count),
+                                static_cast<std::uint32_t>(dimension) };
+
+    std::string data;
+    data.reserve(sizeof(FileHeader) + count * (2 * sizeof(std::int32_t) + dimension * sizeof(float)));
+    appendData(&data, header);
+    for (auto& position : featurePositions) {
+        appendData(&data, static_cast<std::int32_t>(position.x));
+        appendData(&data, static_cast<std::int32_t>(position.y));
+    }
+    for (auto& descriptor : featureDescriptors) {
+        data.append(reinterpret_cast<const char*>(descriptor.data()), dimension * sizeof(float));
+    }
+
+    _writeFile(_getFilename(imageKey, ".feat"), data);
+}
+
+bool FeatureCache::loadImagePair(
+    const std::uint64_t                     imageKey1,
+    const std::uint64_t                     imageKey2,
+    std::vector<std::pair<int, int>>* const out_featureMatchings,
+    ImageAlignment* const                   out_imageAlignment) const {
+
+    if (!_isImagePairCached) {
+        return false;
+    }
+
+    std::string data;
+    if (!readFile(_getFilename(_calculatePairKey(imageKey1, imageKey2), ".pair"), &data) || data.size() < sizeof(FileHeader)) {
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, data.data(), sizeof(FileHeader));
+
+    const std::size_t alignmentSize = 9 * sizeof(double) + 3 * sizeof(std::int32_t) + 2 * sizeof(float);
+    const std::size_t count         = header.count;
+    if (std::memcmp(header.magic, "SISP", 4) != 0 ||
+        header.version != VERSION                  ||
+        data.size() != sizeof(FileHeader) + alignmentSize + count * 2 * sizeof(std::int32_t)) {
+        return false;
+    }
+
+    const char* alignmentData = data.data() + sizeof(FileHeader);
+    const char* matchingData  = alignmentData + alignmentSize;
+
+    ImageAlignment& imageAlignment = *out_imageAlignment;
+    std::memcpy(imageAlignment.transform.val, alignmentData, 9 * sizeof(double));
+
+    std::int32_t alignmentValues[3];
+    std::memcpy(alignmentValues, alignmentData + 9 * sizeof(double), sizeof(alignmentValues));
+    imageAlignment.translation = cv::Point(alignmentValues[0], alignmentValues[1]);
+    imageAlignment.numInliers  = alignmentValues[2];
+    std::memcpy(&imageAlignment.residual, alignmentData + 9 * sizeof(double) + sizeof(alignmentValues), sizeof(float));
+    std::memcpy(&imageAlignment.response, alignmentData + 9 * sizeof(double) + sizeof(alignmentValues) + sizeof(float), sizeof(float));
+
+    out_featureMatchings->resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        std::int32_t matching[2];
+        std::memcpy(matching, matchingData + i * sizeof(matching), sizeof(matching));
+        (*out_featureMatchings)[i] = std::make_pair(matching[0], matching[1]);
+    }
+
+    return true;
+}
+
+void FeatureCache::storeImagePair(
+    const std::uint64_t                     imageKey1,
+    const std::uint64_t                     imageKey2,
+    const std::vector<std::pair<int, int>>& featureMatchings,
+    const ImageAlignment&                   imageAlignment) const {
+
+    if (!_isImagePairCached) {
+        return;
+    }
+
+    const FileHeader header = { { 'S', 'I', 'S', 'P' },
+                                VERSION,
+                                static_cast<std::uint32_t>(featureMatchings.size()),
+                                0 };
+
+    std::string data;
+    appendData(&data, header);
+    data.append(reinterpret_cast<const char*>(imageAlignment.transform.val), 9 * sizeof(double));
+    appendData(&data, static_cast<std::int32_t>(imageAlignment.translation.x));
+    appendData(&data, static_cast<std::int32_t>(imageAlignment.translation.y));
+    appendData(&data, static_cast<std::int32_t>(imageAlignment.numInliers));
+    appendData(&data, imageAlignment.residual);
+    appendData(&data, imageAlignment.response);
+    for (auto& matching : featureMatchings) {
+        appendData(&data, static_cast<std::int32_t>(matching.first));
+        appendData(&data, static_cast<std::int32_t>(matching.second));
+    }
+
+    _writeFile(_getFilename(_calculatePairKey(imageKey1, imageKey2), ".pair"), data);
+}
+
+bool FeatureCache::isImagePairCached() const {
+    return _isImagePairCached;
+}
+
+std::uint64_t FeatureCache::_calculatePairKey(const std::uint64_t imageKey1, const std::uint64_t imageKey2) const {
+    Hasher hasher;
+    hasher.update(imageKey1);
+    hasher.update(imageKey2);
+    hasher.update(_pairParameters);
+
+    return hasher.hash();
+}
+
+std::string FeatureCache::_getFilename(const std::uint64_t key, const std::string& extension) const {
+    char name[32];
+    sprintf(name, "%016llx", static_cast<unsigned long long>(key));
+
+    return _directory + "/" + name + extension;
+}
+
+void FeatureCache::_writeFile(const std::string& filename, const std::string& data) const {
+    // unique per process and thread, so concurrent writers never share a temporary file
+    const std::string temporaryFilename =
+        filename + "." + std::to_string(getProcessId()) +
+        "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+    // a failed cache entry doesn't stop stitching, it only misses next time
+    std::error_code error;
+
+    std::ofstream file(temporaryFilename, std::ios::binary);
+    file.write(data.data(), data.size());
+    file.close();
+    if (!file) {
+        _log().warning() << "Cannot write feature cache: " << filename
+                         << std::endl;
+
+        std_fs::remove(temporaryFilename, error);
+
+        return;
+    }
+
+    // only a complete entry is renamed into the cache
+    std_fs::rename(temporaryFilename, filename, error);
+    if (error) {
+        std_fs::remove(temporaryFilename, error);
+    }
+}
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "core/imageAlignment.h"
+#include "core/logger.h"
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sis {
+
+/*
+    FeatureCache stores feature positions and descriptors of each image,
+    and optionally feature matchings and alignment of each image pair,
+    in a directory, so re-stitching the same images skips these stages.
+
+    imageKey: 64-bit hash of input image bytes (after scaling), its
+              focal length, scale ratio and featureParameters (stages
+              and their parameters), and pair key hashes both image
+              keys with pairParameters. A changed parameter therefore
+              only misses the cache, it never reads a stale entry.
+
+    Entries are little-endian binary files with fixed-size arrays, so
+    they could be memory-mapped, but they are read whole (in one read)
+    for now. Each file begins with
+
+        char[4] magic, uint32 version, uint32 count, uint32 dimension
+
+    <key>.feat : int32 positions[count][2]
+                 float descriptors[count][dimension]
+
+    <key>.pair : double transform[9]
+                 int32 translation[2], int32 numInliers, float residual,
+                 float response
+                 int32 matchings[count][2]
+
+    Files are written to a temporary name and renamed, so concurrent
+    runs sharing the directory never read a partial entry.
+*/
+class FeatureCache : public Loggable {
+public:
+    FeatureCache(const std::string& directory,
+                 const std::string& featureParameters,
+                 const std::string& pairParameters,
+                 const bool         isImagePairCached);
+
+    std::uint64_t calculateImageKey(
+        const cv::Mat& image,
+        const float    focalLength,
+        const float    sizeRatio) const;
+
+    // returns false if there is no valid entry
+    bool loadFeatures(
+        const std::uint64_t                    imageKey,
+        std::vector<cv::Point>* const          out_featurePositions,
+        std::vector<std::vector<float>>* const out_featureDescriptors) const;
+
+    void storeFeatures(
+        const std::uint64_t                    imageKey,
+        const std::vector<cv::Point>&          featurePositions,
+        const std::vector<std::vector<float>>& featureDescriptors) const;
+
+    // returns false if there is no valid entry or image pairs are not cached
+    bool loadImagePair(
+        const std::uint64_t                     imageKey1,
+        const std::uint64_t                     imageKey2,
+        std::vector<std::pair<int, int>>* const out_featureMatchings,
+        ImageAlignment* const                   out_imageAlignment) const;
+
+    void storeImagePair(
+        const std::uint64_t                     imageKey1,
+        const std::uint64_t                     imageKey2,
+        const std::vector<std::pair<int, int>>& featureMatchings,
+        const ImageAlignment&                   imageAlignment) const;
+
+    bool isImagePairCached() const;
+
+private:
+    struct FileHeader {
+        char          magic[4];
+        std::uint32_t version;
+        std::uint32_t count;
+        std::uint32_t dimension;
+    };
+
+    std::uint64_t _calculatePairKey(const std::uint64_t imageKey1, const std::uint64_t imageKey2) const;
+
+    std::string _getFilename(const std::uint64_t key, const std::string& extension) const;
+
+    // write to a temporary file, then rename it to filename
+    void _writeFile(const std::string& filename, const std::string& data) const;
+
+    std::string _directory;
+    std::string _featureParameters;
+    std::string _pairParameters;
+    bool        _isImagePairCached;
+
+    static constexpr std::uint32_t VERSION = 2;
+};
+
+} // namespace sis
\ No newline at end of file
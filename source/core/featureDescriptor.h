@@ -1,5 +1,8 @@
 #pragma once
 
+#include "core/logger.h"
+#include "core/profiler.h"
+
 #include <opencv2/opencv.hpp>
 #include <vector>
 
@@ -12,12 +15,30 @@ namespace sis {
     out_featureDescriptors: It stores all descriptors (using float vector) 
                             of all features of all images
 */
-class FeatureDescriptor {
+class FeatureDescriptor : public Loggable {
 public:
-    virtual void calculate(
+    void calculate(
+        const std::vector<cv::Mat>&                         images,
+        const std::vector<std::vector<cv::Point>>&          featurePositions,
+        std::vector<std::vector<std::vector<float>>>* const out_featureDescriptors) const;
+
+private:
+    virtual void _calculateImpl(
         const std::vector<cv::Mat>&                         images, 
         const std::vector<std::vector<cv::Point>>&          featurePositions,
         std::vector<std::vector<std::vector<float>>>* const out_featureDescriptors) const = 0;
 };
 
+// header implementation
+
+inline void FeatureDescriptor::calculate(
+    const std::vector<cv::Mat>&                         images,
+    const std::vector<std::vector<cv::Point>>&          featurePositions,
+    std::vector<std::vector<std::vector<float>>>* const out_featureDescriptors) const {
+
+    profiler::ScopedTimer timer("feature description");
+
+    _calculateImpl(images, featurePositions, out_featureDescriptors);
+}
+
 } // namespace sis
\ No newline at end of file
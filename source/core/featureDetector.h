@@ -1,8 +1,8 @@
 #pragma once
 
-#include "config.h"
+#include "core/logger.h"
+#include "core/profiler.h"
 
-#include <cstdio>
 #include <opencv2/opencv.hpp>
 #include <vector>
 
@@ -14,7 +14,7 @@ namespace sis {
     out_featurePositions: It stores all feature positions (x, y) of
                           input images
 */
-class FeatureDetector {
+class FeatureDetector : public Loggable {
 public:
     void detect(
         const std::vector<cv::Mat>&                images,
@@ -24,10 +24,6 @@ private:
     virtual void _detectImpl(
         const std::vector<cv::Mat>&                images,
         std::vector<std::vector<cv::Point>>* const out_featurePositions) const = 0;
-
-    void _writeImages(
-        const std::vector<cv::Mat>&                images,
-        const std::vector<std::vector<cv::Point>>& featurePositions) const;
 };
 
 // header implementation
@@ -36,30 +32,15 @@ inline void FeatureDetector::detect(
     const std::vector<cv::Mat>&                images,
     std::vector<std::vector<cv::Point>>* const out_featurePositions) const {
 
-    _detectImpl(images, out_featurePositions);
+    profiler::ScopedTimer timer("feature detection");
 
-#ifdef DRAW_FEATURE_IMAGES
-    _writeImages(images, *out_featurePositions);
-
-#endif
-}
-
-inline void FeatureDetector::_writeImages(
-    const std::vector<cv::Mat>&                images,
-    const std::vector<std::vector<cv::Point>>& featurePositions) const {
-    
-    for (std::size_t n = 0; n < images.size(); ++n) {
-        const std::vector<cv::Point>& features = featurePositions[n];
-        const std::size_t numFeatures = features.size();
+    const std::size_t numDetections = out_featurePositions->size();
+    _detectImpl(images, out_featurePositions);
 
-        cv::Mat tmpImage = images[n].clone();
-        for (std::size_t i = 0; i < numFeatures; ++i) {
-            cv::circle(tmpImage, cv::Point(features[i].x, features[i].y), 2, cv::Scalar(0, 0, 255), cv::FILLED);
+    if (profiler::isEnabled()) {
+        for (std::size_t n = numDetections; n < out_featurePositions->size(); ++n) {
+            profiler::count("features per image", static_cast<double>((*out_featurePositions)[n].size()));
         }
-
-        char filename[100];
-        sprintf(filename, "./result/feature/feature%02zd.png", n);
-        cv::imwrite(filename, tmpImage);
     }
 }
 
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "mathUtils.h"
+
+#include <cmath>
+#include <opencv2/opencv.hpp>
+
+namespace sis {
+
+/*
+    ImageAlignment stores image matching result of an image pair.
+
+    translation: integer alignment from image2 to image1 measured
+                 on the concate image (see ImageMatcher)
+
+    transform  : 3x3 matrix maps image2's pixel (x2, y2) to
+                 image1's pixel (x1, y1), both in local image coordinate.
+
+                 For translation-only matchers it is simply
+
+                 [1 0 image1.cols + translation.x]
+                 [0 1              translation.y]
+                 [0 0                          1]
+
+                 and richer matchers may store affine or
+                 homography transform here.
+
+    numInliers : number of feature matchings agreeing with transform
+
+    residual   : mean transfer error (in pixels) of these inliers
+
+    response   : peak value of phase correlation in [0, 1], it is
+                 only set by correlation-based (not feature-based)
+                 imageMatchers, a low peak means correlation failed
+*/
+struct ImageAlignment {
+    ImageAlignment() :
+        translation(0, 0),
+        transform(cv::Matx33d::eye()),
+        numInliers(0),
+        residual(0.0f),
+        response(0.0f) {
+    }
+
+    /*
+        Set translation as the movement of image2's center
+        under transform, measured on the concate image
+    */
+    void updateTranslation(const int image1Width, const cv::Size& image2Size) {
+        const cv::Point2f center(image2Size.width * 0.5f, image2Size.height * 0.5f);
+        const cv::Point2f moveCenter = mathUtils::transformPoint(transform, center);
+
+        translation = cv::Point(
+            static_cast<int>(std::lround(moveCenter.x - center.x - image1Width)),
+            static_cast<int>(std::lround(moveCenter.y - center.y)));
+    }
+
+    cv::Point   translation;
+    cv::Matx33d transform;
+    int         numInliers;
+    float       residual;
+    float       response;
+};
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,906 @@
+#include "core/imageBlender.h"
+
+#include "core/profiler.h"
+#include "mathUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+
+namespace sis {
+
+void ImageBlender::blend(
+    const std::vector<cv::Mat>&        images,
+    const std::vector<ImageAlignment>& imageAlignments,
+    const std::vector<cv::Mat>&        warpImageIndices,
+    const std::vector<float>&          imageGains,
+    const bool                         isCropped,
+    cv::Mat* const                     out_blendImage) const {
+
+    profiler::ScopedTimer timer("image blending");
+
+    std::vector<cv::Mat>        alignImages;
+    std::vector<cv::Mat>        alignImageIndices;
+    std::vector<ImageAlignment> alignImageAlignments;
+    const bool isWarpped = _warpResidualTransforms(images, imageAlignments, warpImageIndices,
+                                                   &alignImages, &alignImageIndices, &alignImageAlignments);
+
+    const std::vector<cv::Mat>&        blendImages          = isWarpped ? alignImages : images;
+    const std::vector<cv::Mat>&        blendImageIndices    = isWarpped ? alignImageIndices : warpImageIndices;
+    const std::vector<ImageAlignment>& blendImageAlignments = isWarpped ? alignImageAlignments : imageAlignments;
+
+    /*
+        Region blenders correct drifting per column, and others
+        per image (the same layout as their _blendImpl)
+    */
+    std::vector<cv::Point> imagePositions;
+    cv::Size               panoramaSize;
+    std::vector<int>       columnOffsets;
+    _calculatePanoramaLayout(blendImages, blendImageAlignments, &imagePositions, &panoramaSize,
+                             _supportsRegionBlending() ? &columnOffsets : nullptr);
+    if (columnOffsets.empty()) {
+        columnOffsets.assign(panoramaSize.width, 0);
+    }
+
+    const cv::Rect area = isCropped ?
+                          _calculateValidRect(blendImages, blendImageIndices, imagePositions,
+                                              columnOffsets, panoramaSize) :
+                          cv::Rect(cv::Point(0, 0), panoramaSize);
+
+    if (_supportsRegionBlending()) {
+        _log().progress() << "# Begin to blend images tile by tile"
+                          << std::endl;
+
+        std::vector<cv::Size> imageSizes;
+        for (const auto& image : blendImages) {
+            imageSizes.push_back(image.size());
+        }
+
+        std::vector<ImageTables> imageTables;
+        _calculateImageTables(imageSizes, blendImageAlignments, imageGains, imagePositions, columnOffsets, &imageTables);
+
+        /*
+            Tiles are blended straight into ROIs of the panorama,
+            so the dense result exists only once. Tile columns are
+            independent and blended in parallel (region blenders
+            run their own parallel loops serially inside).
+        */
+        cv::Mat panorama(area.size(), CV_8UC3, cv::Scalar::all(0));
+
+        const int tileSize       = CANVAS_TILE_SIZE;
+        const int numTilesAcross = (area.width  + tileSize - 1) / tileSize;
+        const int numTilesDown   = (area.height + tileSize - 1) / tileSize;
+        cv::parallel_for_(cv::Range(0, numTilesAcross), [&](const cv::Range& range) {
+            std::vector<cv::Point> tiles;
+            _collectCoveredTiles(imageTables, area, tileSize, numTilesDown, range.start, range.end, &tiles);
+
+            for (const auto& tile : tiles) {
+                const cv::Rect tileRect = cv::Rect(tile.x * tileSize, tile.y * tileSize, tileSize, tileSize) &
+                                          cv::Rect(cv::Point(0, 0), area.size());
+
+                cv::Mat blendTile = panorama(tileRect);
+                _blendRegionImpl(blendImages, blendImageIndices, imageTables, imagePositions, columnOffsets,
+                                 tileRect + area.tl(), &blendTile);
+            }
+        });
+
+        profiler::count("canvas bytes", static_cast<double>(panorama.total() * panorama.elemSize()));
+
+        *out_blendImage = panorama;
+
+        _log().progress() << "# Finish image blending"
+                          << std::endl;
+    }
+    else {
+        cv::Mat panorama;
+        _blendImpl(blendImages, blendImageAlignments, blendImageIndices, imageGains, &panorama);
+
+        *out_blendImage = panorama(area);
+    }
+}
+
+void ImageBlender::blend(
+    const std::vector<cv::Mat>&        images,
+    const std::vector<ImageAlignment>& imageAlignments,
+    const std::vector<cv::Mat>&        warpImageIndices,
+    const std::vector<float>&          imageGains,
+    const bool                         isCropped,
+    PanoramaSink* const                sink) const {
+
+    profiler::ScopedTimer timer("image blending");
+
+    std::vector<cv::Mat>        alignImages;
+    std::vector<cv::Mat>        alignImageIndices;
+    std::vector<ImageAlignment> alignImageAlignments;
+    const bool isWarpped = _warpResidualTransforms(images, imageAlignments, warpImageIndices,
+                                                   &alignImages, &alignImageIndices, &alignImageAlignments);
+
+    const std::vector<cv::Mat>&        blendImages          = isWarpped ? alignImages : images;
+    const std::vector<cv::Mat>&        blendImageIndices    = isWarpped ? alignImageIndices : warpImageIndices;
+    const std::vector<ImageAlignment>& blendImageAlignments = isWarpped ? alignImageAlignments : imageAlignments;
+
+    std::vector<cv::Point> imagePositions;
+    cv::Size               panoramaSize;
+    std::vector<int>       columnOffsets;
+    _calculatePanoramaLayout(blendImages, blendImageAlignments, &imagePositions, &panoramaSize,
+                             _supportsRegionBlending() ? &columnOffsets : nullptr);
+    if (columnOffsets.empty()) {
+        columnOffsets.assign(panoramaSize.width, 0);
+    }
+
+    const cv::Rect area = isCropped ?
+                          _calculateValidRect(blendImages, blendImageIndices, imagePositions,
+                                              columnOffsets, panoramaSize) :
+                          cv::Rect(cv::Point(0, 0), panoramaSize);
+
+    const int stripWidth = sink->stripWidth();
+    const int numStrips  = (area.width + stripWidth - 1) / stripWidth;
+
+    sink->begin(area.size());
+
+    if (_supportsRegionBlending()) {
+        _log().progress() << "# Begin to blend images strip by strip"
+                          << std::endl
+                          << "\r    Progress of strip blending: 0/" << numStrips
+                          << std::flush;
+
+        std::vector<cv::Size> imageSizes;
+        for (const auto& image : blendImages) {
+            imageSizes.push_back(image.size());
+        }
+
+        std::vector<ImageTables> imageTables;
+        _calculateImageTables(imageSizes, blendImageAlignments, imageGains, imagePositions, columnOffsets, &imageTables);
+
+        /*
+            Each strip is one column of canvas tiles,
+            and it is released once written to sink
+        */
+        TiledCanvas canvas(area, CV_8UC3, stripWidth);
+        for (int i = 0; i < numStrips; ++i) {
+            _blendCanvasTiles(blendImages, blendImageIndices, imageTables, imagePositions, columnOffsets,
+                              i, i + 1, &canvas);
+
+            const int stripX = i * stripWidth;
+            cv::Mat   strip;
+            canvas.copyTo(cv::Rect(stripX, 0,
+                                   std::min(stripWidth, area.width - stripX),
+                                   area.height),
+                          &strip);
+            sink->write(strip, stripX);
+
+            canvas.releaseTiles(i, i + 1);
+
+            _log().progress() << "\r    Progress of strip blending: " << (i + 1) << "/" << numStrips
+                              << std::flush;
+        }
+
+        _log().progress() << std::endl
+                          << "# Finish image blending"
+                          << std::endl;
+    }
+    else {
+        cv::Mat panorama;
+        _blendImpl(blendImages, blendImageAlignments, blendImageIndices, imageGains, &panorama);
+
+        const cv::Mat areaPanorama = panorama(area);
+        for (int i = 0; i < numStrips; ++i) {
+            const int stripX = i * stripWidth;
+            sink->write(areaPanorama(cv::Rect(stripX, 0,
+                                              std::min(stripWidth, area.width - stripX),
+                                              area.height)),
+                        stripX);
+        }
+    }
+
+    sink->end();
+}
+
+void ImageBlender::blend(
+    const ImageLoader&                         loadImage,
+    const std::vector<cv::Size>&               imageSizes,
+    const std::vector<std::vector<cv::Range>>& imageColumnSpans,
+    const std::vector<ImageAlignment>&         imageAlignments,
+    const std::vector<float>&                  imageGains,
+    const bool                                 isCropped,
+    PanoramaSink* const                        sink) const {
+
+    profiler::ScopedTimer timer("image blending");
+
+    if (!_supportsRegionBlending()) {
+        _log().warning() << "# Sliding-window blending needs a region blender, skip image blending"
+                          << std::endl;
+
+        return;
+    }
+
+    const int numImages = static_cast<int>(imageSizes.size());
+
+    std::vector<cv::Point> imagePositions;
+    cv::Size               panoramaSize;
+    std::vector<int>       columnOffsets;
+    _calculatePanoramaLayout(imageSizes, imageAlignments, &imagePositions, &panoramaSize, &columnOffsets);
+
+    const cv::Rect area = isCropped ?
+                          _calculateValidRect(imageColumnSpans, imagePositions, columnOffsets, panoramaSize) :
+                          cv::Rect(cv::Point(0, 0), panoramaSize);
+
+    const int stripWidth = sink->stripWidth();
+    const int numStrips  = (area.width + stripWidth - 1) / stripWidth;
+
+    sink->begin(area.size());
+
+    _log().progress() << "# Begin to blend images strip by strip in a sliding window"
+                      << std::endl
+                      << "\r    Progress of strip blending: 0/" << numStrips
+                      << std::flush;
+
+    /*
+        Images are placed from left to right, so the window
+        [firstImage, endImage) only moves forward. An image is
+        loaded when a strip (with the blender's region border)
+        reaches its left side and released once strips pass its
+        right side. Its tables are calculated once when it is loaded.
+    */
+    const int border = _regionBorder();
+
+    std::deque<cv::Mat>     windowImages;
+    std::deque<cv::Mat>     windowImageIndices;
+    std::deque<ImageTables> windowImageTables;
+    int                     firstImage = 0;
+    int                     endImage   = 0;
+
+    TiledCanvas canvas(area, CV_8UC3, stripWidth);
+    for (int i = 0; i < numStrips; ++i) {
+        const int stripX     = i * stripWidth;
+        const int stripBegin = area.x + stripX;
+        const int stripEnd   = std::min(stripBegin + stripWidth, area.x + area.width);
+
+        while (endImage < numImages && imagePositions[endImage].x < stripEnd + border) {
+            cv::Mat image;
+            cv::Mat imageIndex;
+            loadImage(endImage, &image, &imageIndex);
+
+            ImageTables imageTables;
+            _calculateImageTables(endImage, imageSizes[endImage], imageAlignments, imageGains,
+                                  imagePositions, columnOffsets, &imageTables);
+
+            windowImages.push_back(image);
+            windowImageIndices.push_back(imageIndex);
+            windowImageTables.push_back(imageTables);
+            ++endImage;
+        }
+
+        while (firstImage < endImage &&
+               imagePositions[firstImage].x + imageSizes[firstImage].width <= stripBegin - border) {
+
+            windowImages.pop_front();
+            windowImageIndices.pop_front();
+            windowImageTables.pop_front();
+            ++firstImage;
+        }
+
+        // image k of the window is image firstImage + k
+        const std::vector<cv::Mat>     images(windowImages.begin(), windowImages.end());
+        const std::vector<cv::Mat>     imageIndices(windowImageIndices.begin(), windowImageIndices.end());
+        const std::vector<ImageTables> tables(windowImageTables.begin(), windowImageTables.end());
+        const std::vector<cv::Point>   positions(imagePositions.begin() + firstImage,
+                                                 imagePositions.begin() + endImage);
+
+        _blendCanvasTiles(images, imageIndices, tables, positions, columnOffsets, i, i + 1, &canvas);
+
+        cv::Mat strip;
+        canvas.copyTo(cv::Rect(stripX, 0, stripEnd - stripBegin, area.height), &strip);
+        sink->write(strip, stripX);
+
+        canvas.releaseTiles(i, i + 1);
+
+        _log().progress() << "\r    Progress of strip blending: " << (i + 1) << "/" << numStrips
+                          << std::flush;
+    }
+
+    _log().progress() << std::endl
+                      << "# Finish image blending"
+                      << std::endl;
+
+    sink->end();
+}
+
+void ImageBlender::calculateColumnSpans(
+    const cv::Mat&                warpImageIndex,
+    std::vector<cv::Range>* const out_columnSpans) const {
+
+    std::vector<cv::Range>& columnSpans = *out_columnSpans;
+    columnSpans.assign(warpImageIndex.cols, cv::Range(0, 0));
+
+    for (int ix = 0; ix < warpImageIndex.cols; ++ix) {
+        int top = 0;
+        while (top < warpImageIndex.rows && warpImageIndex.at<float>(top, ix) <= 0.0f) {
+            ++top;
+        }
+
+        int bottom = warpImageIndex.rows;
+        while (bottom > top && warpImageIndex.at<float>(bottom - 1, ix) <= 0.0f) {
+            --bottom;
+        }
+
+        if (top < bottom) {
+            columnSpans[ix] = cv::Range(top, bottom);
+        }
+    }
+}
+
+bool ImageBlender::supportsRegionBlending() const {
+    return _supportsRegionBlending();
+}
+
+void ImageBlender::setDriftCorrection(const bool isDriftCorrected) {
+    _isDriftCorrected = isDriftCorrected;
+}
+
+int ImageBlender::regionBorder() const {
+    return _regionBorder();
+}
+
+void ImageBlender::blendRegion(
+    const std::vector<cv::Mat>&        images,
+    const std::vector<ImageAlignment>& imageAlignments,
+    const std::vector<cv::Mat>&        warpImageIndices,
+    const std::vector<float>&          imageGains,
+    const std::vector<cv::Point>&      imagePositions,
+    const std::vector<int>&            columnOffsets,
+    const cv::Rect&                    region,
+    cv::Mat* const                     out_blendRegion) const {
+
+    profiler::ScopedTimer timer("region blending");
+
+    std::vector<cv::Size> imageSizes;
+    for (const auto& image : images) {
+        imageSizes.push_back(image.size());
+    }
+
+    std::vector<ImageTables> imageTables;
+    _calculateImageTables(imageSizes, imageAlignments, imageGains, imagePositions, columnOffsets, &imageTables);
+
+    _blendRegionImpl(images, warpImageIndices, imageTables, imagePositions, columnOffsets, region, out_blendRegion);
+}
+
+cv::Rect ImageBlender::_calculateValidRect(
+    const std::vector<cv::Mat>&   images,
+    const std::vector<cv::Mat>&   warpImageIndices,
+    const std::vector<cv::Point>& imagePositions,
+    const std::vector<int>&       columnOffsets,
+    const cv::Size&               panoramaSize) const {
+
+    std::vector<std::vector<cv::Range>> imageColumnSpans(images.size());
+    for (std::size_t n = 0; n < images.size(); ++n) {
+        calculateColumnSpans(warpImageIndices[n], &imageColumnSpans[n]);
+    }
+
+    return _calculateValidRect(imageColumnSpans, imagePositions, columnOffsets, panoramaSize);
+}
+
+cv::Rect ImageBlender::_calculateValidRect(
+    const std::vector<std::vector<cv::Range>>& imageColumnSpans,
+    const std::vector<cv::Point>&              imagePositions,
+    const std::vector<int>&                    columnOffsets,
+    const cv::Size&                            panoramaSize) const {
+
+    const int width = panoramaSize.width;
+
+    /*
+        Valid span [tops[x], bottoms[x]) of each panorama column,
+        it is the union of spans of images covering the column
+        (if they are disjoint, the longer one is kept)
+    */
+    std::vector<int> tops(width, 0);
+    std::vector<int> bottoms(width, 0);
+    for (std::size_t n = 0; n < imageColumnSpans.size(); ++n) {
+        const std::vector<cv::Range>& columnSpans = imageColumnSpans[n];
+        const cv::Point&              position    = imagePositions[n];
+
+        for (int ix = 0; ix < static_cast<int>(columnSpans.size()); ++ix) {
+            if (columnSpans[ix].empty()) {
+                continue;
+            }
+
+            const int x = position.x + ix;
+            const int top    = columnSpans[ix].start + position.y + columnOffsets[x];
+            const int bottom = columnSpans[ix].end   + position.y + columnOffsets[x];
+
+            if (tops[x] >= bottoms[x]) {
+                tops[x]    = top;
+                bottoms[x] = bottom;
+            }
+            else if (top <= bottoms[x] && bottom >= tops[x]) {
+                tops[x]    = std::min(tops[x], top);
+                bottoms[x] = std::max(bottoms[x], bottom);
+            }
+            else if (bottom - top > bottoms[x] - tops[x]) {
+                tops[x]    = top;
+                bottoms[x] = bottom;
+            }
+        }
+    }
+
+    /*
+        The best rect can always be extended downward until some
+        column's span ends, so its bottom row is bottoms[x] - 1
+        of some column. For each candidate bottom row, pixel heights
+        of columns form a histogram, and the largest rect in the
+        histogram is found with a stack in linear time.
+    */
+    std::vector<int> bottomRows;
+    bottomRows.reserve(width);
+    for (int x = 0; x < width; ++x) {
+        if (tops[x] < bottoms[x]) {
+            bottomRows.push_back(bottoms[x] - 1);
+        }
+    }
+    std::sort(bottomRows.begin(), bottomRows.end());
+    bottomRows.erase(std::unique(bottomRows.begin(), bottomRows.end()), bottomRows.end());
+
+    long long bestArea = 0;
+    cv::Rect  bestRect(cv::Point(0, 0), panoramaSize);
+
+    std::vector<int> heights(width + 1, 0);
+    std::vector<int> stack;
+    stack.reserve(width + 1);
+    for (auto& y : bottomRows) {
+        for (int x = 0; x < width; ++x) {
+            heights[x] = (tops[x] <= y && y < bottoms[x]) ? y - tops[x] + 1 : 0;
+        }
+
+        // sentinel column of height 0 pops all remaining bars
+        heights[width] = 0;
+        stack.clear();
+        for (int x = 0; x <= width; ++x) {
+            while (!stack.empty() && heights[stack.back()] >= heights[x]) {
+                const int height = heights[stack.back()];
+                stack.pop_back();
+
+                const int beginX = stack.empty() ? 0 : stack.back() + 1;
+                const long long area = static_cast<long long>(height) * (x - beginX);
+                if (area > bestArea) {
+                    bestArea = area;
+                    bestRect = cv::Rect(beginX, y - height + 1, x - beginX, height);
+                }
+            }
+
+            stack.push_back(x);
+        }
+    }
+
+    _log().progress() << "    Crop panorama from " << panoramaSize.width << "x" << panoramaSize.height
+                      << " to " << bestRect.width << "x" << bestRect.height
+                      << " at (" << bestRect.x << ", " << bestRect.y << ")"
+                      << std::endl;
+
+    return bestRect;
+}
+
+void ImageBlender::_calculateImageTables(
+    const int                          n,
+    const cv::Size&                    imageSize,
+    const std::vector<ImageAlignment>& imageAlignments,
+    const std::vector<float>&          imageGains,
+    const std::vector<cv::Point>&      imagePositions,
+    const std::vector<int>&            columnOffsets,
+    ImageTables* const                 out_imageTables) const {
+
+    out_imageTables->rect = _calculateImageRect(imageSize, imagePositions[n], columnOffsets);
+
+    // images with gain 1 skip the lookup (no table)
+    out_imageTables->gainTable.clear();
+    if (imageGains[n] != 1.0f) {
+        _calculateGainTable(imageGains[n], &out_imageTables->gainTable);
+    }
+
+    _calculateWeightTable(n, imageSize, imageAlignments, &out_imageTables->weightTable);
+}
+
+void ImageBlender::_calculateImageTables(
+    const std::vector<cv::Size>&       imageSizes,
+    const std::vector<ImageAlignment>& imageAlignments,
+    const std::vector<float>&          imageGains,
+    const std::vector<cv::Point>&      imagePositions,
+    const std::vector<int>&            columnOffsets,
+    std::vector<ImageTables>* const    out_imageTables) const {
+
+    const int numImages = static_cast<int>(imageSizes.size());
+
+    out_imageTables->assign(numImages, ImageTables());
+    for (int n = 0; n < numImages; ++n) {
+        _calculateImageTables(n, imageSizes[n], imageAlignments, imageGains, imagePositions, columnOffsets,
+                              &(*out_imageTables)[n]);
+    }
+}
+
+void ImageBlender::_blendCanvasTiles(
+    const std::vector<cv::Mat>&        images,
+    const std::vector<cv::Mat>&        warpImageIndices,
+    const std::vector<ImageTables>&    imageTables,
+    const std::vector<cv::Point>&      imagePositions,
+    const std::vector<int>&            columnOffsets,
+    const int                          tileXBegin,
+    const int                          tileXEnd,
+    TiledCanvas* const                 canvas) const {
+
+    std::vector<cv::Point> tiles;
+    _collectCoveredTiles(imageTables, cv::Rect(canvas->origin(), canvas->size()), canvas->tileSize(),
+                         canvas->numTilesDown(), tileXBegin, tileXEnd, &tiles);
+
+    /*
+        Tiles are blended one by one, region blenders
+        composite rows of a tile in parallel
+    */
+    for (const auto& tile : tiles) {
+        cv::Mat blendTile;
+        _blendRegionImpl(images, warpImageIndices, imageTables, imagePositions, columnOffsets,
+                         canvas->tileRect(tile.x, tile.y) + canvas->origin(), &blendTile);
+        canvas->setTile(tile.x, tile.y, blendTile);
+    }
+}
+
+void ImageBlender::_collectCoveredTiles(
+    const std::vector<ImageTables>& imageTables,
+    const cv::Rect&                 area,
+    const int                       tileSize,
+    const int                       numTilesDown,
+    const int                       tileXBegin,
+    const int                       tileXEnd,
+    std::vector<cv::Point>* const   out_tiles) const {
+
+    /*
+        Collect tiles overlapping with any image, the rect of
+        each image is mapped to the range of tiles it covers,
+        so images are not tested against every tile
+    */
+    const int numTileXs = tileXEnd - tileXBegin;
+
+    std::vector<uchar> isCovered(static_cast<std::size_t>(numTilesDown) * numTileXs, 0);
+    for (const auto& tables : imageTables) {
+        const cv::Rect rect = (tables.rect & area) - area.tl();
+        if (rect.area() == 0) {
+            continue;
+        }
+
+        const int beginTileX = std::max(rect.x / tileSize, tileXBegin);
+        const int endTileX   = std::min((rect.x + rect.width - 1) / tileSize + 1, tileXEnd);
+        const int beginTileY = rect.y / tileSize;
+        const int endTileY   = (rect.y + rect.height - 1) / tileSize + 1;
+        for (int tileY = beginTileY; tileY < endTileY; ++tileY) {
+            for (int tileX = beginTileX; tileX < endTileX; ++tileX) {
+                isCovered[tileY * numTileXs + tileX - tileXBegin] = 1;
+            }
+        }
+    }
+
+    out_tiles->clear();
+    for (int tileY = 0; tileY < numTilesDown; ++tileY) {
+        for (int tileX = tileXBegin; tileX < tileXEnd; ++tileX) {
+            if (isCovered[tileY * numTileXs + tileX - tileXBegin]) {
+                out_tiles->push_back(cv::Point(tileX, tileY));
+            }
+        }
+    }
+}
+
+void ImageBlender::_calculateGainTable(const float gain, std::vector<uchar>* const out_gainTable) const {
+    out_gainTable->resize(256);
+    for (int v = 0; v < 256; ++v) {
+        (*out_gainTable)[v] = cv::saturate_cast<uchar>(v * gain);
+    }
+}
+
+void ImageBlender::_blendImpl(
+    const std::vector<cv::Mat>&,
+    const std::vector<ImageAlignment>&,
+    const std::vector<cv::Mat>&,
+    const std::vector<float>&,
+    cv::Mat* const) const {
+
+    throw std::logic_error("ImageBlender without region blending needs to override _blendImpl");
+}
+
+void ImageBlender::_blendRegionImpl(
+    const std::vector<cv::Mat>&,
+    const std::vector<cv::Mat>&,
+    const std::vector<ImageTables>&,
+    const std::vector<cv::Point>&,
+    const std::vector<int>&,
+    const cv::Rect&,
+    cv::Mat* const) const {
+
+    throw std::logic_error("ImageBlender supporting region blending needs to override _blendRegionImpl");
+}
+
+void ImageBlender::_calculateWeightTable(
+    const int,
+    const cv::Size&,
+    const std::vector<ImageAlignment>&,
+    std::vector<ushort>* const out_weightTable) const {
+
+    out_weightTable->clear();
+}
+
+bool ImageBlender::_supportsRegionBlending() const {
+    return false;
+}
+
+int ImageBlender::_regionBorder() const {
+    return 0;
+}
+
+bool ImageBlender::_warpResidualTransforms(
+    const std::vector<cv::Mat>&        images,
+    const std::vector<ImageAlignment>& imageAlignments,
+    const std::vector<cv::Mat>&        warpImageIndices,
+    std::vector<cv::Mat>* const        out_alignImages,
+    std::vector<cv::Mat>* const        out_alignImageIndices,
+    std::vector<ImageAlignment>* const out_alignImageAlignments) const {
+
+    /*
+        accumulateTransform: maps image n's pixel to image 1's pixel
+        origin             : where image n is placed by translations,
+                             also in image 1's coordinate
+
+        residual = translate(-origin) * accumulateTransform
+
+        For translation-only alignments residual is a translation
+        of less than a pixel per image (translations are rounded),
+        it is left to the translation placement, so images are
+        used directly without any copy. Only residuals with a
+        linear or perspective part are warpped.
+    */
+    const std::size_t numImages = images.size();
+
+    std::vector<cv::Matx33d> residuals;
+    residuals.reserve(numImages);
+    residuals.push_back(cv::Matx33d::eye());
+
+    bool        hasResidual         = false;
+    cv::Matx33d accumulateTransform = cv::Matx33d::eye();
+    cv::Point   origin(0, 0);
+    for (std::size_t n = 1; n < numImages; ++n) {
+        accumulateTransform = accumulateTransform * imageAlignments[n - 1].transform;
+        origin += cv::Point(images[n - 1].cols, 0) + imageAlignments[n - 1].translation;
+
+        const cv::Matx33d residual =
+            mathUtils::getTranslationTransform(-origin.x, -origin.y) * accumulateTransform;
+
+        // translation part (val[2] and val[5]) is ignored
+        const cv::Matx33d identity = cv::Matx33d::eye();
+        for (int i = 0; i < 9; ++i) {
+            if (i != 2 && i != 5 && std::abs(residual.val[i] - identity.val[i]) > 1e-6) {
+                hasResidual = true;
+            }
+        }
+
+        residuals.push_back(residual);
+    }
+
+    if (!hasResidual) {
+        return false;
+    }
+
+    /*
+        Each image is warpped into the bounding box of its warpped
+        corners, so content the residual moves out of the image
+        is kept. The box moves image n by offsets[n], and it is
+        limited to one image size around the image (ex. for a
+        degenerate homography).
+    */
+    std::vector<cv::Point> offsets(numImages, cv::Point(0, 0));
+
+    out_alignImages->reserve(numImages);
+    out_alignImageIndices->reserve(numImages);
+    for (std::size_t n = 0; n < numImages; ++n) {
+        if (n == 0) {
+            out_alignImages->push_back(images[n]);
+            out_alignImageIndices->push_back(warpImageIndices[n]);
+
+            continue;
+        }
+
+        const cv::Size size = images[n].size();
+
+        const std::vector<cv::Point2f> corners = { cv::Point2f(0.0f, 0.0f),
+                                                   cv::Point2f(static_cast<float>(size.width), 0.0f),
+                                                   cv::Point2f(0.0f, static_cast<float>(size.height)),
+                                                   cv::Point2f(static_cast<float>(size.width),
+                                                               static_cast<float>(size.height)) };
+
+        float minX = std::numeric_limits<float>::max();
+        float minY = std::numeric_limits<float>::max();
+        float maxX = std::numeric_limits<float>::lowest();
+        float maxY = std::numeric_limits<float>::lowest();
+        for (auto& corner : corners) {
+            const cv::Point2f warpCorner = mathUtils::transformPoint(residuals[n], corner);
+            minX = std::min(minX, warpCorner.x);
+            minY = std::min(minY, warpCorner.y);
+            maxX = std::max(maxX, warpCorner.x);
+            maxY = std::max(maxY, warpCorner.y);
+        }
+
+        const cv::Rect limit(-size.width, -size.height, 3 * size.width, 3 * size.height);
+        const int      beginX = std::max(static_cast<int>(std::floor(minX)), limit.x);
+        const int      beginY = std::max(static_cast<int>(std::floor(minY)), limit.y);
+        const int      endX   = std::min(static_cast<int>(std::ceil(maxX)), limit.x + limit.width);
+        const int      endY   = std::min(static_cast<int>(std::ceil(maxY)), limit.y + limit.height);
+        const cv::Size box(std::max(endX - beginX, 1), std::max(endY - beginY, 1));
+
+        const cv::Mat residual(mathUtils::getTranslationTransform(-beginX, -beginY) * residuals[n]);
+
+        cv::Mat alignImage;
+        cv::Mat alignImageIndex;
+        cv::warpPerspective(images[n], alignImage, residual, box, cv::INTER_LINEAR);
+        cv::warpPerspective(warpImageIndices[n], alignImageIndex, residual, box, cv::INTER_NEAREST);
+
+        out_alignImages->push_back(alignImage);
+        out_alignImageIndices->push_back(alignImageIndex);
+        offsets[n] = cv::Point(beginX, beginY);
+    }
+
+    /*
+        Warpped images are translation-only, translation of pair
+        (n-1, n) is changed so that the layout places warpped
+        image n at its old position + offsets[n], even if the
+        width of warpped image n-1 changed
+    */
+    std::vector<ImageAlignment>& alignImageAlignments = *out_alignImageAlignments;
+    alignImageAlignments = imageAlignments;
+    for (std::size_t n = 1; n < numImages; ++n) {
+        const int width      = images[n - 1].cols;
+        const int alignWidth = (*out_alignImages)[n - 1].cols;
+
+        ImageAlignment& alignment = alignImageAlignments[n - 1];
+        alignment.translation += cv::Point(width - alignWidth, 0) + offsets[n] - offsets[n - 1];
+        alignment.transform    = mathUtils::getTranslationTransform(alignWidth + alignment.translation.x,
+                                                                    alignment.translation.y);
+    }
+
+    return true;
+}
+
+void ImageBlender::_calculatePanoramaLayout(
+    const std::vector<cv::Mat>&        images,
+    const std::vector<ImageAlignment>& imageAlignments,
+    std::vector<cv::Point>* const      out_imagePositions,
+    cv::Size* const                    out_panoramaSize,
+    std::vector<int>* const            out_columnOffsets) const {
+
+    std::vector<cv::Size> imageSizes;
+    imageSizes.reserve(images.size());
+    for (const auto& image : images) {
+        imageSizes.push_back(image.size());
+    }
+
+    _calculatePanoramaLayout(imageSizes, imageAlignments, out_imagePositions, out_panoramaSize, out_columnOffsets);
+}
+
+void ImageBlender::_calculatePanoramaLayout(
+    const std::vector<cv::Size>&       imageSizes,
+    const std::vector<ImageAlignment>& imageAlignments,
+    std::vector<cv::Point>* const      out_imagePositions,
+    cv::Size* const                    out_panoramaSize,
+    std::vector<int>* const            out_columnOffsets) const {
+
+    const int numImages = static_cast<int>(imageSizes.size());
+
+    /*
+        Image n is placed at the right side of image n-1,
+        and then moved by translation of image pair (n-1, n)
+    */
+    std::vector<cv::Point> positions;
+    positions.reserve(numImages);
+    positions.push_back(cv::Point(0, 0));
+
+    for (int n = 1; n < numImages; ++n) {
+        positions.push_back(positions[n - 1] +
+                            cv::Point(imageSizes[n - 1].width, 0) +
+                            imageAlignments[n - 1].translation);
+    }
+
+    /*
+        Move all images right so that the left one begins at x = 0,
+        a negative translation may place image n left of image 0
+    */
+    int minX = std::numeric_limits<int>::max();
+    for (int n = 0; n < numImages; ++n) {
+        minX = std::min(minX, positions[n].x);
+    }
+
+    int allWidth = 0;
+    for (int n = 0; n < numImages; ++n) {
+        positions[n].x -= minX;
+        allWidth = std::max(allWidth, positions[n].x + imageSizes[n].width);
+    }
+
+    /*
+        Drifting shows as a slope of image centers, fit it by
+        least squares, the correction of column x is
+
+        columnOffset(x) = -slope * (x - firstCenterX)
+
+        It is a vertical shear, so overlapping pixels of an
+        image pair are moved together and stay aligned
+    */
+    double slope = 0.0;
+    if (_isDriftCorrected && numImages > 2) {
+        double meanX = 0.0;
+        double meanY = 0.0;
+        for (int n = 0; n < numImages; ++n) {
+            meanX += (positions[n].x + imageSizes[n].width * 0.5) / numImages;
+            meanY += (positions[n].y + imageSizes[n].height * 0.5) / numImages;
+        }
+
+        double sumXY = 0.0;
+        double sumXX = 0.0;
+        for (int n = 0; n < numImages; ++n) {
+            const double dx = positions[n].x + imageSizes[n].width * 0.5 - meanX;
+            const double dy = positions[n].y + imageSizes[n].height * 0.5 - meanY;
+            sumXY += dx * dy;
+            sumXX += dx * dx;
+        }
+
+        slope = (sumXX > 0.0) ? sumXY / sumXX : 0.0;
+    }
+
+    const double firstCenterX = positions[0].x + imageSizes[0].width * 0.5;
+
+    std::vector<int> columnOffsets(allWidth);
+    for (int x = 0; x < allWidth; ++x) {
+        columnOffsets[x] = static_cast<int>(std::lround(-slope * (x - firstCenterX)));
+    }
+
+    if (!out_columnOffsets) {
+        for (int n = 0; n < numImages; ++n) {
+            positions[n].y += columnOffsets[positions[n].x + imageSizes[n].width / 2];
+        }
+
+        std::fill(columnOffsets.begin(), columnOffsets.end(), 0);
+    }
+
+    /*
+        Move all images down so that the top one begins at y = 0
+    */
+    int minY = std::numeric_limits<int>::max();
+    for (int n = 0; n < numImages; ++n) {
+        minY = std::min(minY, _calculateImageRect(imageSizes[n], positions[n], columnOffsets).y);
+    }
+
+    int allHeight = 0;
+    for (int n = 0; n < numImages; ++n) {
+        positions[n].y -= minY;
+
+        const cv::Rect imageRect = _calculateImageRect(imageSizes[n], positions[n], columnOffsets);
+        allHeight = std::max(allHeight, imageRect.y + imageRect.height);
+    }
+
+    *out_imagePositions = positions;
+    *out_panoramaSize   = cv::Size(allWidth, allHeight);
+
+    if (out_columnOffsets) {
+        *out_columnOffsets = columnOffsets;
+    }
+}
+
+cv::Rect ImageBlender::_calculateImageRect(
+    const cv::Size&         imageSize,
+    const cv::Point&        imagePosition,
+    const std::vector<int>& columnOffsets) const {
+
+    const auto beginOffset = columnOffsets.begin() + imagePosition.x;
+    const auto endOffset   = beginOffset + imageSize.width;
+    const auto minMax      = std::minmax_element(beginOffset, endOffset);
+
+    return cv::Rect(imagePosition.x,
+                    imagePosition.y + *minMax.first,
+                    imageSize.width,
+                    imageSize.height + *minMax.second - *minMax.first);
+}
+
+} // namespace sis
\ No newline at end of file
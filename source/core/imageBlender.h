@@ -1,8 +1,11 @@
 #pragma once
 
-#include "config.h"
+#include "core/imageAlignment.h"
+#include "core/logger.h"
+#include "core/panoramaSink.h"
+#include "core/tiledCanvas.h"
 
-#include <cstdio>
+#include <functional>
 #include <opencv2/opencv.hpp>
 #include <vector>
 
@@ -11,46 +14,295 @@ namespace sis {
 /*
     ImageBlender is used for image blending between image pairs.
 
+    Blenders place images by translation of imageAlignments.
+    If imageAlignments come with richer transforms (affine, homography),
+    every image is first warped by its residual transform, which is
+    the accumulated transform minus its translation placement, into
+    the bounding box of its warpped corners (nothing is cut off).
+
     out_blendImage: it stores stitched image result, image pair
                     overlapping regions use blend function to blend.
-                    
+
+    Blending to a PanoramaSink produces panorama strip by strip.
+    Blenders which can blend any panorama region independently
+    only keep one strip in memory, others blend the whole panorama
+    first and then hand it to the sink in strips.
+
+    Region blenders blend tile by tile (tile columns in parallel),
+    only tiles covered by some image are blended. Streaming blends
+    on a TiledCanvas, and a cv::Mat result is blended in place.
+
+    isCropped: panorama is cropped to the largest axis-aligned rect
+               which is fully covered by valid pixels. Region blenders
+               only allocate and blend this rect.
+
+    imageGains: exposure gain of each image, blenders scale pixel
+                values by them on the fly while compositing.
+
+    Drifting (image centers climbing or falling along the panorama)
+    is straightened by a vertical shear fitted to the image centers,
+    unless it is turned off by setDriftCorrection (ex. alignments are
+    bundle adjusted already).
+
+    Sliding-window blending loads images on demand, only images
+    overlapping the current strip are kept in memory, so sequences
+    of any length are blended in bounded memory. It needs a region
+    blender and translation-only imageAlignments.
 */
-class ImageBlender {
+class ImageBlender : public Loggable {
 public:
+    // load (warpped) image n and its warpped image index
+    using ImageLoader = std::function<void(const int n, cv::Mat* const out_image, cv::Mat* const out_imageIndex)>;
+
+    void blend(
+        const std::vector<cv::Mat>&        images,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        const std::vector<float>&          imageGains,
+        const bool                         isCropped,
+        cv::Mat* const                     out_blendImage) const;
+
     void blend(
-        const std::vector<cv::Mat>&   images, 
-        const std::vector<cv::Point>& imageAlignments, 
+        const std::vector<cv::Mat>&        images,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        const std::vector<float>&          imageGains,
+        const bool                         isCropped,
+        PanoramaSink* const                sink) const;
+
+    /*
+        Sliding-window blending to a PanoramaSink
+
+        imageSizes      : size of each image
+        imageColumnSpans: valid rows of each image column
+                          (see calculateColumnSpans), used for cropping
+    */
+    void blend(
+        const ImageLoader&                         loadImage,
+        const std::vector<cv::Size>&               imageSizes,
+        const std::vector<std::vector<cv::Range>>& imageColumnSpans,
+        const std::vector<ImageAlignment>&         imageAlignments,
+        const std::vector<float>&                  imageGains,
+        const bool                                 isCropped,
+        PanoramaSink* const                        sink) const;
+
+    /*
+        Valid rows [start, end) of each column of warpped image index,
+        empty range if the column has no valid pixel
+    */
+    void calculateColumnSpans(
+        const cv::Mat&                 warpImageIndex,
+        std::vector<cv::Range>* const  out_columnSpans) const;
+
+    bool supportsRegionBlending() const;
+
+    // drifting is corrected by default
+    void setDriftCorrection(const bool isDriftCorrected);
+
+    /*
+        Region blenders may read images up to this many pixels
+        around a region (ex. pyramids of multi-band blending),
+        images within it need to be given when blending the region
+    */
+    int regionBorder() const;
+
+    /*
+        Blend one panorama region with images placed at imagePositions,
+        it is only supported by region blenders (see _blendRegionImpl)
+    */
+    void blendRegion(
+        const std::vector<cv::Mat>&        images,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        const std::vector<float>&          imageGains,
+        const std::vector<cv::Point>&      imagePositions,
+        const std::vector<int>&            columnOffsets,
+        const cv::Rect&                    region,
+        cv::Mat* const                     out_blendRegion) const;
+
+protected:
+    /*
+        Per-image data region blenders use for every region of one
+        blend, it is calculated once per blend instead of per region
+
+        rect       : bounding rect of the image on the panorama
+        gainTable  : gain lookup table (see _calculateGainTable),
+                     empty if the gain is 1
+        weightTable: per-column blending weights of the blender
+                     (see _calculateWeightTable), empty if it has none
+    */
+    struct ImageTables {
+        cv::Rect            rect;
+        std::vector<uchar>  gainTable;
+        std::vector<ushort> weightTable;
+    };
+
+    /*
+        Calculate where each image is placed on the panorama
+        by accumulating translations of imageAlignments
+        (the first image is placed at x = 0)
+
+        Vertical drifting (slope of image centers) is corrected too.
+        If out_columnOffsets is given, the correction is returned as
+        y-offset of each panorama column, and pixel (x, y) of image n
+        is placed at (x, y + columnOffsets[x]) + imagePositions[n].
+        Otherwise each image is simply moved by the offset at its center.
+    */
+    void _calculatePanoramaLayout(
+        const std::vector<cv::Mat>&        images,
+        const std::vector<ImageAlignment>& imageAlignments,
+        std::vector<cv::Point>* const      out_imagePositions,
+        cv::Size* const                    out_panoramaSize,
+        std::vector<int>* const            out_columnOffsets = nullptr) const;
+
+    void _calculatePanoramaLayout(
+        const std::vector<cv::Size>&       imageSizes,
+        const std::vector<ImageAlignment>& imageAlignments,
+        std::vector<cv::Point>* const      out_imagePositions,
+        cv::Size* const                    out_panoramaSize,
+        std::vector<int>* const            out_columnOffsets = nullptr) const;
+
+    /*
+        Bounding rect of image on the panorama,
+        including its column offsets
+    */
+    cv::Rect _calculateImageRect(
+        const cv::Size&         imageSize,
+        const cv::Point&        imagePosition,
+        const std::vector<int>& columnOffsets) const;
+
+    /*
+        Largest axis-aligned rect of the panorama in which every pixel
+        is valid, it is found from the valid span of each column
+    */
+    cv::Rect _calculateValidRect(
+        const std::vector<cv::Mat>&   images,
         const std::vector<cv::Mat>&   warpImageIndices,
-        cv::Mat* const                out_blendImage) const;
+        const std::vector<cv::Point>& imagePositions,
+        const std::vector<int>&       columnOffsets,
+        const cv::Size&               panoramaSize) const;
+
+    cv::Rect _calculateValidRect(
+        const std::vector<std::vector<cv::Range>>& imageColumnSpans,
+        const std::vector<cv::Point>&              imagePositions,
+        const std::vector<int>&                    columnOffsets,
+        const cv::Size&                            panoramaSize) const;
+
+    // tables of image n, it uses alignment of image pair (n-1, n)
+    void _calculateImageTables(
+        const int                          n,
+        const cv::Size&                    imageSize,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<float>&          imageGains,
+        const std::vector<cv::Point>&      imagePositions,
+        const std::vector<int>&            columnOffsets,
+        ImageTables* const                 out_imageTables) const;
+
+    void _calculateImageTables(
+        const std::vector<cv::Size>&       imageSizes,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<float>&          imageGains,
+        const std::vector<cv::Point>&      imagePositions,
+        const std::vector<int>&            columnOffsets,
+        std::vector<ImageTables>* const    out_imageTables) const;
+
+    /*
+        Blend tiles in columns [tileXBegin, tileXEnd) of canvas
+        one by one with _blendRegionImpl, tiles no image
+        lands on are skipped and stay unallocated
+    */
+    void _blendCanvasTiles(
+        const std::vector<cv::Mat>&        images,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        const std::vector<ImageTables>&    imageTables,
+        const std::vector<cv::Point>&      imagePositions,
+        const std::vector<int>&            columnOffsets,
+        const int                          tileXBegin,
+        const int                          tileXEnd,
+        TiledCanvas* const                 canvas) const;
+
+    /*
+        Tiles in columns [tileXBegin, tileXEnd) of area (tile
+        coordinate) which some image lands on, row by row
+    */
+    void _collectCoveredTiles(
+        const std::vector<ImageTables>& imageTables,
+        const cv::Rect&                 area,
+        const int                       tileSize,
+        const int                       numTilesDown,
+        const int                       tileXBegin,
+        const int                       tileXEnd,
+        std::vector<cv::Point>* const   out_tiles) const;
+
+    /*
+        Lookup table of pixel values scaled by gain,
+        table[v] = saturate(v * gain)
+    */
+    void _calculateGainTable(const float gain, std::vector<uchar>* const out_gainTable) const;
 
 private:
+    /*
+        Blend the whole panorama.
+        It is used if _supportsRegionBlending() returns false,
+        and throws std::logic_error unless it is overridden.
+    */
     virtual void _blendImpl(
-        const std::vector<cv::Mat>&   images,
-        const std::vector<cv::Point>& imageAlignments,
-        const std::vector<cv::Mat>&   warpImageIndices,
-        cv::Mat* const                out_blendImage) const = 0;
+        const std::vector<cv::Mat>&        images,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        const std::vector<float>&          imageGains,
+        cv::Mat* const                     out_blendImage) const;
 
-    void _writeImage(const cv::Mat& blendImage) const;
-};
+    /*
+        Blend panorama region only, out_blendRegion has region's size.
+        If out_blendRegion already has region's size and CV_8UC3
+        (ex. an ROI of the panorama), it is blended in place.
+        It is used if _supportsRegionBlending() returns true, and
+        drifting is corrected by columnOffsets while compositing.
+        Blenders parallelize inside the region, if regions are blended
+        in parallel (ex. tile columns), OpenCV runs the nested loops
+        serially. It throws std::logic_error unless it is overridden.
+    */
+    virtual void _blendRegionImpl(
+        const std::vector<cv::Mat>&     images,
+        const std::vector<cv::Mat>&     warpImageIndices,
+        const std::vector<ImageTables>& imageTables,
+        const std::vector<cv::Point>&   imagePositions,
+        const std::vector<int>&         columnOffsets,
+        const cv::Rect&                 region,
+        cv::Mat* const                  out_blendRegion) const;
 
-// header implementation
+    virtual bool _supportsRegionBlending() const;
 
-inline void ImageBlender::blend(
-    const std::vector<cv::Mat>&   images,
-    const std::vector<cv::Point>& imageAlignments,
-    const std::vector<cv::Mat>&   warpImageIndices,
-    cv::Mat* const                out_blendImage) const {
+    virtual int _regionBorder() const;
 
-    _blendImpl(images, imageAlignments, warpImageIndices, out_blendImage);
+    /*
+        Per-column blending weights of image n (in image columns),
+        region blenders with weight tables override it
+    */
+    virtual void _calculateWeightTable(
+        const int                          n,
+        const cv::Size&                    imageSize,
+        const std::vector<ImageAlignment>& imageAlignments,
+        std::vector<ushort>* const         out_weightTable) const;
 
-#ifdef DRAW_BLEND_IMAGES
-    _writeImage(*out_blendImage);
+    /*
+        Warp images by their residual transforms, it returns false
+        (and outputs nothing) for translation-only alignments.
+        out_alignImageAlignments are translation-only alignments
+        placing the warpped images.
+    */
+    bool _warpResidualTransforms(
+        const std::vector<cv::Mat>&        images,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        std::vector<cv::Mat>* const        out_alignImages,
+        std::vector<cv::Mat>* const        out_alignImageIndices,
+        std::vector<ImageAlignment>* const out_alignImageAlignments) const;
 
-#endif
-}
+    static constexpr int CANVAS_TILE_SIZE = 256;
 
-inline void ImageBlender::_writeImage(const cv::Mat& blendImage) const {
-    cv::imwrite("./result/blend/blendImage_result.png", blendImage);
-}
+    bool _isDriftCorrected = true;
+};
 
 } // namespace sis
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "core/imageAlignment.h"
+#include "core/logger.h"
+#include "core/profiler.h"
+
 #include <opencv2/opencv.hpp>
 #include <vector>
 
@@ -12,7 +16,7 @@ namespace sis {
     out_imageAlignments: It stores all image matching alignments
                          between image pairs.
 
-                         take image 1-2 pair for example, cv::Pointt
+                         take image 1-2 pair for example, its translation
                          would store alignment from image2 to image1
 
                          Ex. cv::Point(-5, 3)
@@ -33,14 +37,56 @@ namespace sis {
                          |          |          |           |      |   |      |
                          +----------+----------+           +------+---+      |
                                                                   +----------+
+
+                         Matchers with richer transform models also fill
+                         ImageAlignment::transform, and translation is then
+                         the movement of image2's center under it.
 */
-class ImageMatcher {
+class ImageMatcher : public Loggable {
 public:
-    virtual void match(
+    void match(
+        const std::vector<cv::Mat>&                          images,
+        const std::vector<std::vector<cv::Point>>&           featurePositions,
+        const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+        std::vector<ImageAlignment>* const                   out_imageAlignments) const;
+
+    /*
+        Feature-free matchers return false here, then feature detection,
+        descriptor calculation and feature matching would be skipped
+        and match() gets empty featurePositions and featureMatchings.
+    */
+    virtual bool isFeatureBased() const;
+
+private:
+    virtual void _matchImpl(
         const std::vector<cv::Mat>&                          images,
         const std::vector<std::vector<cv::Point>>&           featurePositions,
         const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
-        std::vector<cv::Point>* const                        out_imageAlignments) const = 0;
+        std::vector<ImageAlignment>* const                   out_imageAlignments) const = 0;
 };
 
+// header implementation
+
+inline void ImageMatcher::match(
+    const std::vector<cv::Mat>&                          images,
+    const std::vector<std::vector<cv::Point>>&           featurePositions,
+    const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+    std::vector<ImageAlignment>* const                   out_imageAlignments) const {
+
+    profiler::ScopedTimer timer("image matching");
+
+    const std::size_t numAlignments = out_imageAlignments->size();
+    _matchImpl(images, featurePositions, featureMatchings, out_imageAlignments);
+
+    if (profiler::isEnabled()) {
+        for (std::size_t i = numAlignments; i < out_imageAlignments->size(); ++i) {
+            profiler::count("inliers per pair", (*out_imageAlignments)[i].numInliers);
+        }
+    }
+}
+
+inline bool ImageMatcher::isFeatureBased() const {
+    return true;
+}
+
 } // namespace sis
\ No newline at end of file
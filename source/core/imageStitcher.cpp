@@ -1,17 +1,34 @@
 #include "core/imageStitcher.h"
 
-#include "bundleAdjuster/perspectiveBundleAdjuster.h"
+#include "bundleAdjuster/levenbergMarquardtBundleAdjuster.h"
 #include "commandArgument.h"
+#include "core/bufferPool.h"
+#include "core/debugImageWriter.h"
+#include "core/featureCache.h"
+#include "core/taskScheduler.h"
+#include "core/warpTableCache.h"
+#include "exposureCompensator/gainExposureCompensator.h"
 #include "featureDescriptor/siftFeatureDescriptor.h"
 #include "featureDetector/harrisFeatureDetector.h"
 #include "featureMatcher/bruteForceFeatureMatcher.h"
 #include "imageBlender/linearAlphaImageBlender.h"
+#include "imageBlender/multiBandImageBlender.h"
+#include "imageBlender/seamImageBlender.h"
+#include "imageMatcher/phaseCorrelationImageMatcher.h"
+#include "imageMatcher/prosacImageMatcher.h"
 #include "imageMatcher/ransacImageMatcher.h"
 #include "imageWarpper/cylindricalImageWarpper.h"
+#include "mathUtils.h"
+#include "panoramaSink/matPanoramaSink.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 
 #if (defined(_MSC_VER) || \
      (defined(__GNUC__) && (__GNUC_MAJOR__ >= 8))) 
@@ -25,17 +42,95 @@
 namespace sis {
 
 ImageStitcher::ImageStitcher(const CommandArgument& arguments) :
+    ImageStitcher({}, {}, arguments, Logger::console(), nullptr) {
+}
+
+ImageStitcher::ImageStitcher(const CommandArgument& arguments, const Logger& logger) :
+    ImageStitcher({}, {}, arguments, logger, nullptr) {
+}
+
+ImageStitcher::ImageStitcher(
+    const CommandArgument&             arguments,
+    const Logger&                      logger,
+    const std::shared_ptr<WorkerPool>& workerPool) :
+
+    ImageStitcher({}, {}, arguments, logger, workerPool, nullptr) {
+}
+
+ImageStitcher::ImageStitcher(
+    const CommandArgument&                 arguments,
+    const Logger&                          logger,
+    const std::shared_ptr<WorkerPool>&     workerPool,
+    const std::shared_ptr<WarpTableCache>& warpTableCache) :
+
+    ImageStitcher({}, {}, arguments, logger, workerPool, warpTableCache) {
+}
+
+ImageStitcher::ImageStitcher(
+    const std::vector<cv::Mat>& images,
+    const std::vector<float>&   focalLengths,
+    const CommandArgument&      arguments) :
+
+    ImageStitcher(images, focalLengths, arguments, Logger::console(), nullptr) {
+}
+
+ImageStitcher::ImageStitcher(
+    const std::vector<cv::Mat>& images,
+    const std::vector<float>&   focalLengths,
+    const CommandArgument&      arguments,
+    const Logger&               logger) :
+
+    ImageStitcher(images, focalLengths, arguments, logger, nullptr) {
+}
+
+ImageStitcher::ImageStitcher(
+    const std::vector<cv::Mat>&        images,
+    const std::vector<float>&          focalLengths,
+    const CommandArgument&             arguments,
+    const Logger&                      logger,
+    const std::shared_ptr<WorkerPool>& workerPool) :
+
+    ImageStitcher(images, focalLengths, arguments, logger, workerPool, nullptr) {
+}
+
+ImageStitcher::ImageStitcher(
+    const std::vector<cv::Mat>&            images,
+    const std::vector<float>&              focalLengths,
+    const CommandArgument&                 arguments,
+    const Logger&                          logger,
+    const std::shared_ptr<WorkerPool>&     workerPool,
+    const std::shared_ptr<WarpTableCache>& warpTableCache) :
+
+    _logger(logger),
     _images(),
+    _sourceImages(),
     _focalLengths(),
+    _imageFilenames(),
+    _sizeRatio(1.0f),
+    _realignSizeRatio(1.0f),
+    _isCropped(true),
+    _isSlidingWindow(false),
+    _workerPool(workerPool),
     _imageWarpper(nullptr),
     _featureDetector(nullptr),
     _featureDescriptor(nullptr),
     _featureMatcher(nullptr),
     _imageMatcher(nullptr),
+    _exposureCompensator(nullptr),
     _imageBlender(nullptr),
-    _bundleAdjuster(nullptr) {
+    _bundleAdjuster(nullptr),
+    _debugImageWriter(nullptr),
+    _featureCache(nullptr),
+    _progressHook(),
+    _cancelFlag(nullptr),
+    _appendedFrames(),
+    _appendedTiles(),
+    _appendedColumnOffsets(),
+    _appendedBounds(),
+    _numAppendedFrames(0) {
 
     const std::string sizeRatio           = arguments.find("sizeRatio", "1.0");
+    const std::string realignSizeRatio    = arguments.find("realignSizeRatio", "");
     const std::string imageDirectory      = arguments.find("imageDirectory");
     const std::string focalLengthFilename = arguments.find("focalLengthFilename");
     const std::string imageWarpper        = arguments.find("imageWarpper", "cylindrical");
@@ -43,43 +138,75 @@ ImageStitcher::ImageStitcher(const CommandArgument& arguments) :
     const std::string featureDescriptor   = arguments.find("featureDescriptor", "sift");
     const std::string featureMatcher      = arguments.find("featureMatcher", "brute-force");
     const std::string imageMatcher        = arguments.find("imageMatcher", "ransac");
+    const std::string exposureCompensator = arguments.find("exposureCompensator", "none");
     const std::string imageBlender        = arguments.find("imageBlender", "linear-alpha");
-    const std::string bundleAdjuster      = arguments.find("bundleAdjuster", "perspective");
+    const std::string bundleAdjuster      = arguments.find("bundleAdjuster", "levenberg-marquardt");
+    const std::string autoCrop            = arguments.find("autoCrop", "on");
+    const std::string slidingWindow       = arguments.find("slidingWindow", "off");
+    const std::string numThreads          = arguments.find("numThreads", "");
+    const std::string debugImages         = arguments.find("debugImages", "off");
+    const std::string featureCache        = arguments.find("featureCache", "");
+    const std::string cacheImagePairs     = arguments.find("cacheImagePairs", "on");
+    const std::string bufferPoolSize      = arguments.find("bufferPoolSize", "auto");
 
-    // decide which imageWarpper to use
+    // decide which imageWarpper to use, warp tables may be shared with other stitchers
+    const std::shared_ptr<WarpTableCache> tableCache = warpTableCache ?
+                                                       warpTableCache :
+                                                       std::make_shared<WarpTableCache>();
     if (imageWarpper == "cylindrical") {
-        _imageWarpper = std::make_unique<CylindricalImageWarpper>();
+        _imageWarpper = std::make_unique<CylindricalImageWarpper>(tableCache);
     }
     else {
-        std::cout << "Unknown imageWarpper type: <"
-                  << imageWarpper << ">, use <cylindrical> instead"
-                  << std::endl;
+        _logger.warning() << "Unknown imageWarpper type: <"
+                          << imageWarpper << ">, use <cylindrical> instead"
+                          << std::endl;
 
-        _imageWarpper = std::make_unique<CylindricalImageWarpper>();
+        _imageWarpper = std::make_unique<CylindricalImageWarpper>(tableCache);
+    }
+
+    /*
+        Feature stages share one pool of per-image intermediate images,
+        by default it is sized by the working set of images in flight
+    */
+    std::shared_ptr<BufferPool> bufferPool;
+    if (bufferPoolSize == "auto") {
+        bufferPool = std::make_shared<BufferPool>();
+    }
+    else if (!bufferPoolSize.empty() && bufferPoolSize.size() <= 9 &&
+             bufferPoolSize.find_first_not_of("0123456789") == std::string::npos) {
+        // at most 9 digits (MB), so it fits size_t in bytes
+        bufferPool = std::make_shared<BufferPool>(static_cast<std::size_t>(std::stoll(bufferPoolSize)) * 1024 * 1024);
+    }
+    else {
+        _logger.warning() << "Unknown bufferPoolSize: <"
+                          << bufferPoolSize << ">, use <auto> instead"
+                          << std::endl;
+
+        bufferPool = std::make_shared<BufferPool>();
     }
 
     // decide which featureDetector to use
     if (featureDetector == "harris") {
-        _featureDetector = std::make_unique<HarrisFeatureDetector>();
+        _featureDetector = std::make_unique<HarrisFeatureDetector>(bufferPool);
     }
     else {
-        std::cout << "Unknown featureDetector type: <"
-                  << featureDetector << ">, use <harris> instead"
-                  << std::endl;
+        _logger.warning() << "Unknown featureDetector type: <"
+                          << featureDetector << ">, use <harris> instead"
+                          << std::endl;
 
-        _featureDetector = std::make_unique<HarrisFeatureDetector>();
+        _featureDetector = std::make_unique<HarrisFeatureDetector>(bufferPool);
     }
 
     // decide which featureDescriptor to use
     if (featureDescriptor == "sift") {
-        _featureDescriptor = std::make_unique<SiftFeatureDescriptor>();
+        _featureDescriptor = std::make_unique<SiftFeatureDescriptor>(bufferPool);
     }
     else {
-        std::cout << "Unknown featureDescriptor type: <"
-                  << featureDescriptor << ">, use <sift> instead"
-                  << std::endl;
+        _logger.warning() << "Unknown featureDescriptor type: <"
+                          << featureDescriptor << ">, use <sift> instead"
+                          << std::endl;
 
-        _featureDescriptor = std::make_unique<SiftFeatureDescriptor>();
+        _featureDescriptor = std::make_unique<SiftFeatureDescriptor>(bufferPool);
     }
 
     // decide which featureMatcher to use
@@ -87,9 +214,9 @@ ImageStitcher::ImageStitcher(const CommandArgument& arguments) :
         _featureMatcher = std::make_unique<BruteForceFeatureMatcher>();
     }
     else {
-        std::cout << "Unknown featureMatcher type: <"
-                  << featureMatcher << ">, use <brute-force> instead"
-                  << std::endl;
+        _logger.warning() << "Unknown featureMatcher type: <"
+                          << featureMatcher << ">, use <brute-force> instead"
+                          << std::endl;
 
         _featureMatcher = std::make_unique<BruteForceFeatureMatcher>();
     }
@@ -98,78 +225,969 @@ ImageStitcher::ImageStitcher(const CommandArgument& arguments) :
     if (imageMatcher == "ransac") {
         _imageMatcher = std::make_unique<RansacImageMatcher>();
     }
+    else if (imageMatcher == "phase") {
+        _imageMatcher = std::make_unique<PhaseCorrelationImageMatcher>();
+    }
+    else if (imageMatcher == "prosac-affine") {
+        _imageMatcher = std::make_unique<ProsacImageMatcher>(ProsacImageMatcher::Model::AFFINE);
+    }
+    else if (imageMatcher == "prosac-homography") {
+        _imageMatcher = std::make_unique<ProsacImageMatcher>(ProsacImageMatcher::Model::HOMOGRAPHY);
+    }
     else {
-        std::cout << "Unknown imageMatcher type: <"
-                  << imageMatcher << ">, use <ransac> instead"
-                  << std::endl;
+        _logger.warning() << "Unknown imageMatcher type: <"
+                          << imageMatcher << ">, use <ransac> instead"
+                          << std::endl;
 
         _imageMatcher = std::make_unique<RansacImageMatcher>();
     }
 
+    // decide which exposureCompensator to use
+    if (exposureCompensator == "gain") {
+        _exposureCompensator = std::make_unique<GainExposureCompensator>();
+    }
+    else if (exposureCompensator == "none") {
+        _exposureCompensator = nullptr;
+    }
+    else {
+        _logger.warning() << "Unknown exposureCompensator type: <"
+                          << exposureCompensator << ">, use <none> instead"
+                          << std::endl;
+
+        _exposureCompensator = nullptr;
+    }
+
     // decide which imageBlender to use
     if (imageBlender == "linear-alpha") {
         _imageBlender = std::make_unique<LinearAlphaImageBlender>();
     }
+    else if (imageBlender == "multiband") {
+        _imageBlender = std::make_unique<MultiBandImageBlender>();
+    }
+    else if (imageBlender == "seam") {
+        _imageBlender = std::make_unique<SeamImageBlender>();
+    }
     else {
-        std::cout << "Unknown imageBlender type: <"
-                  << imageBlender << ">, use <linear-alpha> instead"
-                  << std::endl;
+        _logger.warning() << "Unknown imageBlender type: <"
+                          << imageBlender << ">, use <linear-alpha> instead"
+                          << std::endl;
 
         _imageBlender = std::make_unique<LinearAlphaImageBlender>();
     }
 
+    // bundle adjustment corrects drifting already, only the sliding
+    // window (which skips it) straightens panorama by the blender's shear
+    _imageBlender->setDriftCorrection(_isSlidingWindow);
+
     // decide which bundleAdjuster to use
-    if (bundleAdjuster == "perspective") {
-        _bundleAdjuster = std::make_unique<PerspectiveBundleAdjuster>();
+    if (bundleAdjuster == "levenberg-marquardt") {
+        _bundleAdjuster = std::make_unique<LevenbergMarquardtBundleAdjuster>();
     }
     else {
-        std::cout << "Unknown bundleAdjuster type: <"
-                  << bundleAdjuster << ">, use <perspective> instead"
-                  << std::endl;
+        _logger.warning() << "Unknown bundleAdjuster type: <"
+                          << bundleAdjuster << ">, use <levenberg-marquardt> instead"
+                          << std::endl;
 
-        _bundleAdjuster = std::make_unique<PerspectiveBundleAdjuster>();
+        _bundleAdjuster = std::make_unique<LevenbergMarquardtBundleAdjuster>();
     }
 
-    // read data input (images and focal lengths)
-    _readData(imageDirectory, 
-              focalLengthFilename,
-              static_cast<float>(std::stold(sizeRatio)));
+    // decide whether to crop panorama
+    if (autoCrop == "on") {
+        _isCropped = true;
+    }
+    else if (autoCrop == "off") {
+        _isCropped = false;
+    }
+    else {
+        _logger.warning() << "Unknown autoCrop type: <"
+                          << autoCrop << ">, use <on> instead"
+                          << std::endl;
+
+        _isCropped = true;
+    }
+
+    // decide whether to use sliding window
+    if (slidingWindow == "on") {
+        _isSlidingWindow = true;
+    }
+    else if (slidingWindow == "off") {
+        _isSlidingWindow = false;
+    }
+    else {
+        _logger.warning() << "Unknown slidingWindow type: <"
+                          << slidingWindow << ">, use <off> instead"
+                          << std::endl;
+
+        _isSlidingWindow = false;
+    }
+
+    if (_isSlidingWindow && !_imageBlender->supportsRegionBlending()) {
+        _logger.warning() << "Sliding window needs a region imageBlender: <"
+                          << imageBlender << ">, use <linear-alpha> instead"
+                          << std::endl;
+
+        _imageBlender = std::make_unique<LinearAlphaImageBlender>();
+    }
+
+    // decide whether to write debug images, they are drawn and
+    // encoded in the background so stages don't wait for them
+    if (debugImages == "on") {
+        _debugImageWriter = std::make_unique<DebugImageWriter>("./result");
+    }
+    else if (debugImages != "off") {
+        _logger.warning() << "Unknown debugImages type: <"
+                          << debugImages << ">, use <off> instead"
+                          << std::endl;
+    }
+
+    /*
+        Feature cache is keyed by stages, so another imageBlender
+        or bundleAdjuster still hits it
+    */
+    if (!featureCache.empty()) {
+        if (cacheImagePairs != "on" && cacheImagePairs != "off") {
+            _logger.warning() << "Unknown cacheImagePairs type: <"
+                              << cacheImagePairs << ">, use <on> instead"
+                              << std::endl;
+        }
+
+        const std::string featureParameters = imageWarpper + "|" + featureDetector + "|" + featureDescriptor;
+        const std::string pairParameters    = featureParameters + "|" + featureMatcher + "|" + imageMatcher;
+        _featureCache = std::make_unique<FeatureCache>(featureCache, featureParameters, pairParameters,
+                                                       cacheImagePairs != "off");
+    }
+
+    // stages log to the stitcher's logger
+    _imageWarpper->setLogger(&_logger);
+    _featureDetector->setLogger(&_logger);
+    _featureDescriptor->setLogger(&_logger);
+    _featureMatcher->setLogger(&_logger);
+    _imageMatcher->setLogger(&_logger);
+    _imageBlender->setLogger(&_logger);
+    _bundleAdjuster->setLogger(&_logger);
+    if (_exposureCompensator) {
+        _exposureCompensator->setLogger(&_logger);
+    }
+    if (_debugImageWriter) {
+        _debugImageWriter->setLogger(&_logger);
+    }
+    if (_featureCache) {
+        _featureCache->setLogger(&_logger);
+    }
+
+    // without a shared pool, by default, use all hardware threads for task schedulers
+    if (!_workerPool) {
+        int numWorkers = static_cast<int>(std::thread::hardware_concurrency());
+
+        if (!numThreads.empty()) {
+            // at most 9 digits, so it fits int
+            const bool isNumber = (numThreads.size() <= 9 &&
+                                   numThreads.find_first_not_of("0123456789") == std::string::npos);
+
+            if (isNumber && std::stoi(numThreads) > 0) {
+                numWorkers = std::stoi(numThreads);
+            }
+            else {
+                _logger.warning() << "Unknown numThreads: <"
+                                  << numThreads << ">, use <" << numWorkers << "> instead"
+                                  << std::endl;
+            }
+        }
+
+        _workerPool = std::make_shared<WorkerPool>(numWorkers);
+    }
+
+    // read data input (images and focal lengths), in-memory images
+    // go first, and without any of them, frames are appended later
+    if (!images.empty()) {
+        _setData(images,
+                 focalLengths,
+                 static_cast<float>(std::stold(sizeRatio)));
+    }
+    else if (!imageDirectory.empty()) {
+        _readData(imageDirectory, 
+                  focalLengthFilename,
+                  static_cast<float>(std::stold(sizeRatio)));
+    }
+    else {
+        _sizeRatio = std::min(std::max(static_cast<float>(std::stold(sizeRatio)), 0.1f), 1.0f);
+    }
+
+    // by default, re-align suspicious image pairs at double resolution
+    _realignSizeRatio = realignSizeRatio.empty() ?
+                        std::min(2.0f * _sizeRatio, 1.0f) :
+                        std::min(static_cast<float>(std::stold(realignSizeRatio)), 1.0f);
 }
 
 ImageStitcher::~ImageStitcher() = default;
 
 void ImageStitcher::solve(cv::Mat* const out_panorama) const {
-    // image warpping
-    std::vector<cv::Mat> warpImages;
-    std::vector<cv::Mat> warpImageIndices;
-    _imageWarpper->warp(_images, _focalLengths, &warpImages, &warpImageIndices);
-    
-    // feature detection
-    std::vector<std::vector<cv::Point>> featurePositions;
-    _featureDetector->detect(warpImages, &featurePositions);
+    if (_isSlidingWindow) {
+        MatPanoramaSink sink(out_panorama);
+        _solveInWindow(&sink);
+        _flushDebugImages();
 
-    // feature descriptor calculation
-    std::vector<std::vector<std::vector<float>>> featureDescriptors;
-    _featureDescriptor->calculate(warpImages, featurePositions, &featureDescriptors);
+        return;
+    }
 
-    // feature matching
+    std::vector<cv::Mat>                          warpImages;
+    std::vector<cv::Mat>                          warpImageIndices;
+    std::vector<std::vector<cv::Point>>           featurePositions;
     std::vector<std::vector<std::pair<int, int>>> featureMatchings;
-    _featureMatcher->match(warpImages, featurePositions, featureDescriptors, &featureMatchings);
+    std::vector<ImageAlignment>                   pairAlignments;
+    _alignImages(&warpImages, &warpImageIndices, &featurePositions, &featureMatchings, &pairAlignments);
+
+    // bundle adjustment, panorama is rendered only once with adjusted alignments
+    _checkCancelled();
+    _reportProgress("bundle adjustment", 0, 1);
+    std::vector<ImageAlignment> imageAlignments;
+    _bundleAdjuster->adjust(warpImages, featurePositions, featureMatchings, pairAlignments, &imageAlignments);
 
-    // image matching
-    std::vector<cv::Point> imageAlignments;
-    _imageMatcher->match(warpImages, featurePositions, featureMatchings, &imageAlignments);
+    // exposure compensation
+    _checkCancelled();
+    _reportProgress("exposure compensation", 0, 1);
+    std::vector<float> imageGains;
+    _compensateExposure(warpImages, imageAlignments, warpImageIndices, &imageGains);
 
     // image blending (stitching)
+    _checkCancelled();
+    _reportProgress("image blending", 0, 1);
     cv::Mat panorama;
-    _imageBlender->blend(warpImages, imageAlignments, warpImageIndices, &panorama);
+    _imageBlender->blend(warpImages, imageAlignments, warpImageIndices, imageGains, _isCropped, &panorama);
+    _reportProgress("image blending", 1, 1);
 
-    // bundle adjustment
-    cv::Mat adjustedPanorama;
-    _bundleAdjuster->adjust(panorama, &adjustedPanorama);
+    if (_debugImageWriter) {
+        _debugImageWriter->writeBlendImage(panorama);
+    }
+    _flushDebugImages();
 
     // writing result
-    *out_panorama = adjustedPanorama;
+    *out_panorama = panorama;
+}
+
+void ImageStitcher::solve(PanoramaSink* const sink) const {
+    if (_isSlidingWindow) {
+        _solveInWindow(sink);
+        _flushDebugImages();
+
+        return;
+    }
+
+    std::vector<cv::Mat>                          warpImages;
+    std::vector<cv::Mat>                          warpImageIndices;
+    std::vector<std::vector<cv::Point>>           featurePositions;
+    std::vector<std::vector<std::pair<int, int>>> featureMatchings;
+    std::vector<ImageAlignment>                   pairAlignments;
+    _alignImages(&warpImages, &warpImageIndices, &featurePositions, &featureMatchings, &pairAlignments);
+
+    // bundle adjustment
+    _checkCancelled();
+    _reportProgress("bundle adjustment", 0, 1);
+    std::vector<ImageAlignment> imageAlignments;
+    _bundleAdjuster->adjust(warpImages, featurePositions, featureMatchings, pairAlignments, &imageAlignments);
+
+    // exposure compensation
+    _checkCancelled();
+    _reportProgress("exposure compensation", 0, 1);
+    std::vector<float> imageGains;
+    _compensateExposure(warpImages, imageAlignments, warpImageIndices, &imageGains);
+
+    // image blending (stitching) strip by strip
+    _checkCancelled();
+    _reportProgress("image blending", 0, 1);
+    _imageBlender->blend(warpImages, imageAlignments, warpImageIndices, imageGains, _isCropped, sink);
+    _reportProgress("image blending", 1, 1);
+
+    _flushDebugImages();
+}
+
+void ImageStitcher::append(const cv::Mat& image, const float focalLength) {
+    if (!_imageBlender->supportsRegionBlending()) {
+        _logger.warning() << "Appending frames needs a region imageBlender, use <linear-alpha> instead"
+                          << std::endl;
+
+        _imageBlender = std::make_unique<LinearAlphaImageBlender>();
+        _imageBlender->setLogger(&_logger);
+    }
+
+    const cv::Size resizeRes(static_cast<int>(image.cols * _sizeRatio),
+                             static_cast<int>(image.rows * _sizeRatio));
+    std::vector<cv::Mat> resizeImages(1);
+    cv::resize(image, resizeImages[0], resizeRes, cv::INTER_LINEAR);
+
+    /*
+        Warpping and feature stages of the new frame only
+    */
+    AppendedFrame frame;
+    {
+        std::vector<cv::Mat> warpImages;
+        std::vector<cv::Mat> warpImageIndices;
+        _imageWarpper->warp(resizeImages, { focalLength }, &warpImages, &warpImageIndices);
+
+        frame.warpImage      = warpImages[0];
+        frame.warpImageIndex = warpImageIndices[0];
+    }
+
+    if (_imageMatcher->isFeatureBased()) {
+        std::vector<std::vector<cv::Point>>          featurePositions;
+        std::vector<std::vector<std::vector<float>>> featureDescriptors;
+        _featureDetector->detect({ frame.warpImage }, &featurePositions);
+        _featureDescriptor->calculate({ frame.warpImage }, featurePositions, &featureDescriptors);
+
+        frame.featurePositions   = featurePositions[0];
+        frame.featureDescriptors = featureDescriptors[0];
+    }
+
+    frame.position = cv::Point(0, 0);
+    frame.gain     = 1.0f;
+
+    /*
+        Match with the last frame only, it places the new frame
+        and chains its exposure gain
+    */
+    if (!_appendedFrames.empty()) {
+        const AppendedFrame& lastFrame = _appendedFrames.back();
+
+        const std::vector<cv::Mat> pairImages = { lastFrame.warpImage, frame.warpImage };
+
+        std::vector<std::vector<cv::Point>>           pairFeaturePositions;
+        std::vector<std::vector<std::pair<int, int>>> pairFeatureMatchings;
+        if (_imageMatcher->isFeatureBased()) {
+            pairFeaturePositions = { lastFrame.featurePositions, frame.featurePositions };
+            _featureMatcher->match(pairImages, pairFeaturePositions,
+                                   { lastFrame.featureDescriptors, frame.featureDescriptors },
+                                   &pairFeatureMatchings);
+        }
+
+        std::vector<ImageAlignment> pairAlignments;
+        _imageMatcher->match(pairImages, pairFeaturePositions, pairFeatureMatchings, &pairAlignments);
+
+        // frames are placed by translation only
+        frame.alignment = pairAlignments[0];
+        frame.alignment.transform = mathUtils::getTranslationTransform(
+            lastFrame.warpImage.cols + frame.alignment.translation.x, frame.alignment.translation.y);
+
+        frame.position = lastFrame.position +
+                         cv::Point(lastFrame.warpImage.cols, 0) +
+                         frame.alignment.translation;
+
+        if (_exposureCompensator) {
+            std::vector<float> pairGains;
+            _exposureCompensator->compensate(pairImages, { frame.alignment },
+                                             { lastFrame.warpImageIndex, frame.warpImageIndex }, &pairGains);
+
+            frame.gain = lastFrame.gain * pairGains[1] / pairGains[0];
+        }
+    }
+
+    /*
+        Blended tiles are all kept for getAppendedPanorama, refuse the
+        frame (before any state changes) if they would grow over the cap
+    */
+    const cv::Rect region(frame.position, frame.warpImage.size());
+
+    const cv::Rect bounds = (_numAppendedFrames == 0) ? region : (_appendedBounds | region);
+    if (static_cast<long long>(bounds.width) * bounds.height > APPEND_MAX_PIXELS) {
+        throw std::runtime_error("Appended panorama can't grow over " +
+                                 std::to_string(APPEND_MAX_PIXELS) + " pixels");
+    }
+
+    /*
+        Frames come from left to right, a frame whose right side is
+        left to the new frame (and the blender's region border)
+        can't be blended with later frames any more
+        (the last frame is kept for matching)
+    */
+    const int border = _imageBlender->regionBorder();
+    while (_appendedFrames.size() > 1 &&
+           _appendedFrames.front().position.x + _appendedFrames.front().warpImage.cols <= frame.position.x - border) {
+
+        _appendedFrames.pop_front();
+    }
+    _appendedFrames.push_back(frame);
+    ++_numAppendedFrames;
+
+    /*
+        Blend the region covered by the new frame again
+        with the kept frames overlapping it
+    */
+    if (static_cast<int>(_appendedColumnOffsets.size()) < region.x + region.width) {
+        _appendedColumnOffsets.resize(region.x + region.width, 0);
+    }
+
+    std::vector<cv::Mat>        images;
+    std::vector<cv::Mat>        imageIndices;
+    std::vector<ImageAlignment> alignments;
+    std::vector<float>          gains;
+    std::vector<cv::Point>      positions;
+    for (const auto& keptFrame : _appendedFrames) {
+        if (!images.empty()) {
+            alignments.push_back(keptFrame.alignment);
+        }
+        images.push_back(keptFrame.warpImage);
+        imageIndices.push_back(keptFrame.warpImageIndex);
+        gains.push_back(keptFrame.gain);
+        positions.push_back(keptFrame.position);
+    }
+
+    cv::Mat blendRegion;
+    _imageBlender->blendRegion(images, alignments, imageIndices, gains, positions,
+                               _appendedColumnOffsets, region, &blendRegion);
+
+    /*
+        Write the region back to tiles, tiles are keyed by
+        floor(x / APPEND_TILE_SIZE) so y may be negative
+    */
+    const auto floorDivide = [](const int value, const int divisor) {
+        return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+    };
+
+    const int tileXBegin = floorDivide(region.x, APPEND_TILE_SIZE);
+    const int tileXEnd   = floorDivide(region.x + region.width - 1, APPEND_TILE_SIZE) + 1;
+    const int tileYBegin = floorDivide(region.y, APPEND_TILE_SIZE);
+    const int tileYEnd   = floorDivide(region.y + region.height - 1, APPEND_TILE_SIZE) + 1;
+    for (int tileY = tileYBegin; tileY < tileYEnd; ++tileY) {
+        for (int tileX = tileXBegin; tileX < tileXEnd; ++tileX) {
+            const cv::Rect tileRect(tileX * APPEND_TILE_SIZE, tileY * APPEND_TILE_SIZE,
+                                    APPEND_TILE_SIZE, APPEND_TILE_SIZE);
+            const cv::Rect overlap = tileRect & region;
+
+            cv::Mat& tile = _appendedTiles[std::make_pair(tileX, tileY)];
+            if (tile.empty()) {
+                tile = cv::Mat::zeros(tileRect.size(), CV_8UC3);
+            }
+
+            blendRegion(overlap - region.tl()).copyTo(tile(overlap - tileRect.tl()));
+        }
+    }
+
+    _appendedBounds = bounds;
+
+    _logger.progress() << "# Append frame " << _numAppendedFrames << " at ("
+                       << frame.position.x << ", " << frame.position.y << ")"
+                       << std::endl;
+}
+
+void ImageStitcher::getAppendedPanorama(cv::Mat* const out_panorama) const {
+    cv::Mat panorama = cv::Mat::zeros(_appendedBounds.size(), CV_8UC3);
+
+    for (const auto& tile : _appendedTiles) {
+        const cv::Rect tileRect(tile.first.first  * APPEND_TILE_SIZE,
+                                tile.first.second * APPEND_TILE_SIZE,
+                                APPEND_TILE_SIZE, APPEND_TILE_SIZE);
+        const cv::Rect overlap = tileRect & _appendedBounds;
+        if (overlap.area() == 0) {
+            continue;
+        }
+
+        tile.second(overlap - tileRect.tl()).copyTo(panorama(overlap - _appendedBounds.tl()));
+    }
+
+    *out_panorama = panorama;
+}
+
+void ImageStitcher::setProgressHook(const ProgressHook& progressHook) {
+    _progressHook = progressHook;
+}
+
+void ImageStitcher::setCancelFlag(const std::atomic<bool>* const cancelFlag) {
+    _cancelFlag = cancelFlag;
+}
+
+void ImageStitcher::_runAlignmentTasks(
+    std::vector<cv::Mat>* const                          out_warpImages,
+    std::vector<cv::Mat>* const                          out_warpImageIndices,
+    std::vector<std::vector<cv::Point>>* const           out_featurePositions,
+    std::vector<std::vector<std::vector<float>>>* const  out_featureDescriptors,
+    std::vector<std::vector<std::pair<int, int>>>* const out_featureMatchings,
+    std::vector<ImageAlignment>* const                   out_imageAlignments) const {
+
+    const int  numImages      = static_cast<int>(_images.size());
+    const bool isFeatureBased = _imageMatcher->isFeatureBased();
+
+    std::vector<cv::Mat>&                          warpImages         = *out_warpImages;
+    std::vector<cv::Mat>&                          warpImageIndices   = *out_warpImageIndices;
+    std::vector<std::vector<cv::Point>>&           featurePositions   = *out_featurePositions;
+    std::vector<std::vector<std::vector<float>>>&  featureDescriptors = *out_featureDescriptors;
+    std::vector<std::vector<std::pair<int, int>>>& featureMatchings   = *out_featureMatchings;
+    std::vector<ImageAlignment>&                   imageAlignments    = *out_imageAlignments;
+
+    // every task writes its own slot, so outputs are sized first
+    warpImages.assign(numImages, cv::Mat());
+    warpImageIndices.assign(numImages, cv::Mat());
+    imageAlignments.assign(std::max(numImages - 1, 0), ImageAlignment());
+    if (isFeatureBased) {
+        featurePositions.assign(numImages, std::vector<cv::Point>());
+        featureDescriptors.assign(numImages, std::vector<std::vector<float>>());
+        featureMatchings.assign(std::max(numImages - 1, 0), std::vector<std::pair<int, int>>());
+    }
+
+    _logger.progress() << "# Begin to align images with " << _workerPool->numThreads() << " threads"
+                       << std::endl;
+
+    /*
+        Task graph of image k and image pair (k-1, k)
+
+        warp k -> detect k -> describe k --+
+                                           +-> match pair k-1 -> align pair k-1
+        ...       describe k-1 ------------+
+
+        Feature-free imageMatcher aligns pairs right after warpping.
+        Stages of different images overlap, so no stage waits for
+        the slowest image of its previous stage.
+    */
+    TaskScheduler scheduler(_workerPool);
+
+    /*
+        With feature cache, feature stages of a cached image and
+        matching stages of a cached image pair are skipped
+    */
+    std::vector<std::uint64_t> imageKeys(numImages, 0);
+    std::vector<char>          isImageCached(numImages, 0);
+    std::vector<char>          isPairCached(std::max(numImages - 1, 0), 0);
+
+    std::vector<int> readyTasks(numImages);
+    for (int k = 0; k < numImages; ++k) {
+        const int warpTask = scheduler.addTask("warp " + std::to_string(k + 1), [&, k]() {
+            _checkCancelled();
+
+            if (_featureCache) {
+                imageKeys[k] = _featureCache->calculateImageKey(_images[k], _focalLengths[k], _sizeRatio);
+            }
+
+            std::vector<cv::Mat> images;
+            std::vector<cv::Mat> imageIndices;
+            _imageWarpper->warp({ _images[k] }, { _focalLengths[k] }, &images, &imageIndices);
+
+            warpImages[k]       = images[0];
+            warpImageIndices[k] = imageIndices[0];
+
+            if (_debugImageWriter) {
+                _debugImageWriter->writeWarpImage(k, warpImages[k]);
+            }
+        });
+        readyTasks[k] = warpTask;
+
+        if (!isFeatureBased) {
+            continue;
+        }
+
+        const int detectTask = scheduler.addTask("detect " + std::to_string(k + 1), [&, k]() {
+            _checkCancelled();
+
+            if (_featureCache &&
+                _featureCache->loadFeatures(imageKeys[k], &featurePositions[k], &featureDescriptors[k])) {
+
+                isImageCached[k] = 1;
+            }
+            else {
+                std::vector<std::vector<cv::Point>> positions;
+                _featureDetector->detect({ warpImages[k] }, &positions);
+
+                featurePositions[k] = positions[0];
+            }
+
+            if (_debugImageWriter) {
+                _debugImageWriter->writeFeatureImage(k, warpImages[k], featurePositions[k]);
+            }
+        }, { warpTask });
+
+        readyTasks[k] = scheduler.addTask("describe " + std::to_string(k + 1), [&, k]() {
+            _checkCancelled();
+
+            if (isImageCached[k]) {
+                return;
+            }
+
+            std::vector<std::vector<std::vector<float>>> descriptors;
+            _featureDescriptor->calculate({ warpImages[k] }, { featurePositions[k] }, &descriptors);
+
+            featureDescriptors[k] = descriptors[0];
+
+            if (_featureCache) {
+                _featureCache->storeFeatures(imageKeys[k], featurePositions[k], featureDescriptors[k]);
+            }
+        }, { detectTask });
+    }
+
+    for (int k = 1; k < numImages; ++k) {
+        const std::string pairName = std::to_string(k) + "-" + std::to_string(k + 1);
+
+        std::vector<int> alignDependencies = { readyTasks[k - 1], readyTasks[k] };
+        if (isFeatureBased) {
+            const int matchTask = scheduler.addTask("match " + pairName, [&, k]() {
+                _checkCancelled();
+
+                if (_featureCache &&
+                    _featureCache->loadImagePair(imageKeys[k - 1], imageKeys[k],
+                                                 &featureMatchings[k - 1], &imageAlignments[k - 1])) {
+
+                    isPairCached[k - 1] = 1;
+
+                    return;
+                }
+
+                std::vector<std::vector<std::pair<int, int>>> matchings;
+                _featureMatcher->match({ warpImages[k - 1], warpImages[k] },
+                                       { featurePositions[k - 1], featurePositions[k] },
+                                       { featureDescriptors[k - 1], featureDescriptors[k] },
+                                       &matchings);
+
+                featureMatchings[k - 1] = matchings[0];
+
+                if (_debugImageWriter) {
+                    _debugImageWriter->writeMatchingImage(k - 1, warpImages[k - 1], warpImages[k],
+                                                          featurePositions[k - 1], featurePositions[k],
+                                                          featureMatchings[k - 1]);
+                }
+            }, alignDependencies);
+
+            alignDependencies = { matchTask };
+        }
+
+        scheduler.addTask("align " + pairName, [&, k]() {
+            _checkCancelled();
+
+            if (isPairCached[k - 1]) {
+                return;
+            }
+
+            // feature-free pairs are only looked up here
+            if (!isFeatureBased && _featureCache) {
+                std::vector<std::pair<int, int>> noMatchings;
+                if (_featureCache->loadImagePair(imageKeys[k - 1], imageKeys[k],
+                                                 &noMatchings, &imageAlignments[k - 1])) {
+                    isPairCached[k - 1] = 1;
+
+                    return;
+                }
+            }
+
+            const std::vector<std::vector<cv::Point>> pairFeaturePositions = isFeatureBased ?
+                std::vector<std::vector<cv::Point>>{ featurePositions[k - 1], featurePositions[k] } :
+                std::vector<std::vector<cv::Point>>();
+            const std::vector<std::vector<std::pair<int, int>>> pairFeatureMatchings = isFeatureBased ?
+                std::vector<std::vector<std::pair<int, int>>>{ featureMatchings[k - 1] } :
+                std::vector<std::vector<std::pair<int, int>>>();
+
+            std::vector<ImageAlignment> alignments;
+            _imageMatcher->match({ warpImages[k - 1], warpImages[k] },
+                                 pairFeaturePositions, pairFeatureMatchings, &alignments);
+
+            imageAlignments[k - 1] = alignments[0];
+
+            if (_featureCache) {
+                _featureCache->storeImagePair(imageKeys[k - 1], imageKeys[k],
+                                              isFeatureBased ? featureMatchings[k - 1] : std::vector<std::pair<int, int>>(),
+                                              imageAlignments[k - 1]);
+            }
+        }, alignDependencies);
+    }
+
+    /*
+        Timing hook sums time of each stage (task name
+        without its image number) over all images, and
+        reports finished tasks as alignment progress
+    */
+    const int numTasks = isFeatureBased ? (3 * numImages + 2 * std::max(numImages - 1, 0)) :
+                                          (numImages + std::max(numImages - 1, 0));
+
+    std::mutex                    timingMutex;
+    std::map<std::string, double> stageTimes;
+    std::map<std::string, int>    stageCounts;
+    int                           numFinishedTasks = 0;
+    scheduler.setTimingHook([&](const std::string& taskName, const int workerIndex,
+                                const double beginTime, const double endTime) {
+
+        const std::string stage = taskName.substr(0, taskName.find(' '));
+
+        std::lock_guard<std::mutex> lock(timingMutex);
+        stageTimes[stage] += endTime - beginTime;
+        ++stageCounts[stage];
+
+        _reportProgress("alignment", ++numFinishedTasks, numTasks);
+    });
+
+    _checkCancelled();
+    _reportProgress("alignment", 0, numTasks);
+
+    scheduler.run();
+
+    if (_featureCache) {
+        _logger.progress() << "    Feature cache hits: "
+                           << std::count(isImageCached.begin(), isImageCached.end(), 1) << "/" << numImages << " images, "
+                           << std::count(isPairCached.begin(), isPairCached.end(), 1) << "/" << isPairCached.size() << " image pairs"
+                           << std::endl;
+    }
+
+    for (const auto& stageTime : stageTimes) {
+        _logger.progress() << "    Time of " << stageTime.first << " tasks: " << stageTime.second << " ms"
+                           << " (" << stageCounts[stageTime.first] << " tasks)"
+                           << std::endl;
+    }
+
+    _logger.progress() << "# Finish image alignment"
+                       << std::endl;
+}
+
+void ImageStitcher::_solveInWindow(PanoramaSink* const sink) const {
+    const int numImages = static_cast<int>(_sourceImages.empty() ?
+                                           _imageFilenames.size() : _sourceImages.size());
+
+    /*
+        Only per-image metadata of the whole sequence is kept,
+        and the window holds the previous image and its features
+    */
+    std::vector<cv::Size>               imageSizes(numImages);
+    std::vector<std::vector<cv::Range>> imageColumnSpans(numImages);
+    std::vector<ImageAlignment>         imageAlignments;
+    std::vector<float>                  imageGains(numImages, 1.0f);
+    imageAlignments.reserve(std::max(numImages - 1, 0));
+
+    cv::Mat                         prevImage;
+    cv::Mat                         prevImageIndex;
+    std::vector<cv::Point>          prevFeaturePositions;
+    std::vector<std::vector<float>> prevFeatureDescriptors;
+
+    _logger.progress() << "# Begin to align images in a sliding window"
+                       << std::endl;
+
+    for (int n = 0; n < numImages; ++n) {
+        _checkCancelled();
+        _reportProgress("alignment", n, numImages);
+
+        cv::Mat image;
+        cv::Mat imageIndex;
+        _loadWarpImage(n, &image, &imageIndex);
+
+        imageSizes[n] = image.size();
+        _imageBlender->calculateColumnSpans(imageIndex, &imageColumnSpans[n]);
+
+        if (_debugImageWriter) {
+            _debugImageWriter->writeWarpImage(n, image);
+        }
+
+        std::vector<std::vector<cv::Point>>          featurePositions;
+        std::vector<std::vector<std::vector<float>>> featureDescriptors;
+        if (_imageMatcher->isFeatureBased()) {
+            _featureDetector->detect({ image }, &featurePositions);
+            _featureDescriptor->calculate({ image }, featurePositions, &featureDescriptors);
+
+            if (_debugImageWriter) {
+                _debugImageWriter->writeFeatureImage(n, image, featurePositions[0]);
+            }
+        }
+
+        if (n > 0) {
+            const std::vector<cv::Mat> pairImages = { prevImage, image };
+
+            std::vector<std::vector<cv::Point>>           pairFeaturePositions;
+            std::vector<std::vector<std::pair<int, int>>> pairFeatureMatchings;
+            if (_imageMatcher->isFeatureBased()) {
+                pairFeaturePositions = { prevFeaturePositions, featurePositions[0] };
+
+                const std::vector<std::vector<std::vector<float>>> pairFeatureDescriptors =
+                    { prevFeatureDescriptors, featureDescriptors[0] };
+                _featureMatcher->match(pairImages, pairFeaturePositions, pairFeatureDescriptors, &pairFeatureMatchings);
+
+                if (_debugImageWriter) {
+                    _debugImageWriter->writeMatchingImage(n - 1, prevImage, image, prevFeaturePositions,
+                                                          featurePositions[0], pairFeatureMatchings[0]);
+                }
+            }
+
+            std::vector<ImageAlignment> pairAlignments;
+            _imageMatcher->match(pairImages, pairFeaturePositions, pairFeatureMatchings, &pairAlignments);
+
+            // only translation places images in sliding-window blending
+            ImageAlignment alignment = pairAlignments[0];
+            alignment.transform = mathUtils::getTranslationTransform(prevImage.cols + alignment.translation.x,
+                                                                     alignment.translation.y);
+            imageAlignments.push_back(alignment);
+
+            /*
+                Gain ratio of the pair is solved from their overlap,
+                and gain of image n is chained from image n-1
+            */
+            if (_exposureCompensator) {
+                std::vector<float> pairGains;
+                _exposureCompensator->compensate(pairImages, { alignment }, { prevImageIndex, imageIndex }, &pairGains);
+
+                imageGains[n] = imageGains[n - 1] * pairGains[1] / pairGains[0];
+            }
+
+            _logger.progress() << "    Image pair " << n << "-" << (n + 1) << ": ("
+                               << alignment.translation.x << ", " << alignment.translation.y << ")"
+                               << std::endl;
+        }
+
+        // slide the window
+        prevImage      = image;
+        prevImageIndex = imageIndex;
+        if (_imageMatcher->isFeatureBased()) {
+            prevFeaturePositions   = featurePositions[0];
+            prevFeatureDescriptors = featureDescriptors[0];
+        }
+    }
+
+    prevImage.release();
+    prevImageIndex.release();
+
+    // chained gains are normalized to average 1
+    float sumGain = 0.0f;
+    for (auto& gain : imageGains) {
+        sumGain += gain;
+    }
+    for (auto& gain : imageGains) {
+        gain *= numImages / sumGain;
+    }
+
+    _reportProgress("alignment", numImages, numImages);
+
+    _logger.progress() << "# Finish image alignment"
+                       << std::endl;
+
+    // image blending (stitching), images are loaded again on demand
+    _checkCancelled();
+    _reportProgress("image blending", 0, 1);
+    const ImageBlender::ImageLoader loadImage = [this](const int n, cv::Mat* const out_image, cv::Mat* const out_imageIndex) {
+        _loadWarpImage(n, out_image, out_imageIndex);
+    };
+    _imageBlender->blend(loadImage, imageSizes, imageColumnSpans, imageAlignments, imageGains, _isCropped, sink);
+    _reportProgress("image blending", 1, 1);
+}
+
+void ImageStitcher::_loadWarpImage(
+    const int      n,
+    cv::Mat* const out_warpImage,
+    cv::Mat* const out_warpImageIndex) const {
+
+    std::vector<cv::Mat> images(1);
+    _loadImage(n, _sizeRatio, &images[0]);
+
+    std::vector<cv::Mat> warpImages;
+    std::vector<cv::Mat> warpImageIndices;
+    _imageWarpper->warp(images, { _focalLengths[n] }, &warpImages, &warpImageIndices);
+
+    *out_warpImage      = warpImages[0];
+    *out_warpImageIndex = warpImageIndices[0];
+}
+
+void ImageStitcher::_alignImages(
+    std::vector<cv::Mat>* const                          out_warpImages,
+    std::vector<cv::Mat>* const                          out_warpImageIndices,
+    std::vector<std::vector<cv::Point>>* const           out_featurePositions,
+    std::vector<std::vector<std::pair<int, int>>>* const out_featureMatchings,
+    std::vector<ImageAlignment>* const                   out_imageAlignments) const {
+
+    std::vector<cv::Mat>&                          warpImages       = *out_warpImages;
+    std::vector<std::vector<cv::Point>>&           featurePositions = *out_featurePositions;
+    std::vector<std::vector<std::pair<int, int>>>& featureMatchings = *out_featureMatchings;
+
+    // warpping, feature stages and matching run as a task graph
+    std::vector<std::vector<std::vector<float>>> featureDescriptors;
+    _runAlignmentTasks(out_warpImages, out_warpImageIndices, out_featurePositions,
+                       &featureDescriptors, out_featureMatchings, out_imageAlignments);
+
+    // re-align failed or suspicious image pairs at higher resolution
+    _realignImagePairs(warpImages, out_imageAlignments);
+
+    if (!_isClosedSweep(warpImages, *out_imageAlignments)) {
+        return;
+    }
+
+    /*
+        Loop closure, match the last image with the first one,
+        the closing pair is only used in bundle adjustment
+    */
+    _logger.progress() << "# Images cover 360 degrees, match the last image with the first one"
+                       << std::endl;
+
+    const int last = static_cast<int>(warpImages.size()) - 1;
+
+    const std::vector<cv::Mat> closeImages = { warpImages[last], warpImages[0] };
+
+    std::vector<std::vector<cv::Point>>           closeFeaturePositions;
+    std::vector<std::vector<std::pair<int, int>>> closeFeatureMatchings;
+    if (_imageMatcher->isFeatureBased()) {
+        closeFeaturePositions = { featurePositions[last], featurePositions[0] };
+
+        const std::vector<std::vector<std::vector<float>>> closeFeatureDescriptors =
+            { featureDescriptors[last], featureDescriptors[0] };
+        _featureMatcher->match(closeImages, closeFeaturePositions, closeFeatureDescriptors, &closeFeatureMatchings);
+    }
+
+    std::vector<ImageAlignment> closeAlignments;
+    _imageMatcher->match(closeImages, closeFeaturePositions, closeFeatureMatchings, &closeAlignments);
+
+    /*
+        The closing pair needs to agree with the sweep,
+        the first image should be seen again at the end
+        of the sweep (where _isClosedSweep predicts)
+    */
+    const float circumference = 2.0f * mathUtils::PI * _focalLengths[0];
+
+    int sweepWidth = 0;
+    for (int n = 0; n < last; ++n) {
+        sweepWidth += warpImages[n].cols + (*out_imageAlignments)[n].translation.x;
+    }
+    const int predictX = static_cast<int>(circumference) - sweepWidth - warpImages[last].cols;
+
+    if (std::abs(closeAlignments[0].translation.x - predictX) > 0.15f * warpImages[last].cols) {
+        _logger.progress() << "    Closing alignment (" << closeAlignments[0].translation.x << ", "
+                           << closeAlignments[0].translation.y << ") disagrees with the sweep, skip loop closure"
+                           << std::endl;
+
+        return;
+    }
+
+    if (_imageMatcher->isFeatureBased()) {
+        featureMatchings.push_back(closeFeatureMatchings[0]);
+    }
+    out_imageAlignments->push_back(closeAlignments[0]);
+}
+
+bool ImageStitcher::_isClosedSweep(
+    const std::vector<cv::Mat>&        warpImages,
+    const std::vector<ImageAlignment>& imageAlignments) const {
+
+    const int numImages = static_cast<int>(warpImages.size());
+    if (numImages < 3) {
+        return false;
+    }
+
+    /*
+        Cylinder circumference is 2 * PI * f in warpped image,
+        the sweep is closed if the last image goes beyond it
+        and overlaps with the first image again
+    */
+    const float circumference = 2.0f * mathUtils::PI * _focalLengths[0];
+
+    int sweepWidth = 0;
+    for (int n = 0; n < numImages - 1; ++n) {
+        sweepWidth += warpImages[n].cols + imageAlignments[n].translation.x;
+    }
+    sweepWidth += warpImages[numImages - 1].cols;
+
+    return sweepWidth > circumference + 0.1f * warpImages[numImages - 1].cols;
+}
+
+void ImageStitcher::_compensateExposure(
+    const std::vector<cv::Mat>&        warpImages,
+    const std::vector<ImageAlignment>& imageAlignments,
+    const std::vector<cv::Mat>&        warpImageIndices,
+    std::vector<float>* const          out_imageGains) const {
+
+    /*
+        Only gains are calculated here, imageBlender applies
+        them while blending, so images are not modified
+    */
+    if (_exposureCompensator) {
+        _exposureCompensator->compensate(warpImages, imageAlignments, warpImageIndices, out_imageGains);
+    }
+    else {
+        out_imageGains->assign(warpImages.size(), 1.0f);
+    }
 }
 
 void ImageStitcher::_readData(const std::string& imageDirectory, 
@@ -179,6 +1197,7 @@ void ImageStitcher::_readData(const std::string& imageDirectory,
     // clamp sizeRatio to 0.1 ~ 1.0
     const float safeSizeRatio = (sizeRatio > 1.0f) ? 1.0f :
                                 (sizeRatio < 0.1f) ? 0.1f : sizeRatio;
+    _sizeRatio = safeSizeRatio;
 
     /*
         Read focal length file,
@@ -186,10 +1205,7 @@ void ImageStitcher::_readData(const std::string& imageDirectory,
     */
     FILE *f = fopen(focalLengthFilename.c_str(), "r");
     if (!f) {
-        std::cout << "Focal length file can't open !"
-                  << std::endl;
-
-        exit(0);
+        throw std::runtime_error("Focal length file can't open: " + focalLengthFilename);
     }
 
     char line[1024];
@@ -201,15 +1217,16 @@ void ImageStitcher::_readData(const std::string& imageDirectory,
         const float time = static_cast<float>(std::stold(line));
         _focalLengths.push_back(time);
     }
+    fclose(f);
 
     /*
         Read input images,
         and the order of input photographs needs to be LEFT-TO-RIGHT.
     */
-    std::cout << "# Begin to read images"
-              << std::endl
-              << "    Using image scale ratio: <"
-              << safeSizeRatio << ">" << std::endl;
+    _logger.progress() << "# Begin to read images"
+                       << std::endl
+                       << "    Using image scale ratio: <"
+                       << safeSizeRatio << ">" << std::endl;
 
     std::vector<std::string> imageFilenames;
     imageFilenames.reserve(_focalLengths.size());
@@ -222,39 +1239,319 @@ void ImageStitcher::_readData(const std::string& imageDirectory,
     std::sort(imageFilenames.begin(), imageFilenames.end());
 
     for (std::size_t i = 0; i < imageFilenames.size(); ++i) {
-        std::cout << "    Image " << (i + 1) << ": " << imageFilenames[i]
-                  << std::endl;
+        _logger.progress() << "    Image " << (i + 1) << ": " << imageFilenames[i]
+                           << std::endl;
+    }
+    _imageFilenames = imageFilenames;
 
-        const cv::Mat  image = cv::imread(imageFilenames[i]);
-        const cv::Size resizeRes(static_cast<int>(image.cols * safeSizeRatio),
-                                 static_cast<int>(image.rows * safeSizeRatio));
+    // images are loaded on demand in sliding-window mode,
+    // otherwise they are decoded in parallel
+    if (!_isSlidingWindow) {
+        const int numImages = static_cast<int>(imageFilenames.size());
+        _images.assign(numImages, cv::Mat());
 
-        cv::Mat resizeImage;
-        cv::resize(image, resizeImage, resizeRes, cv::INTER_LINEAR);
-        _images.push_back(resizeImage);
+        TaskScheduler scheduler(_workerPool);
+        for (int n = 0; n < numImages; ++n) {
+            scheduler.addTask("read " + std::to_string(n + 1), [this, n, safeSizeRatio]() {
+                _readImage(_imageFilenames[n], safeSizeRatio, &_images[n]);
+            });
+        }
+
+        scheduler.run();
     }
 
     // create directory which stores result images
     std_fs::create_directory("./result");
 
-#ifdef DRAW_WARP_IMAGES
-    std_fs::create_directory("./result/warp");
-#endif
+    _logger.progress() << "# Total read " << _imageFilenames.size() << " images"
+                       << std::endl;
+}
 
-#ifdef DRAW_FEATURE_IMAGES
-    std_fs::create_directory("./result/feature");
-#endif
+void ImageStitcher::_setData(const std::vector<cv::Mat>& images,
+                             const std::vector<float>&   focalLengths,
+                             const float                 sizeRatio) {
 
-#ifdef DRAW_FEATURE_MATCHING_IMAGES
-    std_fs::create_directory("./result/matching");
-#endif
+    // clamp sizeRatio to 0.1 ~ 1.0
+    _sizeRatio = std::min(std::max(sizeRatio, 0.1f), 1.0f);
 
-#ifdef DRAW_BLEND_IMAGES
-    std_fs::create_directory("./result/blend");
-#endif
+    /*
+        Source images are shared with the caller (not copied),
+        they are scaled again for re-alignment
+    */
+    _sourceImages = images;
+    _focalLengths = focalLengths;
+
+    _logger.progress() << "# Begin to scale images"
+                       << std::endl
+                       << "    Using image scale ratio: <"
+                       << _sizeRatio << ">" << std::endl;
+
+    // images are loaded on demand in sliding-window mode
+    if (!_isSlidingWindow) {
+        for (int n = 0; n < static_cast<int>(_sourceImages.size()); ++n) {
+            cv::Mat resizeImage;
+            _loadImage(n, _sizeRatio, &resizeImage);
+            _images.push_back(resizeImage);
+        }
+    }
+
+    _logger.progress() << "# Total got " << _sourceImages.size() << " images"
+                       << std::endl;
+}
+
+void ImageStitcher::_loadImage(const int      n,
+                               const float    sizeRatio,
+                               cv::Mat* const out_image) const {
+
+    if (_sourceImages.empty()) {
+        _readImage(_imageFilenames[n], sizeRatio, out_image);
+
+        return;
+    }
+
+    const cv::Mat& image = _sourceImages[n];
+    const cv::Size resizeRes(static_cast<int>(image.cols * sizeRatio),
+                             static_cast<int>(image.rows * sizeRatio));
+
+    cv::resize(image, *out_image, resizeRes, cv::INTER_LINEAR);
+}
+
+void ImageStitcher::_readImage(const std::string& imageFilename,
+                               const float        sizeRatio,
+                               cv::Mat* const     out_image) const {
+
+    /*
+        JPEG decoder can decode at 1/2, 1/4 or 1/8 scale (DCT scaling),
+        so the largest reduction not below sizeRatio is decoded and
+        only a small resize is left. Reduced size is ceil(size / reduction),
+        so size of the full image is only estimated from it.
+    */
+    int reduction = 1;
+    int readMode  = cv::IMREAD_COLOR;
+    if (sizeRatio <= 0.125f) {
+        reduction = 8;
+        readMode  = cv::IMREAD_REDUCED_COLOR_8;
+    }
+    else if (sizeRatio <= 0.25f) {
+        reduction = 4;
+        readMode  = cv::IMREAD_REDUCED_COLOR_4;
+    }
+    else if (sizeRatio <= 0.5f) {
+        reduction = 2;
+        readMode  = cv::IMREAD_REDUCED_COLOR_2;
+    }
+
+    const cv::Mat image = cv::imread(imageFilename, readMode);
+    if (image.empty()) {
+        throw std::runtime_error("Image can't read: " + imageFilename);
+    }
+
+    const float    ratio = sizeRatio * reduction;
+    const cv::Size resizeRes(static_cast<int>(image.cols * ratio),
+                             static_cast<int>(image.rows * ratio));
+
+    if (resizeRes == image.size()) {
+        *out_image = image;
+
+        return;
+    }
+
+    cv::resize(image, *out_image, resizeRes, cv::INTER_LINEAR);
+}
+
+void ImageStitcher::_realignImagePairs(
+    const std::vector<cv::Mat>&        warpImages,
+    std::vector<ImageAlignment>* const out_imageAlignments) const {
+
+    std::vector<ImageAlignment>& imageAlignments = *out_imageAlignments;
+    const int numPairs = static_cast<int>(imageAlignments.size());
+
+    /*
+        Check alignment of each image pair, a pair is suspicious if
+
+        1. it has too few inliers (only for feature-based imageMatcher)
+        2. its inliers have large mean residual
+        3. its correlation peak is low (only for correlation-based imageMatcher)
+        4. its translation deviates too much from the median translation
+           of other pairs (the camera is swept with nearly constant speed),
+           pairs failing 1-3 are excluded from the median, so one
+           misaligned pair doesn't make others suspicious too
+    */
+    const int   minInliers        = 6;
+    const float maxResidual       = 2.0f;
+    const float minResponse       = 0.05f;
+    const float maxDeviationRatio = 0.15f;
+
+    std::vector<bool> isSuspicious(numPairs, false);
+    for (int n = 0; n < numPairs; ++n) {
+        const ImageAlignment& alignment = imageAlignments[n];
+
+        isSuspicious[n] = (_imageMatcher->isFeatureBased() && alignment.numInliers < minInliers) ||
+                          (!_imageMatcher->isFeatureBased() && alignment.response < minResponse) ||
+                          alignment.residual > maxResidual;
+    }
+
+    // component-wise median translation of pairs other than n which are not suspicious
+    const auto getMedianTranslation = [&imageAlignments, &isSuspicious, numPairs](const int n, cv::Point2f* const out_median) {
+        std::vector<float> xs;
+        std::vector<float> ys;
+        for (int other = 0; other < numPairs; ++other) {
+            if (other != n && !isSuspicious[other]) {
+                xs.push_back(static_cast<float>(imageAlignments[other].translation.x));
+                ys.push_back(static_cast<float>(imageAlignments[other].translation.y));
+            }
+        }
+
+        if (xs.empty()) {
+            return false;
+        }
+
+        const auto getMedian = [](std::vector<float>* const values) {
+            const std::size_t middle = values->size() / 2;
+            std::nth_element(values->begin(), values->begin() + middle, values->end());
+            const float upper = (*values)[middle];
+            if (values->size() % 2 != 0) {
+                return upper;
+            }
+
+            const float lower = *std::max_element(values->begin(), values->begin() + middle);
+
+            return (lower + upper) * 0.5f;
+        };
+
+        *out_median = cv::Point2f(getMedian(&xs), getMedian(&ys));
+
+        return true;
+    };
+
+    std::vector<cv::Point2f> medianTranslations(numPairs);
+    std::vector<bool>        hasMedianTranslation(numPairs);
+    for (int n = 0; n < numPairs; ++n) {
+        hasMedianTranslation[n] = getMedianTranslation(n, &medianTranslations[n]);
+    }
+
+    const auto getDeviation = [&medianTranslations, &hasMedianTranslation](const int n, const cv::Point& translation) {
+        if (!hasMedianTranslation[n]) {
+            return 0.0f;
+        }
+
+        const cv::Point2f diff = cv::Point2f(translation) - medianTranslations[n];
+
+        return std::sqrt(diff.x * diff.x + diff.y * diff.y);
+    };
+
+    std::vector<int> suspiciousPairs;
+    for (int n = 0; n < numPairs; ++n) {
+        const float maxDeviation = maxDeviationRatio * warpImages[n].cols;
+
+        if (isSuspicious[n] || getDeviation(n, imageAlignments[n].translation) > maxDeviation) {
+            suspiciousPairs.push_back(n);
+        }
+    }
+
+    if (suspiciousPairs.empty()) {
+        return;
+    }
+
+    if (_realignSizeRatio <= _sizeRatio) {
+        _logger.warning() << "# Found " << suspiciousPairs.size() << " suspicious image pairs, "
+                          << "but re-alignment scale ratio <" << _realignSizeRatio << "> is not larger "
+                          << "than image scale ratio, skip re-alignment"
+                          << std::endl;
+
+        return;
+    }
+
+    _logger.progress() << "# Begin to re-align " << suspiciousPairs.size() << " suspicious image pairs"
+                       << std::endl
+                       << "    Using image scale ratio: <"
+                       << _realignSizeRatio << ">" << std::endl;
 
-    std::cout << "# Total read " << _images.size() << " images"
-              << std::endl;
+    /*
+        Re-detect and re-match each suspicious pair at higher resolution.
+
+        Focal lengths are scaled with the same ratio, so the high
+        resolution warpped image is the scaled version of the
+        low resolution one, and its transform can be scaled back by
+
+        transform = S * highTransform * S^-1, S = scale(lowRatio / highRatio)
+    */
+    const float scale = _sizeRatio / _realignSizeRatio;
+    const cv::Matx33d S(scale, 0.0,   0.0,
+                        0.0,   scale, 0.0,
+                        0.0,   0.0,   1.0);
+    const cv::Matx33d invS(1.0 / scale, 0.0,         0.0,
+                           0.0,         1.0 / scale, 0.0,
+                           0.0,         0.0,         1.0);
+
+    for (auto& n : suspiciousPairs) {
+        std::vector<cv::Mat> images(2);
+        _loadImage(n,     _realignSizeRatio, &images[0]);
+        _loadImage(n + 1, _realignSizeRatio, &images[1]);
+
+        const std::vector<float> focalLengths = { _focalLengths[n]     / scale,
+                                                  _focalLengths[n + 1] / scale };
+
+        std::vector<cv::Mat> highWarpImages;
+        std::vector<cv::Mat> highWarpImageIndices;
+        _imageWarpper->warp(images, focalLengths, &highWarpImages, &highWarpImageIndices);
+
+        std::vector<std::vector<cv::Point>>           featurePositions;
+        std::vector<std::vector<std::pair<int, int>>> featureMatchings;
+        if (_imageMatcher->isFeatureBased()) {
+            std::vector<std::vector<std::vector<float>>> featureDescriptors;
+            _featureDetector->detect(highWarpImages, &featurePositions);
+            _featureDescriptor->calculate(highWarpImages, featurePositions, &featureDescriptors);
+            _featureMatcher->match(highWarpImages, featurePositions, featureDescriptors, &featureMatchings);
+        }
+
+        std::vector<ImageAlignment> highAlignments;
+        _imageMatcher->match(highWarpImages, featurePositions, featureMatchings, &highAlignments);
+
+        ImageAlignment realignment = highAlignments[0];
+        realignment.transform = S * realignment.transform * invS;
+        realignment.residual *= scale;
+        realignment.updateTranslation(warpImages[n].cols, warpImages[n + 1].size());
+
+        /*
+            Accept the new alignment unless it deviates from the
+            median translation of other pairs (calculated before
+            re-alignment) more than the old one
+        */
+        const float oldDeviation = getDeviation(n, imageAlignments[n].translation);
+        const float newDeviation = getDeviation(n, realignment.translation);
+
+        _logger.progress() << "    Image pair " << (n + 1) << "-" << (n + 2) << ": ("
+                           << imageAlignments[n].translation.x << ", " << imageAlignments[n].translation.y << ") -> ("
+                           << realignment.translation.x << ", " << realignment.translation.y << ")"
+                           << ((newDeviation <= oldDeviation) ? "" : ", rejected")
+                           << std::endl;
+
+        if (newDeviation <= oldDeviation) {
+            imageAlignments[n] = realignment;
+        }
+    }
+
+    _logger.progress() << "# Finish re-alignment"
+                       << std::endl;
+}
+
+void ImageStitcher::_flushDebugImages() const {
+    if (_debugImageWriter) {
+        _debugImageWriter->flush();
+    }
+}
+
+void ImageStitcher::_checkCancelled() const {
+    if (_cancelFlag && *_cancelFlag) {
+        throw StitchCancelled();
+    }
+}
+
+void ImageStitcher::_reportProgress(const std::string& stage, const int numDone, const int numTotal) const {
+    if (_progressHook) {
+        _progressHook(stage, numDone, numTotal);
+    }
 }
 
 } // namespace sis
\ No newline at end of file
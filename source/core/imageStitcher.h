@@ -1,46 +1,291 @@
 #pragma once
 
+#include "core/imageAlignment.h"
+#include "core/logger.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
 #include <opencv2/opencv.hpp>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace sis {
 
 class BundleAdjuster;
 class CommandArgument;
+class DebugImageWriter;
+class FeatureCache;
+class ExposureCompensator;
 class FeatureDescriptor;
 class FeatureDetector;
 class FeatureMatcher;
 class ImageBlender;
 class ImageMatcher;
 class ImageWarpper;
+class PanoramaSink;
+class WarpTableCache;
+class WorkerPool;
+
+// thrown by ImageStitcher::solve once its cancel flag is set
+class StitchCancelled : public std::runtime_error {
+public:
+    StitchCancelled() :
+        std::runtime_error("Stitching is cancelled") {
+    }
+};
 
 class ImageStitcher {
 public:
+    using ProgressHook = std::function<void(const std::string& stage,
+                                            const int          numDone,
+                                            const int          numTotal)>;
+
     ImageStitcher(const CommandArgument& arguments);
+    ImageStitcher(const CommandArgument& arguments, const Logger& logger);
+    ImageStitcher(
+        const CommandArgument&             arguments,
+        const Logger&                      logger,
+        const std::shared_ptr<WorkerPool>& workerPool);
+    ImageStitcher(
+        const CommandArgument&                 arguments,
+        const Logger&                          logger,
+        const std::shared_ptr<WorkerPool>&     workerPool,
+        const std::shared_ptr<WarpTableCache>& warpTableCache);
+
+    /*
+        In-memory images (LEFT-TO-RIGHT) and their focal lengths,
+        image directory of arguments is ignored
+    */
+    ImageStitcher(
+        const std::vector<cv::Mat>& images,
+        const std::vector<float>&   focalLengths,
+        const CommandArgument&      arguments);
+
+    /*
+        logger    : progress and warnings of the stitcher and its stages
+                    go to it (Logger::console() by default)
+        workerPool: tasks of the stitcher run on it, so stitchers
+                    sharing it share its threads (ex. jobs of batch
+                    mode), nullptr creates a pool of "numThreads" threads
+
+        warpTableCache: inverse warp tables of the warpper, stitchers
+                        sharing it reuse tables of the same image size
+                        and focal length (ex. jobs of daemon mode),
+                        nullptr gives the stitcher its own cache
+    */
+    ImageStitcher(
+        const std::vector<cv::Mat>& images,
+        const std::vector<float>&   focalLengths,
+        const CommandArgument&      arguments,
+        const Logger&               logger);
+
+    ImageStitcher(
+        const std::vector<cv::Mat>&        images,
+        const std::vector<float>&          focalLengths,
+        const CommandArgument&             arguments,
+        const Logger&                      logger,
+        const std::shared_ptr<WorkerPool>& workerPool);
+
+    ImageStitcher(
+        const std::vector<cv::Mat>&            images,
+        const std::vector<float>&              focalLengths,
+        const CommandArgument&                 arguments,
+        const Logger&                          logger,
+        const std::shared_ptr<WorkerPool>&     workerPool,
+        const std::shared_ptr<WarpTableCache>& warpTableCache);
 
     ~ImageStitcher();
 
     void solve(cv::Mat* const out_panorama) const;
 
+    // Streaming mode, panorama is written to sink strip by strip
+    void solve(PanoramaSink* const sink) const;
+
+    /*
+        Incremental mode, frames come one by one (LEFT-TO-RIGHT).
+
+        Only the new frame is warpped and described, it is matched
+        with the last frame only, and only the panorama region it
+        covers is blended again, so appending a frame costs the same
+        however long the sequence is.
+
+        Frames which can't overlap later frames are released, and
+        bundle adjustment and drift correction are skipped.
+
+        Blended tiles are NOT released, getAppendedPanorama returns
+        the whole panorama, so memory grows with the panorama (about
+        3 bytes per pixel of its bounding rect, plus 4 bytes per column
+        of column offsets). append throws std::runtime_error instead
+        of growing the bounding rect over APPEND_MAX_PIXELS.
+    */
+    void append(const cv::Mat& image, const float focalLength);
+    void getAppendedPanorama(cv::Mat* const out_panorama) const;
+
+    /*
+        progressHook: it is called as stages of solve make progress
+                      ("alignment" counts its tasks), alignment tasks
+                      call it from worker threads, so it needs to be
+                      thread-safe.
+    */
+    void setProgressHook(const ProgressHook& progressHook);
+
+    /*
+        Once cancelFlag is set (ex. by another thread), solve throws
+        StitchCancelled at its next task or stage boundary
+    */
+    void setCancelFlag(const std::atomic<bool>* const cancelFlag);
+
 private:
+    /*
+        A frame kept for appending, alignment is between
+        the previous frame and it
+    */
+    struct AppendedFrame {
+        cv::Mat                         warpImage;
+        cv::Mat                         warpImageIndex;
+        std::vector<cv::Point>          featurePositions;
+        std::vector<std::vector<float>> featureDescriptors;
+        ImageAlignment                  alignment;
+        cv::Point                       position;
+        float                           gain;
+    };
+
+    /*
+        Sliding-window mode, each image goes through warpping,
+        feature stages and matching with its previous image only,
+        and then it is released. Images are loaded again when
+        sink's strips reach them in blending.
+
+        Bundle adjustment, loop closure and re-alignment need
+        all images, so they are skipped, and alignments are
+        translation-only. Exposure gains are chained pair by pair.
+    */
+    void _solveInWindow(PanoramaSink* const sink) const;
+
+    // read image n and warp it
+    void _loadWarpImage(
+        const int      n,
+        cv::Mat* const out_warpImage,
+        cv::Mat* const out_warpImageIndex) const;
+
+    /*
+        Warp and align images, out_featurePositions and out_featureMatchings
+        are empty for feature-free imageMatcher.
+
+        For a closed (360 degrees) sweep, out_featureMatchings and
+        out_imageAlignments have an extra image pair (last, first).
+    */
+    void _alignImages(
+        std::vector<cv::Mat>* const                          out_warpImages,
+        std::vector<cv::Mat>* const                          out_warpImageIndices,
+        std::vector<std::vector<cv::Point>>* const           out_featurePositions,
+        std::vector<std::vector<std::pair<int, int>>>* const out_featureMatchings,
+        std::vector<ImageAlignment>* const                   out_imageAlignments) const;
+
+    /*
+        Warpping, feature stages and matching of each image
+        (pair) run as tasks of a TaskScheduler
+    */
+    void _runAlignmentTasks(
+        std::vector<cv::Mat>* const                          out_warpImages,
+        std::vector<cv::Mat>* const                          out_warpImageIndices,
+        std::vector<std::vector<cv::Point>>* const           out_featurePositions,
+        std::vector<std::vector<std::vector<float>>>* const  out_featureDescriptors,
+        std::vector<std::vector<std::pair<int, int>>>* const out_featureMatchings,
+        std::vector<ImageAlignment>* const                   out_imageAlignments) const;
+
+    bool _isClosedSweep(
+        const std::vector<cv::Mat>&        warpImages,
+        const std::vector<ImageAlignment>& imageAlignments) const;
+
+    void _compensateExposure(
+        const std::vector<cv::Mat>&        warpImages,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        std::vector<float>* const          out_imageGains) const;
+
     void _readData(const std::string& imageDirectory, 
                    const std::string& focalLengthFilename,
                    const float        sizeRatio);
 
+    // decode image scaled by sizeRatio, at reduced JPEG scale if possible
+    void _readImage(const std::string& imageFilename,
+                    const float        sizeRatio,
+                    cv::Mat* const     out_image) const;
+
+    void _setData(const std::vector<cv::Mat>& images,
+                  const std::vector<float>&   focalLengths,
+                  const float                 sizeRatio);
+
+    // load image n (from memory or file) scaled by sizeRatio
+    void _loadImage(const int      n,
+                    const float    sizeRatio,
+                    cv::Mat* const out_image) const;
+
+    void _realignImagePairs(
+        const std::vector<cv::Mat>&        warpImages,
+        std::vector<ImageAlignment>* const out_imageAlignments) const;
+
+    // wait until queued debug images are written
+    void _flushDebugImages() const;
+
+    // throws StitchCancelled if cancel flag is set
+    void _checkCancelled() const;
+
+    void _reportProgress(const std::string& stage, const int numDone, const int numTotal) const;
+
+    // Stages keep a pointer to it, so it is declared before them
+    Logger _logger;
+
     // Input images
     // The order needs to be LEFT-TO-RIGHT
-    std::vector<cv::Mat> _images;
-    std::vector<float>   _focalLengths;
-
-    std::unique_ptr<ImageWarpper>      _imageWarpper;
-    std::unique_ptr<FeatureDetector>   _featureDetector;
-    std::unique_ptr<FeatureDescriptor> _featureDescriptor;
-    std::unique_ptr<FeatureMatcher>    _featureMatcher;
-    std::unique_ptr<ImageMatcher>      _imageMatcher;
-    std::unique_ptr<ImageBlender>      _imageBlender;
-    std::unique_ptr<BundleAdjuster>    _bundleAdjuster;
+    std::vector<cv::Mat>     _images;
+    std::vector<cv::Mat>     _sourceImages; // unscaled in-memory images
+    std::vector<float>       _focalLengths;
+    std::vector<std::string> _imageFilenames;
+    float                    _sizeRatio;
+
+    // Scale ratio used to re-align failed or suspicious image pairs,
+    // re-alignment is disabled if it is not larger than _sizeRatio
+    float _realignSizeRatio;
+
+    // Crop panorama to its largest fully valid rect
+    bool _isCropped;
+
+    // Images are not kept in _images but loaded on demand
+    bool _isSlidingWindow;
+
+    // Workers of task schedulers, it may be shared with other stitchers
+    std::shared_ptr<WorkerPool> _workerPool;
+
+    std::unique_ptr<ImageWarpper>        _imageWarpper;
+    std::unique_ptr<FeatureDetector>     _featureDetector;
+    std::unique_ptr<FeatureDescriptor>   _featureDescriptor;
+    std::unique_ptr<FeatureMatcher>      _featureMatcher;
+    std::unique_ptr<ImageMatcher>        _imageMatcher;
+    std::unique_ptr<ExposureCompensator> _exposureCompensator; // nullptr if it is disabled
+    std::unique_ptr<ImageBlender>        _imageBlender;
+    std::unique_ptr<BundleAdjuster>      _bundleAdjuster;
+    std::unique_ptr<DebugImageWriter>    _debugImageWriter; // nullptr if it is disabled
+    std::unique_ptr<FeatureCache>        _featureCache;     // nullptr if it is disabled
+
+    ProgressHook             _progressHook;
+    const std::atomic<bool>* _cancelFlag; // nullptr if it can't be cancelled
+
+    // States of incremental mode, tiles are keyed by (tileX, tileY)
+    std::deque<AppendedFrame>              _appendedFrames;
+    std::map<std::pair<int, int>, cv::Mat> _appendedTiles;
+    std::vector<int>                       _appendedColumnOffsets;
+    cv::Rect                               _appendedBounds;
+    int                                    _numAppendedFrames;
+
+    static constexpr int       APPEND_TILE_SIZE  = 256;
+    static constexpr long long APPEND_MAX_PIXELS = 1LL << 28; // 768 MB of tiles
 };
 
 } // namespace sis
\ No newline at end of file
@@ -1,8 +1,8 @@
 #pragma once
 
-#include "config.h"
+#include "core/logger.h"
+#include "core/profiler.h"
 
-#include <cstdio>
 #include <opencv2/opencv.hpp>
 #include <vector>
 
@@ -11,16 +11,14 @@ namespace sis {
 /*
     ImageWarpper is used for image warpping.
 
-    It's an interface which only defines warp function,
-    and user can control if it needs to output warpped images
-    in the config.h file.
+    It's an interface which only defines warp function.
 
     out_warpImageIndices: It records if a pixel succeeds in
                           inverse warpping interpolation.
                           (1 for success, 0 for failure, and 
                            it would be used in image blending.)
 */
-class ImageWarpper {
+class ImageWarpper : public Loggable {
 public:
     void warp(
         const std::vector<cv::Mat>& images,
@@ -34,8 +32,6 @@ private:
         const std::vector<float>&   focalLengths, 
         std::vector<cv::Mat>* const out_warpImages,
         std::vector<cv::Mat>* const out_warpImageIndices) const = 0;
-
-    void _writeImages(const std::vector<cv::Mat>& images) const;
 };
 
 // header implementation
@@ -46,19 +42,16 @@ inline void ImageWarpper::warp(
     std::vector<cv::Mat>* const out_warpImages,
     std::vector<cv::Mat>* const out_warpImageIndices) const {
 
-    _warpImpl(images, focalLengths, out_warpImages, out_warpImageIndices);
-
-#ifdef DRAW_WARP_IMAGES
-    _writeImages(*out_warpImages);
+    profiler::ScopedTimer timer("image warpping");
 
-#endif 
-}
+    const std::size_t numWarpImages = out_warpImages->size();
+    _warpImpl(images, focalLengths, out_warpImages, out_warpImageIndices);
 
-inline void ImageWarpper::_writeImages(const std::vector<cv::Mat>& images) const {
-    for (std::size_t i = 0; i < images.size(); ++i) {
-        char filename[100];
-        sprintf(filename, "./result/warp/warp%02zd.png", i);
-        cv::imwrite(filename, images[i]);
+    if (profiler::isEnabled()) {
+        for (std::size_t i = numWarpImages; i < out_warpImages->size(); ++i) {
+            const cv::Mat& warpImage = (*out_warpImages)[i];
+            profiler::count("warp bytes", static_cast<double>(warpImage.total() * warpImage.elemSize()));
+        }
     }
 }
 
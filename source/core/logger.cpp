@@ -0,0 +1,63 @@
+#include "core/logger.h"
+
+#include <mutex>
+
+namespace sis {
+
+namespace {
+
+// messages of all loggers are written one at a time
+std::mutex& messageMutex() {
+    static std::mutex mutex;
+
+    return mutex;
+}
+
+} // anonymous namespace
+
+Logger::Message::Message(std::ostream* const stream) :
+    _stream(stream),
+    _buffer() {
+}
+
+Logger::Message::~Message() {
+    if (!_stream) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(messageMutex());
+    *_stream << _buffer.str() << std::flush;
+}
+
+Logger::Message& Logger::Message::operator<<(std::ostream& (*manipulator)(std::ostream&)) {
+    if (_stream) {
+        manipulator(_buffer);
+    }
+
+    return *this;
+}
+
+Logger::Logger() :
+    Logger(&std::cout, &std::cout) {
+}
+
+Logger::Logger(std::ostream* const progressStream, std::ostream* const warningStream) :
+    _progressStream(progressStream),
+    _warningStream(warningStream) {
+}
+
+Logger::Message Logger::progress() const {
+    return Message(_progressStream);
+}
+
+Logger::Message Logger::warning() const {
+    return Message(_warningStream);
+}
+
+const Logger& Logger::console() {
+    static const Logger logger;
+
+    return logger;
+}
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+
+namespace sis {
+
+/*
+    Logger writes progress and warnings of an ImageStitcher and its
+    stages, so concurrent stitchers (ex. jobs of batch mode) and
+    applications embedding the library decide where the output goes,
+    instead of sharing std::cout.
+
+    progressStream: stage progress (ex. "# Begin ..."), nullptr drops it
+    warningStream : warnings (ex. unknown option types), nullptr drops them
+
+    A message is buffered until its statement ends, and then written
+    to its stream as a whole. Messages of all loggers are serialized,
+    so stages running on worker threads may log at the same time.
+
+    Ex. logger.warning() << "Unknown imageBlender type: <" << type << ">"
+                         << std::endl;
+*/
+class Logger {
+public:
+    class Message {
+    public:
+        explicit Message(std::ostream* const stream);
+        ~Message();
+
+        Message(const Message&) = delete;
+        Message& operator=(const Message&) = delete;
+
+        template<typename T>
+        Message& operator<<(const T& value);
+
+        // manipulators, ex. std::endl and std::flush
+        Message& operator<<(std::ostream& (*manipulator)(std::ostream&));
+
+    private:
+        std::ostream*      _stream;
+        std::ostringstream _buffer;
+    };
+
+    // both progress and warnings go to std::cout
+    Logger();
+    Logger(std::ostream* const progressStream, std::ostream* const warningStream);
+
+    Message progress() const;
+    Message warning() const;
+
+    // logger of std::cout
+    static const Logger& console();
+
+private:
+    std::ostream* _progressStream;
+    std::ostream* _warningStream;
+};
+
+/*
+    Loggable is the base of objects which log (ex. stages), they log
+    to Logger::console() until their owner sets its own logger, which
+    needs to outlive them.
+*/
+class Loggable {
+public:
+    Loggable();
+
+    void setLogger(const Logger* const logger);
+
+protected:
+    const Logger& _log() const;
+
+private:
+    const Logger* _logger;
+};
+
+// header implementation
+
+template<typename T>
+inline Logger::Message& Logger::Message::operator<<(const T& value) {
+    if (_stream) {
+        _buffer << value;
+    }
+
+    return *this;
+}
+
+inline Loggable::Loggable() :
+    _logger(&Logger::console()) {
+}
+
+inline void Loggable::setLogger(const Logger* const logger) {
+    _logger = logger;
+}
+
+inline const Logger& Loggable::_log() const {
+    return *_logger;
+}
+
+} // namespace sis
\ No newline at end of file
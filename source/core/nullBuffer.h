@@ -0,0 +1,22 @@
+#pragma once
+
+#include <streambuf>
+
+namespace sis {
+
+/*
+    NullBuffer is a stream buffer which drops everything written to it.
+
+    It backs an std::ostream whose output is unwanted but which must
+    accept writes. Unlike a null rdbuf, writes still succeed, so the
+    stream's error state is never set. To mute stages, give them a
+    Logger with nullptr streams instead.
+*/
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+};
+
+} // namespace sis
\ No newline at end of file
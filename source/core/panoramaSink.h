@@ -0,0 +1,26 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+namespace sis {
+
+/*
+    PanoramaSink receives panorama strip by strip, so that
+    the whole panorama never needs to stay in memory.
+
+    Strips are vertical (full panorama height) CV_8UC3 images,
+    they come from left to right and each one begins at
+    x = k * stripWidth(), only the last strip may be narrower.
+*/
+class PanoramaSink {
+public:
+    virtual ~PanoramaSink() = default;
+
+    virtual void begin(const cv::Size& panoramaSize) = 0;
+    virtual void write(const cv::Mat& strip, const int stripX) = 0;
+    virtual void end() = 0;
+
+    virtual int stripWidth() const = 0;
+};
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sis::profiler {
+
+namespace {
+
+struct Record {
+    std::string name;
+    int         threadIndex;
+    double      beginTime;
+    double      value;    // duration for span
+    bool        isCounter;
+};
+
+struct Statistics {
+    int    count = 0;
+    double total = 0.0;
+    double min   = 0.0;
+    double max   = 0.0;
+};
+
+const std::chrono::steady_clock::time_point programBeginTime = std::chrono::steady_clock::now();
+
+std::mutex                     recordMutex;
+std::vector<Record>            records;
+std::map<std::thread::id, int> threadIndices;
+
+// needs recordMutex
+int getThreadIndex() {
+    const auto result = threadIndices.insert(
+        std::make_pair(std::this_thread::get_id(), static_cast<int>(threadIndices.size())));
+
+    return result.first->second;
+}
+
+void writeString(std::ofstream& file, const std::string& string) {
+    file << '"';
+    for (auto& c : string) {
+        if (c == '"' || c == '\\') {
+            file << '\\';
+        }
+        file << c;
+    }
+    file << '"';
+}
+
+void writeStatistics(std::ofstream& file, const std::map<std::string, Statistics>& statistics) {
+    file << "{";
+    bool isFirst = true;
+    for (const auto& entry : statistics) {
+        file << (isFirst ? "\n" : ",\n") << "    ";
+        writeString(file, entry.first);
+        file << ": { \"count\": " << entry.second.count
+             << ", \"total\": "   << entry.second.total
+             << ", \"min\": "     << entry.second.min
+             << ", \"max\": "     << entry.second.max
+             << " }";
+
+        isFirst = false;
+    }
+    file << "\n  }";
+}
+
+} // anonymous namespace
+
+void setEnabled(const bool isEnabled) {
+    enabledFlag.store(isEnabled, std::memory_order_relaxed);
+}
+
+void clear() {
+    std::lock_guard<std::mutex> lock(recordMutex);
+    records.clear();
+}
+
+double now() {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - programBeginTime).count();
+}
+
+void recordSpan(const char* const name, const double beginTime, const double endTime) {
+    std::lock_guard<std::mutex> lock(recordMutex);
+    records.push_back({ name, getThreadIndex(), beginTime, endTime - beginTime, false });
+}
+
+void recordCounter(const char* const name, const double value) {
+    const double time = now();
+
+    std::lock_guard<std::mutex> lock(recordMutex);
+    records.push_back({ name, getThreadIndex(), time, value, true });
+}
+
+bool writeChromeTrace(const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file) {
+        return false;
+    }
+
+    /*
+        Spans are complete events ("X"), and counters are
+        counter events ("C"), times are in microseconds
+    */
+    std::lock_guard<std::mutex> lock(recordMutex);
+
+    file << std::fixed << std::setprecision(3)
+         << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        const Record& record = records[i];
+
+        file << (i == 0 ? "\n" : ",\n") << "  {\"name\": ";
+        writeString(file, record.name);
+        file << ", \"pid\": 1, \"tid\": " << record.threadIndex
+             << ", \"ts\": " << record.beginTime * 1000.0;
+
+        if (record.isCounter) {
+            file << ", \"ph\": \"C\", \"args\": {\"value\": " << record.value << "}}";
+        }
+        else {
+            file << ", \"ph\": \"X\", \"dur\": " << record.value * 1000.0 << "}";
+        }
+    }
+    file << "\n]}\n";
+
+    return static_cast<bool>(file);
+}
+
+bool writeSummary(const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(recordMutex);
+
+    // spans are summarized by duration (ms), counters by value
+    std::map<std::string, Statistics> spanStatistics;
+    std::map<std::string, Statistics> counterStatistics;
+    for (const auto& record : records) {
+        Statistics& statistics = record.isCounter ?
+                                 counterStatistics[record.name] :
+                                 spanStatistics[record.name];
+
+        statistics.min    = (statistics.count == 0) ? record.value : std::min(statistics.min, record.value);
+        statistics.max    = (statistics.count == 0) ? record.value : std::max(statistics.max, record.value);
+        statistics.total += record.value;
+        ++statistics.count;
+    }
+
+    file << std::fixed << std::setprecision(3)
+         << "{\n  \"spans\": ";
+    writeStatistics(file, spanStatistics);
+    file << ",\n  \"counters\": ";
+    writeStatistics(file, counterStatistics);
+    file << "\n}\n";
+
+    return static_cast<bool>(file);
+}
+
+} // namespace sis::profiler
\ No newline at end of file
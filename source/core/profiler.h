@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+/*
+    Profiler records scoped timers (spans) and counters of the pipeline,
+    ex. time of each stage call, features per image, matches per pair.
+
+    It is disabled by default, then a timer or a counter only checks
+    one atomic flag, nothing is recorded and no clock is read.
+
+    Records are thread-safe (stages may run concurrently), and they can
+    be written as Chrome trace JSON (chrome://tracing or Perfetto), or
+    as a JSON summary with count, total, min and max of each name.
+*/
+namespace sis::profiler {
+
+inline std::atomic<bool> enabledFlag(false);
+
+inline bool isEnabled() {
+    return enabledFlag.load(std::memory_order_relaxed);
+}
+
+void setEnabled(const bool isEnabled);
+
+// remove all records
+void clear();
+
+// milliseconds since the program begins
+double now();
+
+void recordSpan(const char* const name, const double beginTime, const double endTime);
+void recordCounter(const char* const name, const double value);
+
+bool writeChromeTrace(const std::string& filename);
+bool writeSummary(const std::string& filename);
+
+inline void count(const char* const name, const double value) {
+    if (isEnabled()) {
+        recordCounter(name, value);
+    }
+}
+
+/*
+    ScopedTimer records a span from its construction to its destruction,
+    name needs to outlive the timer (ex. a string literal)
+*/
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char* const name) :
+        _name(name),
+        _beginTime(isEnabled() ? now() : -1.0) {
+    }
+
+    ~ScopedTimer() {
+        if (_beginTime >= 0.0) {
+            recordSpan(_name, _beginTime, now());
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    const char* _name;
+    double      _beginTime;
+};
+
+} // namespace sis::profiler
\ No newline at end of file
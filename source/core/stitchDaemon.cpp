@@ -0,0 +1,736 @@
+#include "core/stitchDaemon.h"
+
+#include "commandArgument.h"
+#include "core/imageStitcher.h"
+#include "core/taskScheduler.h"
+#include "core/warpTableCache.h"
+#include "panoramaSink/tiffPanoramaSink.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <sstream>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace sis {
+
+namespace {
+
+void skipSpaces(const std::string& text, std::size_t* const pos) {
+    while (*pos < text.size() && std::isspace(static_cast<unsigned char>(text[*pos]))) {
+        ++(*pos);
+    }
+}
+
+bool readString(const std::string& text, std::size_t* const pos, std::string* const out_string) {
+    if (*pos >= text.size() || text[*pos] != '"') {
+        return false;
+    }
+    ++(*pos);
+
+    std::string& string = *out_string;
+    string.clear();
+    while (*pos < text.size()) {
+        const char c = text[(*pos)++];
+        if (c == '"') {
+            return true;
+        }
+        if (c != '\\') {
+            string.push_back(c);
+
+            continue;
+        }
+
+        if (*pos >= text.size()) {
+            return false;
+        }
+
+        const char escape = text[(*pos)++];
+        if (escape == '"' || escape == '\\' || escape == '/') {
+            string.push_back(escape);
+        }
+        else if (escape == 'b') {
+            string.push_back('\b');
+        }
+        else if (escape == 'f') {
+            string.push_back('\f');
+        }
+        else if (escape == 'n') {
+            string.push_back('\n');
+        }
+        else if (escape == 'r') {
+            string.push_back('\r');
+        }
+        else if (escape == 't') {
+            string.push_back('\t');
+        }
+        else if (escape == 'u') {
+            if (*pos + 4 > text.size() ||
+                !std::all_of(text.begin() + *pos, text.begin() + *pos + 4, [](const char digit) {
+                    return std::isxdigit(static_cast<unsigned char>(digit)) != 0;
+                })) {
+
+                return false;
+            }
+
+            const unsigned long code = std::strtoul(text.substr(*pos, 4).c_str(), nullptr, 16);
+            *pos += 4;
+
+            // encoded as UTF-8, surrogate pairs are not combined
+            if (code < 0x80) {
+                string.push_back(static_cast<char>(code));
+            }
+            else if (code < 0x800) {
+                string.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                string.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            else {
+                string.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                string.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                string.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+        }
+        else {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+/*
+    Read a flat JSON object (requests have no nested values),
+    numbers and literals (ex. true) keep their text
+*/
+bool readObject(const std::string& text, std::unordered_map<std::string, std::string>* const out_values) {
+    std::size_t pos = 0;
+    skipSpaces(text, &pos);
+    if (pos >= text.size() || text[pos] != '{') {
+        return false;
+    }
+    ++pos;
+    skipSpaces(text, &pos);
+
+    bool isEnded = (pos < text.size() && text[pos] == '}');
+    if (isEnded) {
+        ++pos;
+    }
+
+    while (!isEnded) {
+        std::string key;
+        if (!readString(text, &pos, &key)) {
+            return false;
+        }
+
+        skipSpaces(text, &pos);
+        if (pos >= text.size() || text[pos] != ':') {
+            return false;
+        }
+        ++pos;
+        skipSpaces(text, &pos);
+
+        std::string value;
+        if (pos < text.size() && text[pos] == '"') {
+            if (!readString(text, &pos, &value)) {
+                return false;
+            }
+        }
+        else {
+            while (pos < text.size() && text[pos] != ',' && text[pos] != '}' &&
+                   !std::isspace(static_cast<unsigned char>(text[pos]))) {
+
+                value.push_back(text[pos++]);
+            }
+
+            if (value.empty() || value[0] == '{' || value[0] == '[') {
+                return false;
+            }
+        }
+        (*out_values)[key] = value;
+
+        skipSpaces(text, &pos);
+        if (pos >= text.size()) {
+            return false;
+        }
+
+        if (text[pos] == '}') {
+            isEnded = true;
+        }
+        else if (text[pos] != ',') {
+            return false;
+        }
+        ++pos;
+        skipSpaces(text, &pos);
+    }
+
+    skipSpaces(text, &pos);
+
+    return pos == text.size();
+}
+
+std::string quote(const std::string& string) {
+    std::string quoted = "\"";
+    for (const char c : string) {
+        if (c == '"' || c == '\\') {
+            quoted.push_back('\\');
+            quoted.push_back(c);
+        }
+        else if (c == '\n') {
+            quoted += "\\n";
+        }
+        else if (c == '\r') {
+            quoted += "\\r";
+        }
+        else if (c == '\t') {
+            quoted += "\\t";
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            sprintf(code, "\\u%04x", static_cast<unsigned int>(c));
+            quoted += code;
+        }
+        else {
+            quoted.push_back(c);
+        }
+    }
+    quoted.push_back('"');
+
+    return quoted;
+}
+
+} // anonymous namespace
+
+/*
+    A client connection, events of its jobs are sent
+    to stream (stdio client) or socket (socket client)
+*/
+struct StitchDaemon::Client {
+    Client(std::ostream* const stream, const int socket) :
+        stream(stream),
+        socket(socket),
+        mutex(),
+        isDisconnected(false) {
+    }
+
+    ~Client() {
+#if !defined(_WIN32)
+        if (socket >= 0) {
+            ::close(socket);
+        }
+#endif
+    }
+
+    void send(const std::string& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (stream) {
+            *stream << event << std::endl;
+
+            return;
+        }
+
+#if !defined(_WIN32)
+        // events of a disconnected client are dropped
+        const std::string data = event + "\n";
+
+        /*
+            A client disconnecting while its events are sent must not
+            raise SIGPIPE, which is ignored per send (or per socket on
+            platforms without MSG_NOSIGNAL) instead of process-wide
+        */
+#if defined(MSG_NOSIGNAL)
+        const int sendFlags = MSG_NOSIGNAL;
+#else
+        const int sendFlags = 0;
+#endif
+
+        std::size_t offset = 0;
+        while (offset < data.size()) {
+            const ssize_t size = ::send(socket, data.data() + offset, data.size() - offset, sendFlags);
+            if (size < 0 && errno == EINTR) {
+                continue;
+            }
+            if (size <= 0) {
+                return;
+            }
+
+            offset += static_cast<std::size_t>(size);
+        }
+#endif
+    }
+
+    std::ostream*     stream; // nullptr for socket client
+    int               socket; // -1 for stdio client
+    std::mutex        mutex;
+    std::atomic<bool> isDisconnected;
+};
+
+struct StitchDaemon::Job {
+    std::string                                  id;
+    std::unordered_map<std::string, std::string> options;
+    std::shared_ptr<Client>                      client;
+    std::atomic<bool>                            isCancelled;
+};
+
+StitchDaemon::StitchDaemon() :
+    StitchDaemon(1) {
+}
+
+StitchDaemon::StitchDaemon(const int maxConcurrentJobs) :
+    StitchDaemon(maxConcurrentJobs, Logger::console()) {
+}
+
+StitchDaemon::StitchDaemon(const int maxConcurrentJobs, const Logger& logger) :
+    _maxConcurrentJobs(std::max(maxConcurrentJobs, 1)),
+    _workerPool(std::make_shared<WorkerPool>()),
+    _warpTableCache(std::make_shared<WarpTableCache>()),
+    _mutex(),
+    _queueCondition(),
+    _idleCondition(),
+    _queue(),
+    _jobs(),
+    _numRequestedJobs(0),
+    _isShutdown(false),
+    _isStopped(false),
+    _workers(),
+    _logger(logger) {
+
+    // workers wait for jobs for the daemon's whole lifetime
+    for (int i = 0; i < _maxConcurrentJobs; ++i) {
+        _workers.emplace_back(&StitchDaemon::_runWorker, this);
+    }
+}
+
+StitchDaemon::~StitchDaemon() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& job : _queue) {
+            job->isCancelled = true;
+        }
+        for (auto& job : _jobs) {
+            job.second->isCancelled = true;
+        }
+        _isStopped = true;
+    }
+    _queueCondition.notify_all();
+
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+void StitchDaemon::serveStdio() {
+    const std::shared_ptr<Client> client = std::make_shared<Client>(&std::cout, -1);
+
+    std::string request;
+    while (!_isShutdown && std::getline(std::cin, request)) {
+        _handleRequest(request, client);
+    }
+
+    // end of input only ends requests, requested jobs still finish
+    _waitJobs();
+}
+
+bool StitchDaemon::serveSocket(const std::string& socketPath) {
+#if defined(_WIN32)
+    _logger.warning() << "Unix domain socket is not supported on this platform, use <-> (stdin) instead"
+                      << std::endl;
+
+    return false;
+#else
+    sockaddr_un address = {};
+    address.sun_family  = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        _logger.warning() << "Daemon socket path is too long: " << socketPath
+                          << std::endl;
+
+        return false;
+    }
+    socketPath.copy(address.sun_path, socketPath.size());
+
+    const int listenSocket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        _logger.warning() << "Daemon socket can't open"
+                          << std::endl;
+
+        return false;
+    }
+
+    /*
+        A socket file left by a previous daemon is replaced, but a path
+        which isn't a socket, or a socket another daemon still answers
+        on (connect isn't refused), is never removed
+    */
+    struct stat pathStatus = {};
+    if (::lstat(socketPath.c_str(), &pathStatus) == 0) {
+        if (!S_ISSOCK(pathStatus.st_mode)) {
+            _logger.warning() << "Daemon socket path exists and isn't a socket: " << socketPath
+                              << std::endl;
+            ::close(listenSocket);
+
+            return false;
+        }
+
+        const int  probeSocket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        const bool isStale     = probeSocket >= 0 &&
+                                 ::connect(probeSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 &&
+                                 errno == ECONNREFUSED;
+        if (probeSocket >= 0) {
+            ::close(probeSocket);
+        }
+
+        if (!isStale) {
+            _logger.warning() << "Daemon socket is in use (or can't be checked): " << socketPath
+                              << std::endl;
+            ::close(listenSocket);
+
+            return false;
+        }
+
+        ::unlink(socketPath.c_str());
+    }
+
+    if (::bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 ||
+        ::listen(listenSocket, 16) < 0) {
+
+        _logger.warning() << "Daemon socket can't listen: " << socketPath
+                          << std::endl;
+        ::close(listenSocket);
+
+        return false;
+    }
+
+    _logger.progress() << "# Daemon listens on " << socketPath << " with " << _maxConcurrentJobs
+                       << " job workers on " << _workerPool->numThreads() << " shared threads"
+                       << std::endl;
+
+    struct Connection {
+        std::shared_ptr<Client> client;
+        std::thread             thread;
+    };
+    std::vector<Connection> connections;
+
+    while (!_isShutdown) {
+        // clients which have disconnected are cleaned up
+        for (auto connection = connections.begin(); connection != connections.end();) {
+            if (connection->client->isDisconnected) {
+                connection->thread.join();
+                connection = connections.erase(connection);
+            }
+            else {
+                ++connection;
+            }
+        }
+
+        // accept is polled, so shutdown is noticed in time
+        pollfd listenPoll = { listenSocket, POLLIN, 0 };
+        if (::poll(&listenPoll, 1, 200) <= 0) {
+            continue;
+        }
+
+        const int socket = ::accept(listenSocket, nullptr, nullptr);
+        if (socket < 0) {
+            continue;
+        }
+
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+        const int isNoSigPipe = 1;
+        ::setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &isNoSigPipe, sizeof(isNoSigPipe));
+#endif
+
+        Connection connection;
+        connection.client = std::make_shared<Client>(nullptr, socket);
+        connection.thread = std::thread(&StitchDaemon::_serveClient, this, connection.client);
+        connections.push_back(std::move(connection));
+    }
+
+    ::close(listenSocket);
+    ::unlink(socketPath.c_str());
+
+    // wake clients blocked in reading
+    for (auto& connection : connections) {
+        ::shutdown(connection.client->socket, SHUT_RD);
+    }
+    for (auto& connection : connections) {
+        connection.thread.join();
+    }
+
+    _waitJobs();
+
+    _logger.progress() << "# Daemon shuts down"
+                       << std::endl;
+
+    return true;
+#endif
+}
+
+bool StitchDaemon::_handleRequest(const std::string& request, const std::shared_ptr<Client>& client) {
+    if (request.find_first_not_of(" \t\r") == std::string::npos) {
+        return true;
+    }
+
+    std::unordered_map<std::string, std::string> values;
+    if (!readObject(request, &values)) {
+        client->send("{\"event\": \"error\", \"message\": " + quote("Invalid JSON request: " + request) + "}");
+
+        return true;
+    }
+
+    const std::string type = values["type"];
+    const std::string id   = values["id"];
+    values.erase("type");
+    values.erase("id");
+
+    if (type == "stitch") {
+        const auto job = std::make_shared<Job>();
+        job->options     = values;
+        job->client      = client;
+        job->isCancelled = false;
+
+        /*
+            The id is reserved under the lock, but events are sent out
+            of it, so a slow client doesn't block workers and other
+            clients. The job is queued after queued is sent, so it's
+            sent before any worker can start the job.
+        */
+        bool isIdInUse = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            ++_numRequestedJobs;
+            job->id = id.empty() ? "job-" + std::to_string(_numRequestedJobs) : id;
+
+            isIdInUse = (_jobs.find(job->id) != _jobs.end());
+            if (!isIdInUse) {
+                _jobs[job->id] = job;
+            }
+        }
+
+        if (isIdInUse) {
+            client->send("{\"event\": \"error\", \"request\": \"stitch\", \"message\": " + quote("Job id is in use: " + job->id) + "}");
+
+            return true;
+        }
+
+        _sendEvent(*job, "queued");
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.push_back(job);
+        }
+        _queueCondition.notify_one();
+    }
+    else if (type == "cancel") {
+        bool isFound = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            const auto& job = _jobs.find(id);
+            isFound = (job != _jobs.end());
+            if (isFound) {
+                job->second->isCancelled = true;
+            }
+        }
+
+        if (!isFound) {
+            client->send("{\"event\": \"error\", \"request\": \"cancel\", \"message\": " + quote("No queued or running job: " + id) + "}");
+        }
+    }
+    else if (type == "shutdown") {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (auto& job : _jobs) {
+            job.second->isCancelled = true;
+        }
+        _isShutdown = true;
+
+        return false;
+    }
+    else {
+        client->send("{\"event\": \"error\", \"request\": " + quote(type) + ", \"message\": " + quote("Unknown request type: " + type) + "}");
+    }
+
+    return true;
+}
+
+void StitchDaemon::_cancelJobs(const std::shared_ptr<Client>& client) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto& job : _jobs) {
+        if (job.second->client == client) {
+            job.second->isCancelled = true;
+        }
+    }
+}
+
+void StitchDaemon::_waitJobs() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idleCondition.wait(lock, [this]() {
+        return _jobs.empty();
+    });
+}
+
+void StitchDaemon::_runWorker() {
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queueCondition.wait(lock, [this]() {
+                return !_queue.empty() || _isStopped;
+            });
+
+            if (_queue.empty()) {
+                return;
+            }
+
+            job = _queue.front();
+            _queue.pop_front();
+        }
+
+        _runJob(*job);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _jobs.erase(job->id);
+        }
+        _idleCondition.notify_all();
+    }
+}
+
+void StitchDaemon::_runJob(Job& job) const {
+    if (job.isCancelled) {
+        _sendEvent(job, "cancelled");
+
+        return;
+    }
+
+    _sendEvent(job, "started");
+
+    const auto beginTime = std::chrono::steady_clock::now();
+
+    CommandArgument arguments;
+    for (const auto& option : job.options) {
+        arguments.insert(option.first, option.second);
+    }
+
+    const std::string outputFilename = arguments.find("outputFilename", "./result/panorama_result.png");
+
+    /*
+        Stage progress of the job is dropped (its client gets progress
+        events instead), and its warnings are sent as warning events
+    */
+    std::ostringstream warnings;
+    const Logger       jobLogger(nullptr, &warnings);
+
+    const auto sendWarnings = [this, &job, &warnings]() {
+        std::istringstream warningLines(warnings.str());
+        std::string        warning;
+        while (std::getline(warningLines, warning)) {
+            if (!warning.empty()) {
+                _sendEvent(job, "warning", ", \"message\": " + quote(warning));
+            }
+        }
+        warnings.str("");
+    };
+
+    try {
+        // a job setting numThreads has its own workers
+        const bool    hasOwnThreads = (job.options.find("numThreads") != job.options.end());
+        ImageStitcher imageStitcher(arguments, jobLogger, hasOwnThreads ? nullptr : _workerPool, _warpTableCache);
+        sendWarnings();
+
+        imageStitcher.setCancelFlag(&job.isCancelled);
+        imageStitcher.setProgressHook([this, &job](const std::string& stage, const int numDone, const int numTotal) {
+            _sendEvent(job, "progress", ", \"stage\": " + quote(stage) +
+                                        ", \"done\": " + std::to_string(numDone) +
+                                        ", \"total\": " + std::to_string(numTotal));
+        });
+
+        const std::size_t extensionPos = outputFilename.find_last_of('.');
+        const std::string extension    = (extensionPos == std::string::npos) ?
+                                         "" : outputFilename.substr(extensionPos);
+
+        if (extension == ".tif" || extension == ".tiff") {
+            TiffPanoramaSink sink(outputFilename);
+            imageStitcher.solve(&sink);
+        }
+        else {
+            cv::Mat panorama;
+            imageStitcher.solve(&panorama);
+            if (!cv::imwrite(outputFilename, panorama)) {
+                throw std::runtime_error("Panorama file can't write: " + outputFilename);
+            }
+        }
+    }
+    catch (const StitchCancelled&) {
+        sendWarnings();
+        _sendEvent(job, "cancelled");
+
+        return;
+    }
+    catch (const std::exception& exception) {
+        sendWarnings();
+        _sendEvent(job, "failed", ", \"message\": " + quote(exception.what()));
+
+        return;
+    }
+
+    sendWarnings();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - beginTime).count();
+
+    std::ostringstream fields;
+    fields << ", \"output\": " << quote(outputFilename)
+           << ", \"seconds\": " << seconds;
+    _sendEvent(job, "finished", fields.str());
+}
+
+void StitchDaemon::_sendEvent(const Job& job, const std::string& event, const std::string& fields) const {
+    job.client->send("{\"id\": " + quote(job.id) + ", \"event\": " + quote(event) + fields + "}");
+}
+
+#if !defined(_WIN32)
+void StitchDaemon::_serveClient(const std::shared_ptr<Client>& client) {
+    std::string buffer;
+    char        data[4096];
+    while (!_isShutdown) {
+        const ssize_t size = ::recv(client->socket, data, sizeof(data), 0);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            break;
+        }
+        buffer.append(data, static_cast<std::size_t>(size));
+
+        std::size_t lineEnd;
+        while ((lineEnd = buffer.find('\n')) != std::string::npos) {
+            const std::string request = buffer.substr(0, lineEnd);
+            buffer.erase(0, lineEnd + 1);
+
+            if (!_handleRequest(request, client)) {
+                break;
+            }
+        }
+    }
+
+    // jobs nobody waits for are cancelled
+    _cancelJobs(client);
+    client->isDisconnected = true;
+}
+#endif
+
+} // namespace sis
\ No newline at end of file
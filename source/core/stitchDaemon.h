@@ -0,0 +1,115 @@
+#pragma once
+
+#include "core/logger.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace sis {
+
+class WarpTableCache;
+class WorkerPool;
+
+/*
+    StitchDaemon serves stitching jobs of local clients in one long-running
+    process, so a panorama doesn't pay process startup. Job workers stay
+    alive between jobs, at most maxConcurrentJobs jobs run at the same
+    time, and their tasks run on one WorkerPool of all hardware threads
+    (a job whose options set numThreads has workers of its own). Inverse
+    warp tables are cached across jobs, so jobs of the same camera (image
+    size and focal length) only calculate them once.
+
+    Requests and events are JSON objects, one per line. Requests are
+
+        {"type": "stitch", "id": "a", "imageDirectory": "...",
+         "focalLengthFilename": "...", "outputFilename": "...", <key>: <value>, ...}
+        {"type": "cancel", "id": "a"}
+        {"type": "shutdown"}
+
+    keys are the same as command line arguments use (ex. "imageBlender"),
+    and id is optional (the daemon names the job then). Events of a job
+    are sent to the client requesting it
+
+        {"id": "a", "event": "queued"}
+        {"id": "a", "event": "started"}
+        {"id": "a", "event": "progress", "stage": "alignment", "done": 3, "total": 17}
+        {"id": "a", "event": "warning", "message": "..."}
+        {"id": "a", "event": "finished", "output": "...", "seconds": 1.5}
+        {"id": "a", "event": "failed", "message": "..."}
+        {"id": "a", "event": "cancelled"}
+
+    and an invalid request gets {"event": "error", "message": "..."}.
+
+    Cancelled jobs stop at their next task or stage boundary. Jobs of a
+    disconnected client are cancelled, and shutdown cancels all jobs.
+    Stage progress of jobs is dropped (clients get progress events), and
+    their warnings (ex. unknown option types) are sent as warning events.
+
+    logger: messages of the daemon itself (ex. the socket can't listen),
+            serveStdio keeps std::cout for events only, so logger needs
+            to write elsewhere then.
+*/
+class StitchDaemon {
+public:
+    StitchDaemon();
+    StitchDaemon(const int maxConcurrentJobs);
+    StitchDaemon(const int maxConcurrentJobs, const Logger& logger);
+
+    ~StitchDaemon();
+
+    // serve one client on stdin and stdout until shutdown or end of input
+    void serveStdio();
+
+    /*
+        Listen on a Unix domain socket until shutdown, each connection is
+        a client. It returns false if the socket can't listen (or Unix
+        domain sockets are not supported on the platform).
+    */
+    bool serveSocket(const std::string& socketPath);
+
+private:
+    struct Client;
+    struct Job;
+
+    // returns false for shutdown request
+    bool _handleRequest(const std::string& request, const std::shared_ptr<Client>& client);
+
+    void _cancelJobs(const std::shared_ptr<Client>& client);
+
+    // block until all queued and running jobs end
+    void _waitJobs();
+
+    void _runWorker();
+    void _runJob(Job& job) const;
+
+    void _sendEvent(const Job& job, const std::string& event, const std::string& fields = "") const;
+
+#if !defined(_WIN32)
+    void _serveClient(const std::shared_ptr<Client>& client);
+#endif
+
+    int                             _maxConcurrentJobs;
+    std::shared_ptr<WorkerPool>     _workerPool;     // shared by tasks of all jobs
+    std::shared_ptr<WarpTableCache> _warpTableCache; // shared by warppers of all jobs
+
+    std::mutex                                            _mutex;
+    std::condition_variable                               _queueCondition;
+    std::condition_variable                               _idleCondition;
+    std::deque<std::shared_ptr<Job>>                      _queue;
+    std::unordered_map<std::string, std::shared_ptr<Job>> _jobs; // queued and running jobs
+    int                                                   _numRequestedJobs;
+    std::atomic<bool>                                     _isShutdown;
+    bool                                                  _isStopped;
+    std::vector<std::thread>                              _workers;
+
+    Logger _logger;
+};
+
+} // namespace sis
\ No newline at end of file
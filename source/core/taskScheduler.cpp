@@ -0,0 +1,260 @@
+#include "core/taskScheduler.h"
+
+#include <algorithm>
+
+namespace sis {
+
+WorkerPool::WorkerPool() :
+    WorkerPool(static_cast<int>(std::thread::hardware_concurrency())) {
+}
+
+WorkerPool::WorkerPool(const int numThreads) :
+    _numThreads(std::max(numThreads, 1)),
+    _queues(),
+    _numQueuedItems(0),
+    _nextWorker(0),
+    _mutex(),
+    _condition(),
+    _isStopped(false),
+    _threads() {
+
+    for (int i = 0; i < _numThreads; ++i) {
+        _queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    _threads.reserve(_numThreads);
+    for (int i = 0; i < _numThreads; ++i) {
+        _threads.emplace_back(&WorkerPool::_runWorker, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopped = true;
+    }
+    _condition.notify_all();
+
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+}
+
+int WorkerPool::numThreads() const {
+    return _numThreads;
+}
+
+void WorkerPool::_push(const int workerIndex, const Item& item) {
+    const int queueIndex = (workerIndex >= 0) ?
+                           workerIndex : static_cast<int>(_nextWorker++ % static_cast<unsigned int>(_numThreads));
+
+    {
+        WorkerQueue& queue = *_queues[queueIndex];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.items.push_back(item);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_numQueuedItems;
+    }
+    _condition.notify_one();
+}
+
+void WorkerPool::_runWorker(const int workerIndex) {
+    while (true) {
+        Item item;
+        if (_pop(workerIndex, &item) || _steal(workerIndex, &item)) {
+            item.scheduler->_runTask(workerIndex, item.task);
+
+            continue;
+        }
+
+        /*
+            Sleep until some item is pushed or the pool stops,
+            items are counted under _mutex so no wakeup is lost
+        */
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_isStopped) {
+            return;
+        }
+
+        _condition.wait(lock, [this]() {
+            return _numQueuedItems > 0 || _isStopped;
+        });
+    }
+}
+
+bool WorkerPool::_pop(const int workerIndex, Item* const out_item) {
+    WorkerQueue& queue = *_queues[workerIndex];
+
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.items.empty()) {
+        return false;
+    }
+
+    *out_item = queue.items.back();
+    queue.items.pop_back();
+    --_numQueuedItems;
+
+    return true;
+}
+
+bool WorkerPool::_steal(const int workerIndex, Item* const out_item) {
+    for (int i = 1; i < _numThreads; ++i) {
+        WorkerQueue& queue = *_queues[(workerIndex + i) % _numThreads];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.items.empty()) {
+            continue;
+        }
+
+        *out_item = queue.items.front();
+        queue.items.pop_front();
+        --_numQueuedItems;
+
+        return true;
+    }
+
+    return false;
+}
+
+TaskScheduler::TaskScheduler() :
+    TaskScheduler(std::make_shared<WorkerPool>()) {
+}
+
+TaskScheduler::TaskScheduler(const int numThreads) :
+    TaskScheduler(std::make_shared<WorkerPool>(numThreads)) {
+}
+
+TaskScheduler::TaskScheduler(const std::shared_ptr<WorkerPool>& workerPool) :
+    _workerPool(workerPool),
+    _tasks(),
+    _timingHook(),
+    _numWaitingDependencies(),
+    _numUnfinishedTasks(0),
+    _mutex(),
+    _condition(),
+    _exception(),
+    _isFailed(false),
+    _beginTime() {
+}
+
+TaskScheduler::~TaskScheduler() = default;
+
+int TaskScheduler::addTask(
+    const std::string&           name,
+    const std::function<void()>& function,
+    const std::vector<int>&      dependencies) {
+
+    const int task = static_cast<int>(_tasks.size());
+
+    Task newTask;
+    newTask.name            = name;
+    newTask.function        = function;
+    newTask.numDependencies = static_cast<int>(dependencies.size());
+    _tasks.push_back(newTask);
+
+    for (auto& dependency : dependencies) {
+        _tasks[dependency].dependents.push_back(task);
+    }
+
+    return task;
+}
+
+void TaskScheduler::setTimingHook(const TimingHook& timingHook) {
+    _timingHook = timingHook;
+}
+
+void TaskScheduler::run() {
+    const int numTasks = static_cast<int>(_tasks.size());
+    if (numTasks == 0) {
+        return;
+    }
+
+    _numWaitingDependencies = std::make_unique<std::atomic<int>[]>(numTasks);
+    for (int task = 0; task < numTasks; ++task) {
+        _numWaitingDependencies[task] = _tasks[task].numDependencies;
+    }
+
+    _numUnfinishedTasks = numTasks;
+    _exception          = nullptr;
+    _isFailed           = false;
+    _beginTime          = std::chrono::steady_clock::now();
+
+    /*
+        Tasks without dependencies are dealt to workers in turn,
+        the others are pushed by workers finishing their last dependency
+    */
+    for (int task = 0; task < numTasks; ++task) {
+        if (_tasks[task].numDependencies == 0) {
+            _workerPool->_push(-1, { this, task });
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() {
+            return _numUnfinishedTasks == 0;
+        });
+    }
+
+    // tasks run once, the scheduler can be filled again
+    _tasks.clear();
+    _numWaitingDependencies.reset();
+
+    if (_exception) {
+        std::rethrow_exception(_exception);
+    }
+}
+
+int TaskScheduler::numThreads() const {
+    return _workerPool->numThreads();
+}
+
+void TaskScheduler::_runTask(const int workerIndex, const int task) {
+    const auto toMilliseconds = [this](const std::chrono::steady_clock::time_point& time) {
+        return std::chrono::duration<double, std::milli>(time - _beginTime).count();
+    };
+
+    const auto beginTime = std::chrono::steady_clock::now();
+
+    /*
+        Once a task throws, remaining tasks are skipped (but still
+        finished) so the graph drains, and run() rethrows it
+    */
+    if (!_isFailed) {
+        try {
+            _tasks[task].function();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_exception) {
+                _exception = std::current_exception();
+            }
+            _isFailed = true;
+        }
+    }
+
+    const auto endTime = std::chrono::steady_clock::now();
+
+    if (_timingHook) {
+        _timingHook(_tasks[task].name, workerIndex, toMilliseconds(beginTime), toMilliseconds(endTime));
+    }
+
+    for (auto& dependent : _tasks[task].dependents) {
+        if (--_numWaitingDependencies[dependent] == 0) {
+            _workerPool->_push(workerIndex, { this, dependent });
+        }
+    }
+
+    // run() may return (and the scheduler be destroyed) once the lock is released
+    std::lock_guard<std::mutex> lock(_mutex);
+    --_numUnfinishedTasks;
+    if (_numUnfinishedTasks == 0) {
+        _condition.notify_all();
+    }
+}
+
+} // namespace sis
\ No newline at end of file
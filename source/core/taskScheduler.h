@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sis {
+
+class TaskScheduler;
+
+/*
+    WorkerPool is a set of work-stealing worker threads which run tasks
+    of TaskSchedulers. Schedulers sharing one pool (ex. of concurrent
+    batch jobs) share its threads, so threads a job can't keep busy
+    run tasks of other jobs.
+
+    Each worker keeps its own queue, it runs the newest task of its
+    queue first (so dependents of a finished task run right after it,
+    while their inputs are still hot), and steals the oldest task of
+    other workers' queues when its own queue is empty.
+
+    Workers live as long as the pool. A task must not run a scheduler
+    of its own pool, since it would wait for workers it occupies.
+*/
+class WorkerPool {
+public:
+    WorkerPool();
+    WorkerPool(const int numThreads);
+
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int numThreads() const;
+
+private:
+    friend class TaskScheduler;
+
+    struct Item {
+        TaskScheduler* scheduler;
+        int            task;
+    };
+
+    struct WorkerQueue {
+        std::mutex       mutex;
+        std::deque<Item> items;
+    };
+
+    // items pushed by other threads (workerIndex = -1) are dealt to workers in turn
+    void _push(const int workerIndex, const Item& item);
+
+    void _runWorker(const int workerIndex);
+
+    bool _pop(const int workerIndex, Item* const out_item);
+    bool _steal(const int workerIndex, Item* const out_item);
+
+    int                                       _numThreads;
+    std::vector<std::unique_ptr<WorkerQueue>> _queues;
+    std::atomic<int>                          _numQueuedItems;
+    std::atomic<unsigned int>                 _nextWorker;
+    std::mutex                                _mutex;
+    std::condition_variable                   _condition;
+    bool                                      _isStopped;
+    std::vector<std::thread>                  _threads;
+};
+
+/*
+    TaskScheduler runs a graph (DAG) of tasks on a WorkerPool.
+
+    A task becomes ready once all its dependencies finish. run() returns
+    once all tasks finish. If tasks throw, the first exception is
+    rethrown from run() after the graph drains, and tasks not run yet
+    are skipped.
+
+    A scheduler constructed with a number of threads has a pool of its
+    own, otherwise it shares workerPool with other schedulers, and then
+    their graphs may run at the same time (from different threads).
+
+    timingHook: it is called by workers after each task with its name,
+                worker index and begin/end time (in milliseconds since
+                run() begins), so it needs to be thread-safe.
+*/
+class TaskScheduler {
+public:
+    using TimingHook = std::function<void(const std::string& taskName,
+                                          const int          workerIndex,
+                                          const double       beginTime,
+                                          const double       endTime)>;
+
+    TaskScheduler();
+    TaskScheduler(const int numThreads);
+    TaskScheduler(const std::shared_ptr<WorkerPool>& workerPool);
+
+    ~TaskScheduler();
+
+    // returns task id, dependencies are ids of added tasks
+    int addTask(
+        const std::string&           name,
+        const std::function<void()>& function,
+        const std::vector<int>&      dependencies = {});
+
+    void setTimingHook(const TimingHook& timingHook);
+
+    void run();
+
+    int numThreads() const;
+
+private:
+    friend class WorkerPool;
+
+    struct Task {
+        std::string           name;
+        std::function<void()> function;
+        std::vector<int>      dependents;
+        int                   numDependencies;
+    };
+
+    void _runTask(const int workerIndex, const int task);
+
+    std::shared_ptr<WorkerPool> _workerPool;
+    std::vector<Task>           _tasks;
+    TimingHook                  _timingHook;
+
+    // states while running
+    std::unique_ptr<std::atomic<int>[]>   _numWaitingDependencies;
+    int                                   _numUnfinishedTasks;
+    std::mutex                            _mutex;
+    std::condition_variable               _condition;
+    std::exception_ptr                    _exception;
+    std::atomic<bool>                     _isFailed;
+    std::chrono::steady_clock::time_point _beginTime;
+};
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "core/tiledCanvas.h"
+
+namespace sis {
+
+TiledCanvas::TiledCanvas(const cv::Size& size, const int type, const int tileSize) :
+    TiledCanvas(cv::Rect(cv::Point(0, 0), size), type, tileSize) {
+}
+
+TiledCanvas::TiledCanvas(const cv::Rect& area, const int type, const int tileSize) :
+    _size(area.size()),
+    _origin(area.tl()),
+    _type(type),
+    _tileSize(tileSize),
+    _numTilesAcross((area.width  + tileSize - 1) / tileSize),
+    _numTilesDown((area.height + tileSize - 1) / tileSize),
+    _tiles() {
+
+    // only headers are created here, tiles are allocated lazily
+    _tiles.resize(static_cast<std::size_t>(_numTilesAcross) * _numTilesDown);
+}
+
+cv::Mat& TiledCanvas::tile(const int tileX, const int tileY) {
+    cv::Mat& tile = _tiles[static_cast<std::size_t>(tileY) * _numTilesAcross + tileX];
+    if (tile.empty()) {
+        tile = cv::Mat::zeros(tileRect(tileX, tileY).size(), _type);
+    }
+
+    return tile;
+}
+
+void TiledCanvas::setTile(const int tileX, const int tileY, const cv::Mat& tile) {
+    // tile is shared, not copied
+    _tiles[static_cast<std::size_t>(tileY) * _numTilesAcross + tileX] = tile;
+}
+
+bool TiledCanvas::hasTile(const int tileX, const int tileY) const {
+    return !_tiles[static_cast<std::size_t>(tileY) * _numTilesAcross + tileX].empty();
+}
+
+cv::Rect TiledCanvas::tileRect(const int tileX, const int tileY) const {
+    /*
+        Tiles at right and bottom borders are cropped
+        to canvas size
+    */
+    const cv::Rect rect(tileX * _tileSize, tileY * _tileSize, _tileSize, _tileSize);
+
+    return rect & cv::Rect(cv::Point(0, 0), _size);
+}
+
+void TiledCanvas::releaseTiles(const int tileXBegin, const int tileXEnd) {
+    for (int tileY = 0; tileY < _numTilesDown; ++tileY) {
+        for (int tileX = tileXBegin; tileX < tileXEnd; ++tileX) {
+            _tiles[static_cast<std::size_t>(tileY) * _numTilesAcross + tileX].release();
+        }
+    }
+}
+
+void TiledCanvas::copyTo(const cv::Rect& region, cv::Mat* const out_image) const {
+    cv::Mat image = cv::Mat::zeros(region.size(), _type);
+
+    const int tileXBegin = region.x / _tileSize;
+    const int tileXEnd   = (region.x + region.width  + _tileSize - 1) / _tileSize;
+    const int tileYBegin = region.y / _tileSize;
+    const int tileYEnd   = (region.y + region.height + _tileSize - 1) / _tileSize;
+    for (int tileY = tileYBegin; tileY < tileYEnd; ++tileY) {
+        for (int tileX = tileXBegin; tileX < tileXEnd; ++tileX) {
+            if (!hasTile(tileX, tileY)) {
+                continue;
+            }
+
+            const cv::Rect rect    = tileRect(tileX, tileY);
+            const cv::Rect overlap = rect & region;
+            if (overlap.area() == 0) {
+                continue;
+            }
+
+            const cv::Mat& tile = _tiles[static_cast<std::size_t>(tileY) * _numTilesAcross + tileX];
+            tile(cv::Rect(overlap.tl() - rect.tl(), overlap.size()))
+                .copyTo(image(cv::Rect(overlap.tl() - region.tl(), overlap.size())));
+        }
+    }
+
+    *out_image = image;
+}
+
+void TiledCanvas::toMat(cv::Mat* const out_image) const {
+    copyTo(cv::Rect(cv::Point(0, 0), _size), out_image);
+}
+
+const cv::Size& TiledCanvas::size() const {
+    return _size;
+}
+
+const cv::Point& TiledCanvas::origin() const {
+    return _origin;
+}
+
+int TiledCanvas::tileSize() const {
+    return _tileSize;
+}
+
+int TiledCanvas::numTilesAcross() const {
+    return _numTilesAcross;
+}
+
+int TiledCanvas::numTilesDown() const {
+    return _numTilesDown;
+}
+
+std::size_t TiledCanvas::allocatedBytes() const {
+    std::size_t bytes = 0;
+    for (auto& tile : _tiles) {
+        if (!tile.empty()) {
+            bytes += tile.total() * tile.elemSize();
+        }
+    }
+
+    return bytes;
+}
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace sis {
+
+/*
+    TiledCanvas is a virtual panorama canvas split into square tiles.
+
+    Tiles are allocated (and zeroed) lazily on first access, so regions
+    no image lands on (ex. black padding caused by vertical drifting)
+    cost no memory. Tiles are independent, different tiles can be
+    accessed and written concurrently, but one tile can't be accessed
+    by multiple threads at the same time.
+
+    Unallocated tiles are treated as zeros when exporting.
+
+    The canvas may cover only a part (area) of the panorama, tile
+    rects are in canvas coordinate, and origin is where the canvas
+    begins on the panorama.
+*/
+class TiledCanvas {
+public:
+    TiledCanvas(const cv::Size& size, const int type, const int tileSize);
+    TiledCanvas(const cv::Rect& area, const int type, const int tileSize);
+
+    cv::Mat& tile(const int tileX, const int tileY);
+    void     setTile(const int tileX, const int tileY, const cv::Mat& tile);
+    bool     hasTile(const int tileX, const int tileY) const;
+    cv::Rect tileRect(const int tileX, const int tileY) const;
+
+    void releaseTiles(const int tileXBegin, const int tileXEnd);
+
+    void copyTo(const cv::Rect& region, cv::Mat* const out_image) const;
+    void toMat(cv::Mat* const out_image) const;
+
+    const cv::Size&  size() const;
+    const cv::Point& origin() const;
+    int tileSize() const;
+    int numTilesAcross() const;
+    int numTilesDown() const;
+    std::size_t allocatedBytes() const;
+
+private:
+    cv::Size  _size;
+    cv::Point _origin;
+    int       _type;
+    int       _tileSize;
+    int       _numTilesAcross;
+    int       _numTilesDown;
+
+    // tiles in row-major order, empty cv::Mat means unallocated
+    std::vector<cv::Mat> _tiles;
+};
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "core/warpTableCache.h"
+
+namespace sis {
+
+WarpTableCache::WarpTableCache() :
+    _mutex(),
+    _tables(),
+    _tableKeys() {
+}
+
+std::shared_ptr<const WarpTableCache::Table> WarpTableCache::find(
+    const cv::Size&   imageSize,
+    const float       focalLength,
+    const Calculator& calculate) {
+
+    const TableKey key(imageSize.width, imageSize.height, focalLength);
+
+    // tables are O(width), calculating one under the lock is cheap
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const auto& cachedTable = _tables.find(key);
+    if (cachedTable != _tables.end()) {
+        return cachedTable->second;
+    }
+
+    auto table = std::make_shared<Table>();
+    calculate(table.get());
+
+    if (_tableKeys.size() >= MAX_NUM_TABLES) {
+        _tables.erase(_tableKeys.front());
+        _tableKeys.pop_front();
+    }
+    _tables[key] = table;
+    _tableKeys.push_back(key);
+
+    return table;
+}
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <tuple>
+#include <vector>
+
+namespace sis {
+
+/*
+    WarpTableCache keeps inverse warp tables by (image size, focal
+    length), so warppers sharing it (ex. jobs of daemon mode) calculate
+    them once for all images of the same camera. It is thread-safe,
+    warppers running concurrently on different images share one cache.
+
+    Tables are immutable once calculated. At most MAX_NUM_TABLES tables
+    are kept, the oldest one is dropped first, a warpper still using it
+    keeps it alive.
+*/
+class WarpTableCache {
+public:
+    /*
+        Inverse warp of each warpped column, the original coordinate
+        of warpped pixel (x', y') is (xOriginals[x'], yScales[x'] * y')
+        with y' from the warpped image center
+    */
+    struct Table {
+        std::vector<float> xOriginals;
+        std::vector<float> yScales;
+    };
+
+    using Calculator = std::function<void(Table* const out_table)>;
+
+    WarpTableCache();
+
+    // the cached table, calculate is only called on a miss
+    std::shared_ptr<const Table> find(
+        const cv::Size&   imageSize,
+        const float       focalLength,
+        const Calculator& calculate);
+
+private:
+    // (width, height, focalLength)
+    using TableKey = std::tuple<int, int, float>;
+
+    mutable std::mutex                               _mutex;
+    std::map<TableKey, std::shared_ptr<const Table>> _tables;
+    std::deque<TableKey>                             _tableKeys; // oldest first
+
+    static constexpr std::size_t MAX_NUM_TABLES = 64;
+};
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "exposureCompensator/gainExposureCompensator.h"
+
+#include <cmath>
+#include <iostream>
+
+namespace sis {
+
+GainExposureCompensator::GainExposureCompensator() :
+    GainExposureCompensator(10.0f, 0.1f) {
+}
+
+GainExposureCompensator::GainExposureCompensator(const float sigmaIntensity, const float sigmaGain) :
+    _sigmaIntensity(sigmaIntensity),
+    _sigmaGain(sigmaGain) {
+}
+
+void GainExposureCompensator::_compensateImpl(
+    const std::vector<cv::Mat>&        images,
+    const std::vector<ImageAlignment>& imageAlignments,
+    const std::vector<cv::Mat>&        warpImageIndices,
+    std::vector<float>* const          out_imageGains) const {
+
+    _log().progress() << "# Begin to compensate exposure using gains"
+                      << std::endl;
+
+    const int numImages = static_cast<int>(images.size());
+
+    /*
+        Minimize error over each image pair (i, j)
+
+        e = sum N_ij * ((g_i * I_ij - g_j * I_ji)^2 / sigmaN^2 + (1 - g_i)^2 / sigmaG^2)
+
+        N_ij: number of overlapping pixels
+        I_ij: mean intensity of image i in overlapping region
+
+        The second term keeps gains near 1, otherwise
+        all gains being 0 would be the optimal solution.
+        Setting de/dg = 0 gives a small linear system A * g = b.
+    */
+    const double invSigmaN2 = 1.0 / (static_cast<double>(_sigmaIntensity) * _sigmaIntensity);
+    const double invSigmaG2 = 1.0 / (static_cast<double>(_sigmaGain) * _sigmaGain);
+
+    cv::Mat A = cv::Mat::zeros(numImages, numImages, CV_64FC1);
+    cv::Mat b = cv::Mat::zeros(numImages, 1, CV_64FC1);
+
+    // images without any overlap still keep gain 1
+    for (int i = 0; i < numImages; ++i) {
+        A.at<double>(i, i) += invSigmaG2;
+        b.at<double>(i, 0) += invSigmaG2;
+    }
+
+    for (int i = 0; i < numImages - 1; ++i) {
+        const int j = i + 1;
+
+        const cv::Point offset = cv::Point(images[i].cols, 0) + imageAlignments[i].translation;
+
+        float meanI;
+        float meanJ;
+        int   numPixels;
+        _calculateOverlapMeans(images[i], warpImageIndices[i],
+                               images[j], warpImageIndices[j],
+                               offset, &meanI, &meanJ, &numPixels);
+        if (numPixels == 0) {
+            continue;
+        }
+
+        const double N = static_cast<double>(numPixels);
+        A.at<double>(i, i) += N * (2.0 * meanI * meanI * invSigmaN2 + invSigmaG2);
+        A.at<double>(j, j) += N * (2.0 * meanJ * meanJ * invSigmaN2 + invSigmaG2);
+        A.at<double>(i, j) -= N * 2.0 * meanI * meanJ * invSigmaN2;
+        A.at<double>(j, i) -= N * 2.0 * meanI * meanJ * invSigmaN2;
+        b.at<double>(i, 0) += N * invSigmaG2;
+        b.at<double>(j, 0) += N * invSigmaG2;
+    }
+
+    /*
+        A is positive definite in theory, but if it can't be solved
+        (ex. singular) or gives unusable gains, keep all gains at 1
+    */
+    cv::Mat gains;
+    bool    isSolved = cv::solve(A, b, gains, cv::DECOMP_CHOLESKY);
+    for (int i = 0; isSolved && i < numImages; ++i) {
+        const double gain = gains.at<double>(i, 0);
+        isSolved = std::isfinite(gain) && gain > 0.0;
+    }
+
+    if (!isSolved) {
+        _log().warning() << "# Exposure gains can't be solved, use <1> for all images"
+                         << std::endl;
+
+        gains = cv::Mat::ones(numImages, 1, CV_64FC1);
+    }
+
+    out_imageGains->resize(numImages);
+    for (int i = 0; i < numImages; ++i) {
+        (*out_imageGains)[i] = static_cast<float>(gains.at<double>(i, 0));
+
+        _log().progress() << "    Image " << (i + 1) << " gain: " << (*out_imageGains)[i]
+                          << std::endl;
+    }
+
+    _log().progress() << "# Finish exposure compensation"
+                      << std::endl;
+}
+
+void GainExposureCompensator::_calculateOverlapMeans(
+    const cv::Mat&   image1,
+    const cv::Mat&   imageIndex1,
+    const cv::Mat&   image2,
+    const cv::Mat&   imageIndex2,
+    const cv::Point& offset,
+    float* const     out_mean1,
+    float* const     out_mean2,
+    int* const       out_numPixels) const {
+
+    /*
+        offset is where image2 is placed in image1's coordinate,
+        only pixels valid in both images are counted
+    */
+    const cv::Rect overlap = cv::Rect(cv::Point(0, 0), image1.size()) &
+                             cv::Rect(offset, image2.size());
+
+    double sum1      = 0.0;
+    double sum2      = 0.0;
+    int    numPixels = 0;
+    for (int y = overlap.y; y < overlap.y + overlap.height; ++y) {
+        const uchar* row1      = image1.ptr<uchar>(y);
+        const uchar* row2      = image2.ptr<uchar>(y - offset.y);
+        const float* indexRow1 = imageIndex1.ptr<float>(y);
+        const float* indexRow2 = imageIndex2.ptr<float>(y - offset.y);
+
+        for (int x = overlap.x; x < overlap.x + overlap.width; ++x) {
+            const int x2 = x - offset.x;
+            if (indexRow1[x] <= 0.0f || indexRow2[x2] <= 0.0f) {
+                continue;
+            }
+
+            sum1 += (row1[3 * x]  + row1[3 * x + 1]  + row1[3 * x + 2])  / 3.0;
+            sum2 += (row2[3 * x2] + row2[3 * x2 + 1] + row2[3 * x2 + 2]) / 3.0;
+            ++numPixels;
+        }
+    }
+
+    *out_mean1     = (numPixels > 0) ? static_cast<float>(sum1 / numPixels) : 0.0f;
+    *out_mean2     = (numPixels > 0) ? static_cast<float>(sum2 / numPixels) : 0.0f;
+    *out_numPixels = numPixels;
+}
+
+} // namespace sis
\ No newline at end of file
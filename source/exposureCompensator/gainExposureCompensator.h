@@ -0,0 +1,42 @@
+#pragma once
+
+#include "core/exposureCompensator.h"
+
+namespace sis {
+
+/*
+    GainExposureCompensator: one gain per image, it is solved from mean
+                             intensities of overlapping regions between
+                             image pairs by linear least squares.
+
+    Reference: Automatic Panoramic Image Stitching using Invariant Features,
+               M. Brown and D. G. Lowe, IJCV 2007
+*/
+class GainExposureCompensator : public ExposureCompensator {
+public:
+    GainExposureCompensator();
+    GainExposureCompensator(const float sigmaIntensity, const float sigmaGain);
+
+private:
+    void _compensateImpl(
+        const std::vector<cv::Mat>&        images,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        std::vector<float>* const          out_imageGains) const override;
+
+    void _calculateOverlapMeans(
+        const cv::Mat&   image1,
+        const cv::Mat&   imageIndex1,
+        const cv::Mat&   image2,
+        const cv::Mat&   imageIndex2,
+        const cv::Point& offset,
+        float* const     out_mean1,
+        float* const     out_mean2,
+        int* const       out_numPixels) const;
+
+    // standard deviation of intensity error and gain
+    float _sigmaIntensity;
+    float _sigmaGain;
+};
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <opencv2/opencv.hpp>
+
+namespace sis {
+
+/*
+    Kernels of SIFT feature descriptor with fixed orientation bins and
+    cell grid, so their loops have constant trip counts (unrolled and
+    vectorized by the compiler) and descriptors are fixed-size arrays.
+
+    NUM_ORIENTATIONS: orientation bins of each cell histogram
+    NUM_CELLS       : cells of each side of the descriptor window
+    CELL_SIZE       : pixels of each side of a cell
+
+    Ex. SiftDescriptorKernel<8, 4, 4> has 16x16 window and
+        8 x 4 x 4 = 128-dimensional descriptors
+*/
+template<int NUM_ORIENTATIONS, int NUM_CELLS, int CELL_SIZE>
+class SiftDescriptorKernel {
+public:
+    static constexpr int DIMENSION   = NUM_ORIENTATIONS * NUM_CELLS * NUM_CELLS;
+    static constexpr int WINDOW_SIZE = NUM_CELLS * CELL_SIZE;
+
+    using Descriptor = std::array<float, DIMENSION>;
+
+    /*
+        Index of the largest of NUM_BINS orientation maps at each pixel,
+        the first one for ties (0 if all values are 0)
+    */
+    template<int NUM_BINS>
+    static void findMainOrientations(
+        const cv::Mat* const orientations,
+        cv::Mat* const       out_mainOrientation);
+
+    /*
+        Descriptor of the window centered at (x, y), mainOrientation
+        stores un-rotated bins, so rotateBin is subtracted from them
+        to get local bins. Each cell histogram is clipped at 0.2 and
+        then normalized.
+    */
+    static void calculate(
+        const cv::Mat&    mainOrientation,
+        const int         x,
+        const int         y,
+        const int         rotateBin,
+        Descriptor* const out_descriptor);
+};
+
+// header implementation
+
+template<int NUM_ORIENTATIONS, int NUM_CELLS, int CELL_SIZE>
+template<int NUM_BINS>
+inline void SiftDescriptorKernel<NUM_ORIENTATIONS, NUM_CELLS, CELL_SIZE>::findMainOrientations(
+    const cv::Mat* const orientations,
+    cv::Mat* const       out_mainOrientation) {
+
+    const int width  = orientations[0].cols;
+    const int height = orientations[0].rows;
+
+    std::array<const float*, NUM_BINS> orientationRows;
+    for (int iy = 0; iy < height; ++iy) {
+        for (int bin = 0; bin < NUM_BINS; ++bin) {
+            orientationRows[bin] = orientations[bin].ptr<float>(iy);
+        }
+        uchar* mainOrientationRow = out_mainOrientation->ptr<uchar>(iy);
+
+        for (int ix = 0; ix < width; ++ix) {
+            float maxOrientationValue = 0.0f;
+            int   maxOrientationIndex = 0;
+            for (int bin = 0; bin < NUM_BINS; ++bin) {
+                const float value = orientationRows[bin][ix];
+                if (value > maxOrientationValue) {
+                    maxOrientationValue = value;
+                    maxOrientationIndex = bin;
+                }
+            }
+
+            mainOrientationRow[ix] = static_cast<uchar>(maxOrientationIndex);
+        }
+    }
+}
+
+template<int NUM_ORIENTATIONS, int NUM_CELLS, int CELL_SIZE>
+inline void SiftDescriptorKernel<NUM_ORIENTATIONS, NUM_CELLS, CELL_SIZE>::calculate(
+    const cv::Mat&    mainOrientation,
+    const int         x,
+    const int         y,
+    const int         rotateBin,
+    Descriptor* const out_descriptor) {
+
+    Descriptor& descriptor = *out_descriptor;
+
+    for (int cy = 0; cy < NUM_CELLS; ++cy) {
+        for (int cx = 0; cx < NUM_CELLS; ++cx) {
+            /*
+                Pixels are counted per bin and divided once, each bin is
+                the correctly rounded count / CELL_SIZE^2 whatever order
+                pixels come in (for 4x4 cells it is exact, the same as
+                summing 1/16 per pixel)
+            */
+            std::array<int, NUM_ORIENTATIONS> binCounts = {};
+
+            const int beginX = x - WINDOW_SIZE / 2 + cx * CELL_SIZE;
+            const int beginY = y - WINDOW_SIZE / 2 + cy * CELL_SIZE;
+            for (int iy = beginY; iy < beginY + CELL_SIZE; ++iy) {
+                const uchar* mainOrientationRow = mainOrientation.ptr<uchar>(iy);
+
+                for (int ix = beginX; ix < beginX + CELL_SIZE; ++ix) {
+                    const int bin = (mainOrientationRow[ix] - rotateBin + NUM_ORIENTATIONS) % NUM_ORIENTATIONS;
+                    ++binCounts[bin];
+                }
+            }
+
+            std::array<float, NUM_ORIENTATIONS> histogram;
+            for (int i = 0; i < NUM_ORIENTATIONS; ++i) {
+                histogram[i] = static_cast<float>(binCounts[i]) / (CELL_SIZE * CELL_SIZE);
+            }
+
+            float sumHistogram = 0.0f;
+            for (int i = 0; i < NUM_ORIENTATIONS; ++i) {
+                if (histogram[i] > 0.2f) {
+                    histogram[i] = 0.2f;
+                }
+
+                sumHistogram += histogram[i];
+            }
+
+            float* const cellDescriptor = descriptor.data() + (cy * NUM_CELLS + cx) * NUM_ORIENTATIONS;
+            for (int i = 0; i < NUM_ORIENTATIONS; ++i) {
+                cellDescriptor[i] = histogram[i] / sumHistogram;
+            }
+        }
+    }
+}
+
+} // namespace sis
\ No newline at end of file
@@ -6,17 +6,23 @@
 
 namespace sis {
 
-SiftFeatureDescriptor::SiftFeatureDescriptor() = default;
+SiftFeatureDescriptor::SiftFeatureDescriptor() :
+    SiftFeatureDescriptor(std::make_shared<BufferPool>()) {
+}
+
+SiftFeatureDescriptor::SiftFeatureDescriptor(const std::shared_ptr<BufferPool>& bufferPool) :
+    _bufferPool(bufferPool) {
+}
 
-void SiftFeatureDescriptor::calculate(
+void SiftFeatureDescriptor::_calculateImpl(
     const std::vector<cv::Mat>&                         images,
     const std::vector<std::vector<cv::Point>>&          featurePositions,
     std::vector<std::vector<std::vector<float>>>* const out_featureDescriptors) const {
 
-    std::cout << "# Begin to calculate descriptor vector using SIFT feature descriptor"
-              << std::endl
-              << "\r    Progress of calculating feature descriptors: 0/" << images.size()
-              << std::flush;
+    _log().progress() << "# Begin to calculate descriptor vector using SIFT feature descriptor"
+                      << std::endl
+                      << "\r    Progress of calculating feature descriptors: 0/" << images.size()
+                      << std::flush;
 
     const int numImages = static_cast<int>(images.size());
     out_featureDescriptors->reserve(numImages);
@@ -40,49 +46,65 @@ void SiftFeatureDescriptor::calculate(
         |  / | \  |  / | \  |
         +---------+---------+
     */
-    const float binSize = 360.0f / mathUtils::BIN_NUMBER;
+    const float binSize           = 360.0f / mathUtils::BIN_NUMBER;
+    const float descriptorBinSize = 360.0f / NUM_DESCRIPTOR_ORIENTATIONS;
     for (int n = 0; n < numImages; ++n) {
+        /*
+            Intermediate images of the same size are recycled,
+            they go back to the pool at the end of each image
+        */
+        BufferPool::Scope buffers(_bufferPool.get());
+
+        const cv::Size size = images[n].size();
+
         /*
             Change image to gray scale
         */
-        cv::Mat image;
-        cv::cvtColor(images[n], image, cv::COLOR_BGR2GRAY);
-        image.convertTo(image, CV_32FC1);
+        cv::Mat& grayImage = buffers.acquire(size, CV_8UC1);
+        cv::Mat& image     = buffers.acquire(size, CV_32FC1);
+        cv::cvtColor(images[n], grayImage, cv::COLOR_BGR2GRAY);
+        grayImage.convertTo(image, CV_32FC1);
 
         /*
             Compute x and y derivatives of smooth image
         */
-        cv::Mat translationMatrix;
-        cv::Mat smoothImage;
+        cv::Mat  translationMatrix;
+        cv::Mat& smoothImage = buffers.acquire(size, CV_32FC1);
         cv::GaussianBlur(image, smoothImage, cv::Size(5, 5), 3);
 
-        cv::Mat rightImage;
+        cv::Mat& rightImage = buffers.acquire(size, CV_32FC1);
         mathUtils::getTranslationMatrix(-1, 0, &translationMatrix);
         cv::warpAffine(smoothImage, rightImage, translationMatrix, smoothImage.size());
 
-        cv::Mat leftImage;
+        cv::Mat& leftImage = buffers.acquire(size, CV_32FC1);
         mathUtils::getTranslationMatrix(1, 0, &translationMatrix);
         cv::warpAffine(smoothImage, leftImage, translationMatrix, smoothImage.size());
 
-        cv::Mat upImage;
+        cv::Mat& upImage = buffers.acquire(size, CV_32FC1);
         mathUtils::getTranslationMatrix(0, 1, &translationMatrix);
         cv::warpAffine(smoothImage, upImage, translationMatrix, smoothImage.size());
 
-        cv::Mat downImage;
+        cv::Mat& downImage = buffers.acquire(size, CV_32FC1);
         mathUtils::getTranslationMatrix(0, -1, &translationMatrix);
         cv::warpAffine(smoothImage, downImage, translationMatrix, smoothImage.size());
 
-        const cv::Mat Ix = (rightImage - leftImage) * 0.5f;
-        const cv::Mat Iy = (downImage - upImage) * 0.5f;
+        // assigned (not constructed), so expressions are written into pooled buffers
+        cv::Mat& Ix = buffers.acquire(size, CV_32FC1);
+        cv::Mat& Iy = buffers.acquire(size, CV_32FC1);
+        Ix = (rightImage - leftImage) * 0.5f;
+        Iy = (downImage - upImage) * 0.5f;
 
         /*
             Compute products of derivatives at every pixel
         */
-        const cv::Mat Ix2 = Ix.mul(Ix); 
-        const cv::Mat Iy2 = Iy.mul(Iy);
+        cv::Mat& Ix2 = buffers.acquire(size, CV_32FC1);
+        cv::Mat& Iy2 = buffers.acquire(size, CV_32FC1);
+        Ix2 = Ix.mul(Ix);
+        Iy2 = Iy.mul(Iy);
 
-        cv::Mat magnitude;
-        cv::pow(Ix2 + Iy2, 0.5f, magnitude);
+        cv::Mat& magnitude = buffers.acquire(size, CV_32FC1);
+        cv::add(Ix2, Iy2, magnitude);
+        cv::pow(magnitude, 0.5f, magnitude);
 
         /*
             For each bin, build its index map
@@ -90,8 +112,9 @@ void SiftFeatureDescriptor::calculate(
         cv::Mat binIndex[mathUtils::BIN_NUMBER];
         cv::Mat orientation[mathUtils::BIN_NUMBER];
         for (int i = 0; i < mathUtils::BIN_NUMBER; ++i) {
-            binIndex[i]    = cv::Mat::zeros(image.size(), CV_32FC1);
-            orientation[i] = cv::Mat::zeros(image.size(), CV_32FC1);
+            binIndex[i]    = buffers.acquire(size, CV_32FC1);
+            orientation[i] = buffers.acquire(size, CV_32FC1);
+            binIndex[i].setTo(0.0f);
         }
         
         /*
@@ -100,11 +123,12 @@ void SiftFeatureDescriptor::calculate(
             also need to build alternative descriptorBinIndex
             and descriptorOrientation
         */
-        cv::Mat descriptorBinIndex[8];
-        cv::Mat descriptorOrientation[8];
-        for (int i = 0; i < 8; ++i) {
-            descriptorBinIndex[i]    = cv::Mat::zeros(image.size(), CV_32FC1);
-            descriptorOrientation[i] = cv::Mat::zeros(image.size(), CV_32FC1);
+        cv::Mat descriptorBinIndex[NUM_DESCRIPTOR_ORIENTATIONS];
+        cv::Mat descriptorOrientation[NUM_DESCRIPTOR_ORIENTATIONS];
+        for (int i = 0; i < NUM_DESCRIPTOR_ORIENTATIONS; ++i) {
+            descriptorBinIndex[i]    = buffers.acquire(size, CV_32FC1);
+            descriptorOrientation[i] = buffers.acquire(size, CV_32FC1);
+            descriptorBinIndex[i].setTo(0.0f);
         }
 
         /*
@@ -124,7 +148,8 @@ void SiftFeatureDescriptor::calculate(
                 const int bin = static_cast<int>((theta + 0.5f * binSize) / binSize) % mathUtils::BIN_NUMBER;
                 binIndex[bin].at<float>(iy, ix) = 1.0f;
 
-                const int descriptorBin = static_cast<int>((theta + 0.5f * 45.0f) / 45.0f) % 8;
+                const int descriptorBin =
+                    static_cast<int>((theta + 0.5f * descriptorBinSize) / descriptorBinSize) % NUM_DESCRIPTOR_ORIENTATIONS;
                 descriptorBinIndex[descriptorBin].at<float>(iy, ix) = 1.0f;
             }
         }
@@ -137,7 +162,7 @@ void SiftFeatureDescriptor::calculate(
             cv::GaussianBlur(binIndex[bin], orientation[bin], cv::Size(7, 7), 3);
             orientation[bin] = orientation[bin].mul(magnitude);
         }
-        for (int bin = 0; bin < 8; ++bin) {
+        for (int bin = 0; bin < NUM_DESCRIPTOR_ORIENTATIONS; ++bin) {
             cv::GaussianBlur(descriptorBinIndex[bin], descriptorOrientation[bin], cv::Size(7, 7), 3);
             descriptorOrientation[bin] = descriptorOrientation[bin].mul(magnitude);
         }
@@ -148,127 +173,52 @@ void SiftFeatureDescriptor::calculate(
             mainOrientation: the main orientation index with 
                              the largest orientation value of a pixel
         */
-        cv::Mat mainOrientation           = cv::Mat::zeros(image.size(), CV_8UC1);
-        cv::Mat descriptorMainOrientation = cv::Mat::zeros(image.size(), CV_8UC1);
-        for (int iy = 0; iy < height; ++iy) {
-            for (int ix = 0; ix < width; ++ix) {
-                /*
-                    Find main orientation from BIN_NUMBER orientations,
-                    and then add in orientation vector
-                */
-                float maxOrientationValue = 0.0f;
-                int   maxOrientationIndex = 0;
-
-                for (int bin = 0; bin < mathUtils::BIN_NUMBER; ++bin) {
-                    const float value = orientation[bin].at<float>(iy, ix);
-                    if (value > maxOrientationValue) {
-                        maxOrientationValue = value;
-                        maxOrientationIndex = bin;
-                    }
-                }
-                mainOrientation.at<uchar>(iy, ix) = maxOrientationIndex;
-
-                /*
-                    Find main orientation from 8 orientations,
-                    and then add in descriptor orientation vector
-                */
-                maxOrientationValue = 0.0f;
-                maxOrientationIndex = 0;
-                for (int bin = 0; bin < 8; ++bin) {
-                    const float value = descriptorOrientation[bin].at<float>(iy, ix);
-                    if (value > maxOrientationValue) {
-                        maxOrientationValue = value;
-                        maxOrientationIndex = bin;
-                    }
-                }
-                descriptorMainOrientation.at<uchar>(iy, ix) = maxOrientationIndex;
-            }
-        }
+        cv::Mat& mainOrientation           = buffers.acquire(size, CV_8UC1);
+        cv::Mat& descriptorMainOrientation = buffers.acquire(size, CV_8UC1);
+        Kernel::findMainOrientations<mathUtils::BIN_NUMBER>(orientation, &mainOrientation);
+        Kernel::findMainOrientations<NUM_DESCRIPTOR_ORIENTATIONS>(descriptorOrientation, &descriptorMainOrientation);
 
         /*
             For each feature point, calculate its local descriptor
             based on its main orientation
         */
         std::vector<std::vector<float>> descriptors;
+        descriptors.reserve(featurePositions[n].size());
+
+        Kernel::Descriptor descriptor;
+        cv::Mat&           rotationDescriptorMainOrientation = buffers.acquire(size, CV_8UC1);
         for (auto& pos : featurePositions[n]) {
             const int   x     = pos.x;
             const int   y     = pos.y;
             const float angle = static_cast<float>(mainOrientation.at<uchar>(y, x)) * binSize;
 
 
-            const int descriptorRotateBin = (angle < 22.5f) ?
-                                            0 : 1 + static_cast<int>(angle - 22.5f) / 45;
+            const int descriptorRotateBin = (angle < 0.5f * descriptorBinSize) ?
+                                            0 : 1 + static_cast<int>(angle - 0.5f * descriptorBinSize)
+                                                    / static_cast<int>(descriptorBinSize);
 
             const cv::Point2i point(x, y);
             const cv::Mat rotationMatrix = cv::getRotationMatrix2D(cv::Point2f(point), -angle, 1);
-            cv::Mat rotationDescriptorMainOrientation;
             cv::warpAffine(descriptorMainOrientation, rotationDescriptorMainOrientation, rotationMatrix, image.size());
 
             /*
                 There are 16 4x4 size local pixels
                 needed to calculate 8-orientation histogram
             */
-            std::vector<float> descriptor;
-            descriptor.reserve(16 * 8);
-
-            const int offsetX[4] = { -8, -4, 0, 4 };
-            const int offsetY[4] = { -8, -4, 0, 4 };
-            for (auto& yo : offsetY) {
-                for (auto& xo : offsetX) {
-                    /*
-                        For each 4x4 size, calculate its 8-orientation histogram
-                    */
-                    float orientationHistogram[8] = { 0.0f };
-
-                    const int beginX = x + xo;
-                    const int beginY = y + yo;
-                    for (int iy = beginY; iy < beginY + 4; ++iy) {
-                        for (int ix = beginX; ix < beginX + 4; ++ix) {
-                            int mainBin = rotationDescriptorMainOrientation.at<uchar>(iy, ix);
-
-                            // rotationDescriptorMainOrientation stores un-rotated bin,
-                            // so we need to subtract descriptorRotateBin so that
-                            // mainBin would be local bin
-                            mainBin -= descriptorRotateBin;
-                            mainBin  = (mainBin + 8) % 8;
-
-                            orientationHistogram[mainBin] += 1.0f / 16.0f;
-                        }
-                    }
-
-                    /*
-                        Clip valus larger than 0.2, and then normalize
-
-                        At last, push_back to descriptor
-                    */
-                    float sumHistogram = 0.0f;
-                    for (int i = 0; i < 8; ++i) {
-                        if (orientationHistogram[i] > 0.2f) {
-                            orientationHistogram[i] = 0.2f;
-                        }
-
-                        sumHistogram += orientationHistogram[i];
-                    }
-
-                    for (int i = 0; i < 8; ++i) {
-                        orientationHistogram[i] /= sumHistogram;
-                        descriptor.push_back(orientationHistogram[i]);
-                    }
-                }
-            }
+            Kernel::calculate(rotationDescriptorMainOrientation, x, y, descriptorRotateBin, &descriptor);
 
-            descriptors.push_back(descriptor);
+            descriptors.emplace_back(descriptor.begin(), descriptor.end());
         }
 
         out_featureDescriptors->push_back(descriptors);
 
-        std::cout << "\r    Progress of calculating feature descriptors: " << (n + 1) << "/" << numImages
-                  << std::flush;
+        _log().progress() << "\r    Progress of calculating feature descriptors: " << (n + 1) << "/" << numImages
+                          << std::flush;
     }
 
-    std::cout << std::endl
-              << "# Finish calculating feature descriptors"
-              << std::endl;
+    _log().progress() << std::endl
+                      << "# Finish calculating feature descriptors"
+                      << std::endl;
 }
 
 } // namespace sis
\ No newline at end of file
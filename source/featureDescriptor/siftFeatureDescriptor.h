@@ -1,6 +1,10 @@
 #pragma once
 
+#include "core/bufferPool.h"
 #include "core/featureDescriptor.h"
+#include "featureDescriptor/siftDescriptorKernel.h"
+
+#include <memory>
 
 namespace sis {
 
@@ -13,12 +17,27 @@ namespace sis {
 */
 class SiftFeatureDescriptor : public FeatureDescriptor {
 public:
+    /*
+        8 orientations for each of 4x4 cells of 4x4 pixels,
+        total 8 x 4 x 4 = 128-dimensional descriptors
+    */
+    static constexpr int NUM_DESCRIPTOR_ORIENTATIONS = 8;
+
+    using Kernel = SiftDescriptorKernel<NUM_DESCRIPTOR_ORIENTATIONS, 4, 4>;
+
+    static constexpr int DIMENSION = Kernel::DIMENSION;
+
     SiftFeatureDescriptor();
+    SiftFeatureDescriptor(const std::shared_ptr<BufferPool>& bufferPool);
 
-    void calculate(
+private:
+    void _calculateImpl(
         const std::vector<cv::Mat>&                         images,
         const std::vector<std::vector<cv::Point>>&          featurePositions,
         std::vector<std::vector<std::vector<float>>>* const out_featureDescriptors) const override;
+
+    // per-image intermediate images are recycled through it
+    std::shared_ptr<BufferPool> _bufferPool;
 };
 
 } // namespace sis
\ No newline at end of file
@@ -7,22 +7,33 @@
 namespace sis {
 
 HarrisFeatureDetector::HarrisFeatureDetector() :
-    HarrisFeatureDetector(0.04f, 4000.0f) {
+    HarrisFeatureDetector(std::make_shared<BufferPool>()) {
+}
+
+HarrisFeatureDetector::HarrisFeatureDetector(const std::shared_ptr<BufferPool>& bufferPool) :
+    HarrisFeatureDetector(0.04f, 4000.0f, bufferPool) {
 }
 
 HarrisFeatureDetector::HarrisFeatureDetector(const float k, const float threshold) :
+    HarrisFeatureDetector(k, threshold, std::make_shared<BufferPool>()) {
+}
+
+HarrisFeatureDetector::HarrisFeatureDetector(const float                        k,
+                                             const float                        threshold,
+                                             const std::shared_ptr<BufferPool>& bufferPool) :
     _k(k),
-    _threshold(threshold) {
+    _threshold(threshold),
+    _bufferPool(bufferPool) {
 }
 
 void HarrisFeatureDetector::_detectImpl(
     const std::vector<cv::Mat>&                images,
     std::vector<std::vector<cv::Point>>* const out_featurePositions) const {
 
-    std::cout << "# Begin to detect features using Harris corner detector"
-              << std::endl
-              << "\r    Progress of feature detection: 0/" << images.size()
-              << std::flush;
+    _log().progress() << "# Begin to detect features using Harris corner detector"
+                      << std::endl
+                      << "\r    Progress of feature detection: 0/" << images.size()
+                      << std::flush;
        
     const int numImages = static_cast<int>(images.size());
     out_featurePositions->reserve(numImages);
@@ -34,55 +45,70 @@ void HarrisFeatureDetector::_detectImpl(
     */
     int numAllFeatures = 0;
     for (int n = 0; n < numImages; ++n) {
+        /*
+            Intermediate images of the same size are recycled,
+            they go back to the pool at the end of each image
+        */
+        BufferPool::Scope buffers(_bufferPool.get());
+
+        const cv::Size size = images[n].size();
+
         /*
             Change image to gray scale
         */
-        cv::Mat image;
-        cv::cvtColor(images[n], image, cv::COLOR_BGR2GRAY);
-        image.convertTo(image, CV_32FC1);
+        cv::Mat& grayImage = buffers.acquire(size, CV_8UC1);
+        cv::Mat& image     = buffers.acquire(size, CV_32FC1);
+        cv::cvtColor(images[n], grayImage, cv::COLOR_BGR2GRAY);
+        grayImage.convertTo(image, CV_32FC1);
 
         /*
             Step 1
             Compute x and y derivatives of smooth image
         */
-        cv::Mat translationMatrix;
-        cv::Mat smoothImage;
+        cv::Mat  translationMatrix;
+        cv::Mat& smoothImage = buffers.acquire(size, CV_32FC1);
         cv::GaussianBlur(image, smoothImage, cv::Size(5, 5), 3);
 
-        cv::Mat rightImage;
+        cv::Mat& rightImage = buffers.acquire(size, CV_32FC1);
         mathUtils::getTranslationMatrix(-1, 0, &translationMatrix);
         cv::warpAffine(smoothImage, rightImage, translationMatrix, smoothImage.size());
 
-        cv::Mat leftImage; 
+        cv::Mat& leftImage = buffers.acquire(size, CV_32FC1);
         mathUtils::getTranslationMatrix(1, 0, &translationMatrix);
         cv::warpAffine(smoothImage, leftImage, translationMatrix, smoothImage.size());
 
-        cv::Mat upImage;
+        cv::Mat& upImage = buffers.acquire(size, CV_32FC1);
         mathUtils::getTranslationMatrix(0, 1, &translationMatrix);
         cv::warpAffine(smoothImage, upImage, translationMatrix, smoothImage.size());
 
-        cv::Mat downImage;
+        cv::Mat& downImage = buffers.acquire(size, CV_32FC1);
         mathUtils::getTranslationMatrix(0, -1, &translationMatrix);
         cv::warpAffine(smoothImage, downImage, translationMatrix, smoothImage.size());
-        
-        const cv::Mat Ix = (rightImage - leftImage) * 0.5f;
-        const cv::Mat Iy = (downImage - upImage) * 0.5f;
+
+        // assigned (not constructed), so expressions are written into pooled buffers
+        cv::Mat& Ix = buffers.acquire(size, CV_32FC1);
+        cv::Mat& Iy = buffers.acquire(size, CV_32FC1);
+        Ix = (rightImage - leftImage) * 0.5f;
+        Iy = (downImage - upImage) * 0.5f;
 
         /*
             Step 2
             Compute products of derivatives at every pixel
         */
-        const cv::Mat Ix2 = Ix.mul(Ix); 
-        const cv::Mat Iy2 = Iy.mul(Iy);
-        const cv::Mat Ixy = Ix.mul(Iy);;
+        cv::Mat& Ix2 = buffers.acquire(size, CV_32FC1);
+        cv::Mat& Iy2 = buffers.acquire(size, CV_32FC1);
+        cv::Mat& Ixy = buffers.acquire(size, CV_32FC1);
+        Ix2 = Ix.mul(Ix);
+        Iy2 = Iy.mul(Iy);
+        Ixy = Ix.mul(Iy);
 
         /*
             Step 3
             Compute the sums of the products of derivatives at each pixel
         */
-        cv::Mat Sx2;
-        cv::Mat Sy2;
-        cv::Mat Sxy;
+        cv::Mat& Sx2 = buffers.acquire(size, CV_32FC1);
+        cv::Mat& Sy2 = buffers.acquire(size, CV_32FC1);
+        cv::Mat& Sxy = buffers.acquire(size, CV_32FC1);
         cv::GaussianBlur(Ix2, Sx2, cv::Size(5, 5), 3);
         cv::GaussianBlur(Iy2, Sy2, cv::Size(5, 5), 3);
         cv::GaussianBlur(Ixy, Sxy, cv::Size(5, 5), 3);
@@ -104,8 +130,8 @@ void HarrisFeatureDetector::_detectImpl(
 
             R = det(M) - k * (trace(M))^2
         */
-        const cv::Mat R = 
-            (Sx2.mul(Sy2) - Sxy.mul(Sxy)) - _k * (Sx2 + Sy2).mul(Sx2 + Sy2);
+        cv::Mat& R = buffers.acquire(size, CV_32FC1);
+        R = (Sx2.mul(Sy2) - Sxy.mul(Sxy)) - _k * (Sx2 + Sy2).mul(Sx2 + Sy2);
  
         /*
             Step 6-1
@@ -117,7 +143,8 @@ void HarrisFeatureDetector::_detectImpl(
             pixels around borders.
         */
         const int siftHack = 8;
-        cv::Mat featureIndexMat = cv::Mat::zeros(R.size(), CV_8UC1);
+        cv::Mat& featureIndexMat = buffers.acquire(size, CV_8UC1);
+        featureIndexMat.setTo(0);
         for (int iy = siftHack; iy < R.rows - siftHack; ++iy) {
             for (int ix = siftHack; ix < R.cols - siftHack; ++ix) {
                 if (R.at<float>(iy, ix) > _threshold) {
@@ -137,8 +164,8 @@ void HarrisFeatureDetector::_detectImpl(
         int dx[8] = { 1, 1, 0, -1, -1, -1,  0,  1 };
         int dy[8] = { 0, 1, 1,  1,  0, -1, -1, -1 };
         for (int shift = 0; shift < 8; ++shift) {
-            cv::Mat tmpImage;
-            cv::Mat translationMatrix;
+            cv::Mat& tmpImage = buffers.acquire(size, CV_32FC1);
+            cv::Mat  translationMatrix;
             mathUtils::getTranslationMatrix(dx[shift], dy[shift], &translationMatrix);
 
             cv::warpAffine(R, tmpImage, translationMatrix, R.size());
@@ -162,14 +189,14 @@ void HarrisFeatureDetector::_detectImpl(
 
         numAllFeatures += sumFeatures;
 
-        std::cout << "\r    Progress of feature detection: " << (n + 1) << "/" << numImages
-                  << std::flush;
+        _log().progress() << "\r    Progress of feature detection: " << (n + 1) << "/" << numImages
+                          << std::flush;
     }
 
-    std::cout << std::endl
-              << "# Finish feature detection of all images, avg: "
-              << (numAllFeatures / static_cast<float>(numImages)) << " features"
-              << std::endl;
+    _log().progress() << std::endl
+                      << "# Finish feature detection of all images, avg: "
+                      << (numAllFeatures / static_cast<float>(numImages)) << " features"
+                      << std::endl;
 }
 
 bool HarrisFeatureDetector::_isLocalMaximum(
@@ -1,13 +1,20 @@
 #pragma once
 
+#include "core/bufferPool.h"
 #include "core/featureDetector.h"
 
+#include <memory>
+
 namespace sis {
 
 class HarrisFeatureDetector : public FeatureDetector {
 public:
     HarrisFeatureDetector();
+    HarrisFeatureDetector(const std::shared_ptr<BufferPool>& bufferPool);
     HarrisFeatureDetector(const float k, const float threshold);
+    HarrisFeatureDetector(const float                        k,
+                          const float                        threshold,
+                          const std::shared_ptr<BufferPool>& bufferPool);
 
 private:
     void _detectImpl(
@@ -22,6 +29,9 @@ private:
 
     float _k;
     float _threshold;
+
+    // per-image intermediate images are recycled through it
+    std::shared_ptr<BufferPool> _bufferPool;
 };
 
 } // namespace sis
\ No newline at end of file
@@ -1,9 +1,92 @@
 #include "featureMatcher/bruteForceFeatureMatcher.h"
 
+#include "featureDescriptor/siftFeatureDescriptor.h"
+#include "featureMatcher/descriptorDistance.h"
+
+#include <algorithm>
+#include <cmath>
 #include <limits>
+#include <stdexcept>
 
 namespace sis {
 
+namespace {
+
+/*
+    Pack descriptors one after another, so distance kernels
+    stream through contiguous memory
+*/
+std::vector<float> packDescriptors(const std::vector<std::vector<float>>& descriptors, const int dimension) {
+    std::vector<float> packedDescriptors;
+    packedDescriptors.reserve(descriptors.size() * dimension);
+    for (auto& descriptor : descriptors) {
+        if (static_cast<int>(descriptor.size()) != dimension) {
+            throw std::runtime_error("Feature descriptors have different dimensions");
+        }
+
+        packedDescriptors.insert(packedDescriptors.end(), descriptor.begin(), descriptor.end());
+    }
+
+    return packedDescriptors;
+}
+
+/*
+    For each descriptor of image2, find its first and second nearest
+    descriptors of image1, and keep it if the ratio of their distances
+    is less than the threshold
+
+    DIMENSION: specialized descriptor dimension, 0 uses the runtime
+               dimension instead
+*/
+template<int DIMENSION>
+void findRatioMatchings(
+    const std::vector<float>&                                 packedDescriptors1,
+    const std::vector<float>&                                 packedDescriptors2,
+    const int                                                 dimension,
+    const float                                               threshold,
+    std::vector<std::pair<float, std::pair<int, int>>>* const out_ratioMatchingIndex) {
+
+    const int numDes1 = (dimension > 0) ? static_cast<int>(packedDescriptors1.size()) / dimension : 0;
+    const int numDes2 = (dimension > 0) ? static_cast<int>(packedDescriptors2.size()) / dimension : 0;
+
+    for (int d2i = 0; d2i < numDes2; ++d2i) {
+        const float* const feature2 = packedDescriptors2.data() + d2i * dimension;
+
+        // compare squared distances, the square root is only needed for the ratio
+        float firstDist  = std::numeric_limits<float>::max();
+        int   firstIndex = 0;
+        float secondDist = std::numeric_limits<float>::max();
+
+        for (int d1i = 0; d1i < numDes1; ++d1i) {
+            const float* const feature1 = packedDescriptors1.data() + d1i * dimension;
+
+            float dist;
+            if constexpr (DIMENSION > 0) {
+                dist = squaredDistance<DIMENSION>(feature2, feature1);
+            }
+            else {
+                dist = squaredDistance(feature2, feature1, dimension);
+            }
+
+            if (dist < firstDist) {
+                secondDist = firstDist;
+                firstDist  = dist;
+                firstIndex = d1i;
+            }
+            else if (dist < secondDist) {
+                secondDist = dist;
+            }
+        }
+
+        const float ratio = std::sqrt(firstDist) / std::sqrt(secondDist);
+        if (ratio < threshold) {
+            out_ratioMatchingIndex->push_back(std::make_pair(ratio, std::make_pair(d2i, firstIndex)));
+        }
+    }
+}
+
+} // namespace
+
 BruteForceFeatureMatcher::BruteForceFeatureMatcher() :
     BruteForceFeatureMatcher(0.7f) {
 }
@@ -18,10 +101,10 @@ void BruteForceFeatureMatcher::_matchImpl(
     const std::vector<std::vector<std::vector<float>>>&  featureDescriptors,
     std::vector<std::vector<std::pair<int, int>>>* const out_featureMatches) const {
 
-    std::cout << "# Begin to match features between image pairs"
-              << std::endl
-              << "\r    Progress of feature matching: 0/" << (images.size() - 1)
-              << std::flush;
+    _log().progress() << "# Begin to match features between image pairs"
+                      << std::endl
+                      << "\r    Progress of feature matching: 0/" << (images.size() - 1)
+                      << std::flush;
 
     const int numImages = static_cast<int>(images.size());
     out_featureMatches->reserve(numImages - 1);
@@ -46,45 +129,52 @@ void BruteForceFeatureMatcher::_matchImpl(
                          ex. std::pair<int, int>(3, 10)
                              it means image2's feature 3 matches image1's feature 10
         */
-        const int numDes1 = static_cast<int>(des1.size());
-        const int numDes2 = static_cast<int>(des2.size());
+        const int dimension = !des1.empty() ? static_cast<int>(des1[0].size()) :
+                              !des2.empty() ? static_cast<int>(des2[0].size()) : 0;
 
-        std::vector<std::pair<int, int>> matchingIndex;
-        for (int d2i = 0; d2i < numDes2; ++d2i) {
-            const cv::Mat feature2(des2[d2i]);
-
-            float firstDist  = std::numeric_limits<float>::max();
-            int   firstIndex = 0;
-            float secondDist = std::numeric_limits<float>::max();
-
-            for (int d1i = 0; d1i < numDes1; ++d1i) {
-                const cv::Mat feature1(des1[d1i]);
-
-                const float dist = static_cast<float>(cv::norm(feature2, feature1, cv::NORM_L2));
-                if (dist < firstDist) {
-                    secondDist = firstDist;
-                    firstDist  = dist;
-                    firstIndex = d1i;
-                }
-                else if (dist < secondDist) {
-                    secondDist = dist;
-                }
-            }
+        const std::vector<float> packedDescriptors1 = packDescriptors(des1, dimension);
+        const std::vector<float> packedDescriptors2 = packDescriptors(des2, dimension);
 
-            if (firstDist / secondDist < _threshold) {
-                matchingIndex.push_back(std::make_pair(d2i, firstIndex));
-            }
+        /*
+            SIFT descriptors use the kernel specialized on their dimension,
+            others fall back to the runtime-dimension kernel
+        */
+        std::vector<std::pair<float, std::pair<int, int>>> ratioMatchingIndex;
+        if (dimension == SiftFeatureDescriptor::DIMENSION) {
+            findRatioMatchings<SiftFeatureDescriptor::DIMENSION>(
+                packedDescriptors1, packedDescriptors2, dimension, _threshold, &ratioMatchingIndex);
+        }
+        else {
+            findRatioMatchings<0>(
+                packedDescriptors1, packedDescriptors2, dimension, _threshold, &ratioMatchingIndex);
+        }
+
+        /*
+            Sort matchings by distance ratio, the most distinctive
+            matching comes first (image matchers like PROSAC use
+            this order as matching quality)
+        */
+        std::stable_sort(ratioMatchingIndex.begin(), ratioMatchingIndex.end(),
+            [](const std::pair<float, std::pair<int, int>>& a,
+               const std::pair<float, std::pair<int, int>>& b) {
+                return a.first < b.first;
+            });
+
+        std::vector<std::pair<int, int>> matchingIndex;
+        matchingIndex.reserve(ratioMatchingIndex.size());
+        for (auto& ratioMatching : ratioMatchingIndex) {
+            matchingIndex.push_back(ratioMatching.second);
         }
 
         out_featureMatches->push_back(matchingIndex);
 
-        std::cout << "\r    Progress of feature matching: " << (n + 1) << "/" << (numImages - 1)
-                  << std::flush;
+        _log().progress() << "\r    Progress of feature matching: " << (n + 1) << "/" << (numImages - 1)
+                          << std::flush;
     }
 
-    std::cout << std::endl
-              << "# Finish all feature matchings"
-              << std::endl;
+    _log().progress() << std::endl
+                      << "# Finish all feature matchings"
+                      << std::endl;
 }
 
 } // namespace sis
\ No newline at end of file
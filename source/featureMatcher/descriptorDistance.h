@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+
+namespace sis {
+
+/*
+    Squared L2 distance of DIMENSION-dimensional descriptors. The sum is
+    accumulated in NUM_LANES independent partial sums, so the fixed-length
+    loop is vectorized without reassociating a single float sum.
+*/
+template<int DIMENSION, int NUM_LANES = 8>
+float squaredDistance(const float* const descriptor1, const float* const descriptor2);
+
+/*
+    Squared L2 distance of descriptors whose dimension is only known
+    at runtime (for descriptors without a specialized kernel)
+*/
+float squaredDistance(const float* const descriptor1, const float* const descriptor2, const int dimension);
+
+// header implementation
+
+template<int DIMENSION, int NUM_LANES>
+inline float squaredDistance(const float* const descriptor1, const float* const descriptor2) {
+    static_assert(DIMENSION % NUM_LANES == 0, "Descriptor dimension should be a multiple of lanes");
+
+    std::array<float, NUM_LANES> partialSums = {};
+    for (int i = 0; i < DIMENSION; i += NUM_LANES) {
+        for (int lane = 0; lane < NUM_LANES; ++lane) {
+            const float difference = descriptor1[i + lane] - descriptor2[i + lane];
+            partialSums[lane] += difference * difference;
+        }
+    }
+
+    float sum = 0.0f;
+    for (int lane = 0; lane < NUM_LANES; ++lane) {
+        sum += partialSums[lane];
+    }
+
+    return sum;
+}
+
+inline float squaredDistance(const float* const descriptor1, const float* const descriptor2, const int dimension) {
+    float sum = 0.0f;
+    for (int i = 0; i < dimension; ++i) {
+        const float difference = descriptor1[i] - descriptor2[i];
+        sum += difference * difference;
+    }
+
+    return sum;
+}
+
+} // namespace sis
\ No newline at end of file
@@ -1,124 +1,224 @@
 #include "imageBlender/linearAlphaImageBlender.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace sis {
 
 LinearAlphaImageBlender::LinearAlphaImageBlender() = default;
 
-void LinearAlphaImageBlender::_blendImpl(
-    const std::vector<cv::Mat>&   images,
-    const std::vector<cv::Point>& imageAlignments,
-    const std::vector<cv::Mat>&   warpImageIndices,
-    cv::Mat* const                out_blendImage) const {
-
-    std::cout << "# Begin to blend images using x-direction alpha blending"
-              << std::endl;
+void LinearAlphaImageBlender::_blendRegionImpl(
+    const std::vector<cv::Mat>&     images,
+    const std::vector<cv::Mat>&     warpImageIndices,
+    const std::vector<ImageTables>& imageTables,
+    const std::vector<cv::Point>&   imagePositions,
+    const std::vector<int>&         columnOffsets,
+    const cv::Rect&                 region,
+    cv::Mat* const                  out_blendRegion) const {
 
-    const int numImages     = static_cast<int>(images.size());
-    const int numAlignments = static_cast<int>(imageAlignments.size());
+    const int numImages = static_cast<int>(images.size());
 
     /*
-        Because we calculate alignment of every two-image pair,
-        we need to add alignment globally, called accumulateAlignment
+        Composite directly on the 8-bit panorama region,
+        in place if out_blendRegion is an ROI of the panorama
 
-        ex. alignment1 is (-3,  4) of image2-1
-            alignment2 is (-5, -2) of image3-2
+        panoramaIndex: 1 if the pixel has been filled by previous images
+    */
+    out_blendRegion->create(region.size(), CV_8UC3);
+    out_blendRegion->setTo(cv::Scalar::all(0));
 
-            after adding alignment globally
-            accumulateAlignment2 = alignment2 + alignment1
+    cv::Mat panorama      = *out_blendRegion;
+    cv::Mat panoramaIndex = cv::Mat::zeros(region.size(), CV_8UC1);
 
-            accumulateAlignment1 is (-3, 4) of image2-1
-            accumulateAlignment2 is (-8, 2) of image3-1
-    */
-    std::vector<cv::Point> accumulateAlignments;
-    accumulateAlignments.assign(imageAlignments.begin(), imageAlignments.end());
+    /*
+        Drifting is corrected while compositing, pixel (ix, iy)
+        goes to panorama row iy + position.y + columnOffsets[x].
 
-    int minDy = (accumulateAlignments[0].y < 0) ? accumulateAlignments[0].y : 0;
-    int maxDy = (accumulateAlignments[0].y > 0) ? accumulateAlignments[0].y : 0;
-    for (int n = 1; n < numAlignments; ++n) {
-        accumulateAlignments[n] += accumulateAlignments[n - 1];
+        Adjacent columns of an image with the same offset form a band,
+        and in a band each image row maps to a distinct panorama row.
+        Bands of images inside region are collected first.
+    */
+    struct Band {
+        int image;
+        int beginX; // image columns [beginX, endX)
+        int endX;
+        int localY; // panorama row of image row 0, in region
+    };
+
+    std::vector<Band> bands;
+    for (int n = 0; n < numImages; ++n) {
+        const cv::Point& position = imagePositions[n];
 
-        minDy = (accumulateAlignments[n].y < minDy) ? accumulateAlignments[n].y : minDy;
-        maxDy = (accumulateAlignments[n].y > maxDy) ? accumulateAlignments[n].y : maxDy;
-    }
+        /*
+            Only columns of image inside region are composited
+        */
+        if ((imageTables[n].rect & region).area() == 0) {
+            continue;
+        }
 
-    /*
-        Build final panorama image with correct size
+        const int beginX = std::max(region.x - position.x, 0);
+        const int endX   = std::min(region.x + region.width - position.x, images[n].cols);
 
-        allWidth : sum of total images' widths,
-                   and then add last image's x-alignment
-        allHeight: image's height
-                    if(minDy < 0)
-                        allHeight += -minDy
-                    if(maxDy > 0)
-                        allHeight += maxDy
+        int bandBeginX = beginX;
+        while (bandBeginX < endX) {
+            const int offset = columnOffsets[position.x + bandBeginX];
 
-        offsetX  : starting x-position for image-2 to image-N
-    */
-    int allWidth  = 0;
-    int allHeight = 0;
-    std::vector<int> offsetX;
-    offsetX.reserve(images.size());
-
-    for (auto& img : images) {
-        allWidth += img.cols;
-        offsetX.push_back(allWidth);
-    }
-    allWidth += accumulateAlignments[numAlignments - 1].x;
+            int bandEndX = bandBeginX + 1;
+            while (bandEndX < endX && columnOffsets[position.x + bandEndX] == offset) {
+                ++bandEndX;
+            }
 
-    allHeight = images[0].rows;
-    allHeight += (minDy < 0) ? -minDy : 0;
-    allHeight += (maxDy > 0) ? maxDy : 0;
+            bands.push_back({ n, bandBeginX, bandEndX, position.y + offset - region.y });
 
-    cv::Mat panorama      = cv::Mat::zeros(cv::Size(allWidth, allHeight), CV_32FC3);
-    cv::Mat panoramaIndex = cv::Mat::zeros(panorama.size(), CV_8UC1);
+            bandBeginX = bandEndX;
+        }
+    }
 
     /*
-        Stitch each image
+        Panorama rows are composited in parallel (it runs serially
+        if tiles are blended in parallel), each row walks the bands
+        in image order, so images are stitched in order for every pixel.
+
+        Valid pixels of a row are split into spans,
+        pixels not filled yet are copied as a block,
+        and filled pixels are blended with the weight table.
     */
-    for (int n = 0; n < numImages; ++n) {
-        const cv::Mat& image = images[n];
-        const int width  = image.cols;
-        const int height = image.rows;
+    cv::parallel_for_(cv::Range(0, region.height), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y) {
+            uchar* dstRow = panorama.ptr<uchar>(y);
+            uchar* filled = panoramaIndex.ptr<uchar>(y);
+
+            for (const auto& band : bands) {
+                const cv::Mat& image = images[band.image];
+                const int      iy    = y - band.localY;
+                if (iy < 0 || iy >= image.rows) {
+                    continue;
+                }
 
-        const int beginX = (n == 0) ?
-                           0 : offsetX[n - 1] + accumulateAlignments[n - 1].x;
-        const int beginY = (n == 0) ?
-                           -minDy : -minDy + accumulateAlignments[n - 1].y;
+                /*
+                    Exposure gain is applied by a lookup table while compositing,
+                    and images with gain 1 skip it (no table)
+                */
+                const ImageTables& tables  = imageTables[band.image];
+                const uchar*       gains   = tables.gainTable.empty() ? nullptr : tables.gainTable.data();
+                const ushort*      weights = tables.weightTable.data();
+
+                const float* indexRow = warpImageIndices[band.image].ptr<float>(iy);
+                const uchar* srcRow   = image.ptr<uchar>(iy);
+                const int    localX   = imagePositions[band.image].x - region.x;
+
+                int ix = band.beginX;
+                while (ix < band.endX) {
+                    if (indexRow[ix] <= 0.0f) {
+                        ++ix;
+                        continue;
+                    }
 
-        /*
-            From the second image, we need to use origin alignment
-            to build x-linear blending weight
-        */
-        const float intersectionRegion = (n > 0) ?
-                                         -imageAlignments[n - 1].x : 0.0f;
-
-        for (int iy = 0; iy < height; ++iy) {
-            for (int ix = 0; ix < width; ++ix) {
-                if (warpImageIndices[n].at<float>(iy, ix) > 0) {
-                    const cv::Vec3f originValue = panorama.at<cv::Vec3f>(iy + beginY, ix + beginX);
-                    const cv::Vec3f addValue    = cv::Vec3f(image.at<cv::Vec3b>(iy, ix));
-                    
-                    if (panoramaIndex.at<uchar>(iy + beginY, ix + beginX) == 0) {
-                        panoramaIndex.at<uchar>(iy + beginY, ix + beginX) = 1;
-                        panorama.at<cv::Vec3f>(iy + beginY, ix + beginX)  = addValue;
+                    const int   x        = ix + localX;
+                    const uchar isFilled = filled[x];
+
+                    int spanEnd = ix + 1;
+                    while (spanEnd < band.endX &&
+                           indexRow[spanEnd] > 0.0f &&
+                           filled[spanEnd + localX] == isFilled) {
+                        ++spanEnd;
                     }
-                    else {
-                        const float addWeight = ix / intersectionRegion;
 
-                        panorama.at<cv::Vec3f>(iy + beginY, ix + beginX)
-                            = (1.0f - addWeight) * originValue + addWeight * addValue;
+                    const int spanLength = spanEnd - ix;
+                    if (isFilled == 0) {
+                        _copySpan(dstRow + 3 * x, srcRow + 3 * ix, gains, 3 * spanLength);
+                        std::memset(filled + x, 1, spanLength);
                     }
+                    else {
+                        _blendSpan(dstRow + 3 * x, srcRow + 3 * ix, gains, weights + 3 * ix, 3 * spanLength);
+                    }
+
+                    ix = spanEnd;
                 }
             }
         }
+    });
+}
+
+bool LinearAlphaImageBlender::_supportsRegionBlending() const {
+    return true;
+}
+
+void LinearAlphaImageBlender::_calculateWeightTable(
+    const int                          n,
+    const cv::Size&                    imageSize,
+    const std::vector<ImageAlignment>& imageAlignments,
+    std::vector<ushort>* const         out_weightTable) const {
+
+    const int weightOne = 1 << WEIGHT_BITS;
+    const int width     = imageSize.width;
+
+    /*
+        From the second image, we need to use origin alignment
+        to build x-linear blending weight, it is precomputed
+        in fixed-point for each channel
+    */
+    const int intersectionRegion = (n > 0) ?
+                                   -imageAlignments[n - 1].translation.x : 0;
+
+    std::vector<ushort>& weightTable = *out_weightTable;
+    weightTable.resize(3 * width);
+    for (int ix = 0; ix < width; ++ix) {
+        const int weight = (intersectionRegion > 0) ?
+                           std::min(ix * weightOne / intersectionRegion, weightOne) :
+                           weightOne;
+
+        weightTable[3 * ix]     = static_cast<ushort>(weight);
+        weightTable[3 * ix + 1] = static_cast<ushort>(weight);
+        weightTable[3 * ix + 2] = static_cast<ushort>(weight);
     }
+}
+
+void LinearAlphaImageBlender::_copySpan(
+    uchar* const       dst,
+    const uchar* const src,
+    const uchar* const gains,
+    const int          length) const {
 
-    panorama.convertTo(panorama, CV_8UC3);
+    if (!gains) {
+        std::memcpy(dst, src, length);
 
-    *out_blendImage = panorama;
+        return;
+    }
 
-    std::cout << "# Finish image blending"
-              << std::endl;
+    for (int i = 0; i < length; ++i) {
+        dst[i] = gains[src[i]];
+    }
+}
+
+void LinearAlphaImageBlender::_blendSpan(
+    uchar* const        dst,
+    const uchar* const  src,
+    const uchar* const  gains,
+    const ushort* const weights,
+    const int           length) const {
+
+    /*
+        dst = (1 - w) * dst + w * gain(src), in fixed-point
+
+        Without gain it is a branch-free element-wise loop,
+        so compilers would vectorize it
+    */
+    const int weightOne  = 1 << WEIGHT_BITS;
+    const int weightHalf = 1 << (WEIGHT_BITS - 1);
+    if (!gains) {
+        for (int i = 0; i < length; ++i) {
+            const int weight = weights[i];
+            dst[i] = static_cast<uchar>((dst[i] * (weightOne - weight) + src[i] * weight + weightHalf) >> WEIGHT_BITS);
+        }
+
+        return;
+    }
+
+    for (int i = 0; i < length; ++i) {
+        const int weight = weights[i];
+        dst[i] = static_cast<uchar>((dst[i] * (weightOne - weight) + gains[src[i]] * weight + weightHalf) >> WEIGHT_BITS);
+    }
 }
 
 } // namespace sis
\ No newline at end of file
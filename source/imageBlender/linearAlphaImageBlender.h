@@ -8,17 +8,56 @@ namespace sis {
     LinearAlphaImageBlender: pixels in the overlapping region are 
                              blending with values of two images using 
                              x-direction linear weighted interpolation.
+
+    Blending weights are 16-bit fixed-point values looked up from
+    a per-column table of each image, it is built once per blend
+    (not per tile), and rows are composited in parallel directly
+    on the 8-bit panorama. Any panorama region can be composited
+    independently, so it supports strip-by-strip output, and the
+    panorama is composited tile by tile on a sparse canvas.
+
+    Vertical drifting is corrected by per-column y-offsets
+    while compositing, no extra resampling pass is needed.
 */
 class LinearAlphaImageBlender : public ImageBlender {
 public:
     LinearAlphaImageBlender();
 
 private:
-    void _blendImpl(
-        const std::vector<cv::Mat>&   images,
-        const std::vector<cv::Point>& imageAlignments,
-        const std::vector<cv::Mat>&   warpImageIndices,
-        cv::Mat* const                out_blendImage) const override;
+    void _blendRegionImpl(
+        const std::vector<cv::Mat>&     images,
+        const std::vector<cv::Mat>&     warpImageIndices,
+        const std::vector<ImageTables>& imageTables,
+        const std::vector<cv::Point>&   imagePositions,
+        const std::vector<int>&         columnOffsets,
+        const cv::Rect&                 region,
+        cv::Mat* const                  out_blendRegion) const override;
+
+    bool _supportsRegionBlending() const override;
+
+    // weight of column ix is ix / intersectionRegion (clamped to 1), one per channel
+    void _calculateWeightTable(
+        const int                          n,
+        const cv::Size&                    imageSize,
+        const std::vector<ImageAlignment>& imageAlignments,
+        std::vector<ushort>* const         out_weightTable) const override;
+
+    // gains is the gain lookup table, or nullptr if gain is 1
+    void _copySpan(
+        uchar* const       dst,
+        const uchar* const src,
+        const uchar* const gains,
+        const int          length) const;
+
+    void _blendSpan(
+        uchar* const        dst,
+        const uchar* const  src,
+        const uchar* const  gains,
+        const ushort* const weights,
+        const int           length) const;
+
+    // weight 1.0 is (1 << WEIGHT_BITS) in fixed-point
+    static constexpr int WEIGHT_BITS = 15;
 };
 
 } // namespace sis
\ No newline at end of file
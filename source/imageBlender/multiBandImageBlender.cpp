@@ -0,0 +1,245 @@
+#include "imageBlender/multiBandImageBlender.h"
+
+#include <algorithm>
+
+namespace sis {
+
+MultiBandImageBlender::MultiBandImageBlender() :
+    MultiBandImageBlender(5) {
+}
+
+MultiBandImageBlender::MultiBandImageBlender(const int numLevels) :
+    _numLevels(numLevels) {
+}
+
+void MultiBandImageBlender::_blendRegionImpl(
+    const std::vector<cv::Mat>&     images,
+    const std::vector<cv::Mat>&     warpImageIndices,
+    const std::vector<ImageTables>& imageTables,
+    const std::vector<cv::Point>&   imagePositions,
+    const std::vector<int>&         columnOffsets,
+    const cv::Rect&                 region,
+    cv::Mat* const                  out_blendRegion) const {
+
+    const int numImages = static_cast<int>(images.size());
+
+    /*
+        Pyramids are built on region extended by margin on each side,
+        so bands near region borders see the same neighborhood as
+        inside the panorama. Extended region is aligned to margin
+        (the coarsest level) and it is at least 4 margins large,
+        so every region uses all levels.
+    */
+    const int  margin    = 1 << _numLevels;
+    const auto alignDown = [margin](const int value) {
+        return (value >= 0) ? value / margin * margin : -((-value + margin - 1) / margin) * margin;
+    };
+
+    const int beginX = alignDown(region.x - margin);
+    const int beginY = alignDown(region.y - margin);
+    const int endX   = std::max(alignDown(region.x + region.width  + 2 * margin - 1), beginX + 4 * margin);
+    const int endY   = std::max(alignDown(region.y + region.height + 2 * margin - 1), beginY + 4 * margin);
+    const cv::Rect extendRegion(beginX, beginY, endX - beginX, endY - beginY);
+
+    /*
+        Images are composited in order, panorama keeps 8-bit
+        values and panoramaMask records filled pixels
+    */
+    cv::Mat panorama     = cv::Mat::zeros(extendRegion.size(), CV_8UC3);
+    cv::Mat panoramaMask = cv::Mat::zeros(extendRegion.size(), CV_8UC1);
+    for (int n = 0; n < numImages; ++n) {
+        if ((imageTables[n].rect & extendRegion).area() == 0) {
+            continue;
+        }
+
+        cv::Mat image;
+        cv::Mat mask;
+        _placeImage(images[n], warpImageIndices[n], imageTables[n], imagePositions[n], columnOffsets,
+                    extendRegion, &image, &mask);
+
+        /*
+            Pixels covered by both use blended values, the seam is
+            the middle of the overlap with previous image in x-direction,
+            and pixels only covered by current image are copied directly
+        */
+        const cv::Mat bothMask = panoramaMask & mask;
+        const cv::Mat onlyMask = mask & ~panoramaMask;
+        if (n > 0 && cv::countNonZero(bothMask) > 0) {
+            const int overlapBeginX = imagePositions[n].x;
+            const int overlapEndX   = std::min(imagePositions[n - 1].x + images[n - 1].cols,
+                                               imagePositions[n].x + images[n].cols);
+            const int seamX         = (overlapBeginX + std::max(overlapEndX, overlapBeginX)) / 2;
+
+            cv::Mat blendImage;
+            _blendBands(panorama, panoramaMask, image, mask, seamX - extendRegion.x, &blendImage);
+            blendImage.copyTo(panorama, bothMask);
+        }
+        image.copyTo(panorama, onlyMask);
+        panoramaMask.setTo(255, mask);
+    }
+
+    panorama(cv::Rect(region.tl() - extendRegion.tl(), region.size())).copyTo(*out_blendRegion);
+}
+
+bool MultiBandImageBlender::_supportsRegionBlending() const {
+    return true;
+}
+
+int MultiBandImageBlender::_regionBorder() const {
+    // extended region reaches at most 3 margins beyond region (see _blendRegionImpl)
+    return 3 << _numLevels;
+}
+
+void MultiBandImageBlender::_placeImage(
+    const cv::Mat&          image,
+    const cv::Mat&          warpImageIndex,
+    const ImageTables&      imageTables,
+    const cv::Point&        imagePosition,
+    const std::vector<int>& columnOffsets,
+    const cv::Rect&         region,
+    cv::Mat* const          out_image,
+    cv::Mat* const          out_mask) const {
+
+    *out_image = cv::Mat::zeros(region.size(), CV_8UC3);
+    *out_mask  = cv::Mat::zeros(region.size(), CV_8UC1);
+
+    // exposure gain is applied by its lookup table while placing
+    cv::Mat gainTable;
+    if (!imageTables.gainTable.empty()) {
+        gainTable = cv::Mat(1, 256, CV_8UC1, const_cast<uchar*>(imageTables.gainTable.data()));
+    }
+
+    /*
+        Adjacent columns with the same offset form a band,
+        and each band is copied as a block
+    */
+    const int numColumnOffsets = static_cast<int>(columnOffsets.size());
+    const int beginX = std::max(std::max(region.x, 0) - imagePosition.x, 0);
+    const int endX   = std::min(std::min(region.x + region.width, numColumnOffsets) - imagePosition.x, image.cols);
+
+    int bandBeginX = beginX;
+    while (bandBeginX < endX) {
+        const int offset = columnOffsets[imagePosition.x + bandBeginX];
+
+        int bandEndX = bandBeginX + 1;
+        while (bandEndX < endX && columnOffsets[imagePosition.x + bandEndX] == offset) {
+            ++bandEndX;
+        }
+
+        // image row 0 of the band is at region row top
+        const int top    = imagePosition.y + offset - region.y;
+        const int beginY = std::max(-top, 0);
+        const int endY   = std::min(region.height - top, image.rows);
+        if (beginY < endY) {
+            const cv::Rect sourceRect(bandBeginX, beginY, bandEndX - bandBeginX, endY - beginY);
+            const cv::Rect targetRect(imagePosition.x + bandBeginX - region.x, top + beginY,
+                                      sourceRect.width, sourceRect.height);
+
+            const cv::Mat sourceMask = warpImageIndex(sourceRect) > 0;
+            cv::Mat       targetImage = (*out_image)(targetRect);
+            if (gainTable.empty()) {
+                image(sourceRect).copyTo(targetImage, sourceMask);
+            }
+            else {
+                cv::Mat gainImage;
+                cv::LUT(image(sourceRect), gainTable, gainImage);
+                gainImage.copyTo(targetImage, sourceMask);
+            }
+
+            cv::Mat targetMask = (*out_mask)(targetRect);
+            sourceMask.copyTo(targetMask);
+        }
+
+        bandBeginX = bandEndX;
+    }
+}
+
+void MultiBandImageBlender::_blendBands(
+    const cv::Mat& image1,
+    const cv::Mat& mask1,
+    const cv::Mat& image2,
+    const cv::Mat& mask2,
+    const int      seamX,
+    cv::Mat* const out_blendImage) const {
+
+    /*
+        Fill each image's invalid pixels with the other's,
+        or black borders would bleed into low frequency bands
+    */
+    cv::Mat gaussian1;
+    cv::Mat gaussian2;
+    image1.convertTo(gaussian1, CV_32FC3);
+    image2.convertTo(gaussian2, CV_32FC3);
+    gaussian2.copyTo(gaussian1, mask2 & ~mask1);
+    gaussian1.copyTo(gaussian2, mask1 & ~mask2);
+
+    /*
+        Weight of image2, it is 1 at the right side of the seam
+        (or where only image2 is valid), and 0 otherwise
+    */
+    const int beginSeamX = std::min(std::max(seamX, 0), image1.cols);
+
+    cv::Mat weight = cv::Mat::zeros(image1.size(), CV_32FC1);
+    weight(cv::Rect(beginSeamX, 0, image1.cols - beginSeamX, image1.rows)).setTo(1.0f);
+    weight.setTo(0.0f, ~mask2);
+    weight.setTo(1.0f, mask2 & ~mask1);
+
+    /*
+        Regions are large enough for all levels (see _blendRegionImpl),
+        and every region uses the same levels so their borders match
+    */
+    const int numLevels = _numLevels;
+
+    /*
+        Build Laplacian pyramids of both images and
+        Gaussian pyramid of weight, and then blend each level
+
+        L_i = G_i - pyrUp(G_i+1)
+        R_i = L1_i * (1 - W_i) + L2_i * W_i
+    */
+    std::vector<cv::Mat> blendPyramid;
+    blendPyramid.reserve(numLevels + 1);
+    for (int level = 0; level <= numLevels; ++level) {
+        cv::Mat weight3;
+        cv::merge(std::vector<cv::Mat>{ weight, weight, weight }, weight3);
+
+        if (level == numLevels) {
+            blendPyramid.push_back(gaussian1.mul(cv::Scalar::all(1.0) - weight3) + gaussian2.mul(weight3));
+            break;
+        }
+
+        cv::Mat down1;
+        cv::Mat down2;
+        cv::Mat downWeight;
+        cv::pyrDown(gaussian1, down1);
+        cv::pyrDown(gaussian2, down2);
+        cv::pyrDown(weight, downWeight);
+
+        cv::Mat up1;
+        cv::Mat up2;
+        cv::pyrUp(down1, up1, gaussian1.size());
+        cv::pyrUp(down2, up2, gaussian2.size());
+
+        const cv::Mat laplacian1 = gaussian1 - up1;
+        const cv::Mat laplacian2 = gaussian2 - up2;
+        blendPyramid.push_back(laplacian1.mul(cv::Scalar::all(1.0) - weight3) + laplacian2.mul(weight3));
+
+        gaussian1 = down1;
+        gaussian2 = down2;
+        weight    = downWeight;
+    }
+
+    /*
+        Collapse blended pyramid
+    */
+    cv::Mat blendImage = blendPyramid[numLevels];
+    for (int level = numLevels - 1; level >= 0; --level) {
+        cv::Mat up;
+        cv::pyrUp(blendImage, up, blendPyramid[level].size());
+        blendImage = up + blendPyramid[level];
+    }
+
+    blendImage.convertTo(*out_blendImage, CV_8UC3);
+}
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "core/imageBlender.h"
+
+namespace sis {
+
+/*
+    MultiBandImageBlender: overlapping regions are blended with
+                           Laplacian pyramids, low frequency bands
+                           are blended over a wide range and high
+                           frequency bands over a narrow one.
+
+    It is a region blender, pyramids are built per region (tile or
+    strip) extended by a border of 2^levels pixels, so its memory is
+    proportional to the region size instead of panorama size, and it
+    works in streaming, sliding-window and append modes too.
+
+    Extended regions are aligned to the coarsest pyramid level in
+    panorama coordinate, so neighboring regions downsample the same
+    pixels and their borders match.
+*/
+class MultiBandImageBlender : public ImageBlender {
+public:
+    MultiBandImageBlender();
+    MultiBandImageBlender(const int numLevels);
+
+private:
+    void _blendRegionImpl(
+        const std::vector<cv::Mat>&     images,
+        const std::vector<cv::Mat>&     warpImageIndices,
+        const std::vector<ImageTables>& imageTables,
+        const std::vector<cv::Point>&   imagePositions,
+        const std::vector<int>&         columnOffsets,
+        const cv::Rect&                 region,
+        cv::Mat* const                  out_blendRegion) const override;
+
+    bool _supportsRegionBlending() const override;
+
+    int _regionBorder() const override;
+
+    // place image (with its gain) into region, drifting is corrected by columnOffsets
+    void _placeImage(
+        const cv::Mat&                image,
+        const cv::Mat&                warpImageIndex,
+        const ImageTables&            imageTables,
+        const cv::Point&              imagePosition,
+        const std::vector<int>&       columnOffsets,
+        const cv::Rect&               region,
+        cv::Mat* const                out_image,
+        cv::Mat* const                out_mask) const;
+
+    // blend image1 and image2 with Laplacian pyramids, image2 is on the right of seamX
+    void _blendBands(
+        const cv::Mat& image1,
+        const cv::Mat& mask1,
+        const cv::Mat& image2,
+        const cv::Mat& mask2,
+        const int      seamX,
+        cv::Mat* const out_blendImage) const;
+
+    int _numLevels;
+};
+
+} // namespace sis
\ No newline at end of file
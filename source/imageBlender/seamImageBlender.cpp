@@ -0,0 +1,279 @@
+#include "imageBlender/seamImageBlender.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace sis {
+
+SeamImageBlender::SeamImageBlender() :
+    SeamImageBlender(5) {
+}
+
+SeamImageBlender::SeamImageBlender(const int featherWidth) :
+    _featherWidth(featherWidth) {
+}
+
+void SeamImageBlender::_blendImpl(
+    const std::vector<cv::Mat>&        images,
+    const std::vector<ImageAlignment>& imageAlignments,
+    const std::vector<cv::Mat>&        warpImageIndices,
+    const std::vector<float>&          imageGains,
+    cv::Mat* const                     out_blendImage) const {
+
+    _log().progress() << "# Begin to blend images using optimal seams"
+                      << std::endl;
+
+    const int numImages = static_cast<int>(images.size());
+    const int numPairs  = numImages - 1;
+
+    std::vector<cv::Point> imagePositions;
+    cv::Size               panoramaSize;
+    _calculatePanoramaLayout(images, imageAlignments, &imagePositions, &panoramaSize);
+
+    /*
+        Exposure gains are applied by lookup tables wherever
+        pixel values are read (seam costs, composition and feathering)
+    */
+    std::vector<std::vector<uchar>> gainTables(numImages);
+    for (int n = 0; n < numImages; ++n) {
+        _calculateGainTable(imageGains[n], &gainTables[n]);
+    }
+
+    /*
+        Find seam of each image pair in parallel
+
+        seams[n][y]: for panorama row y, pixels at x >= seams[n][y]
+                     belong to image n+1, others belong to image n
+    */
+    std::vector<std::vector<int>> seams(std::max(numPairs, 0));
+    cv::parallel_for_(cv::Range(0, std::max(numPairs, 0)), [&](const cv::Range& range) {
+        for (int n = range.start; n < range.end; ++n) {
+            _findSeam(images[n],     warpImageIndices[n],     gainTables[n].data(),     imagePositions[n],
+                      images[n + 1], warpImageIndices[n + 1], gainTables[n + 1].data(), imagePositions[n + 1],
+                      panoramaSize.height, &seams[n]);
+        }
+    });
+
+    /*
+        Stitch each image
+
+        Image n covers valid pixels at the right of its left seam,
+        and also fills pixels which previous images don't cover.
+        Following images overwrite it at the right of their seams.
+    */
+    cv::Mat panorama      = cv::Mat::zeros(panoramaSize, CV_8UC3);
+    cv::Mat panoramaIndex = cv::Mat::zeros(panoramaSize, CV_8UC1);
+    for (int n = 0; n < numImages; ++n) {
+        const cv::Mat&   image      = images[n];
+        const cv::Mat&   imageIndex = warpImageIndices[n];
+        const cv::Point& position   = imagePositions[n];
+        const uchar*     gains      = gainTables[n].data();
+
+        cv::parallel_for_(cv::Range(0, image.rows), [&](const cv::Range& range) {
+            for (int iy = range.start; iy < range.end; ++iy) {
+                const int    y        = iy + position.y;
+                const int    leftSeam = (n > 0) ? seams[n - 1][y] : 0;
+                const float* indexRow = imageIndex.ptr<float>(iy);
+                const uchar* srcRow   = image.ptr<uchar>(iy);
+                uchar*       dstRow   = panorama.ptr<uchar>(y);
+                uchar*       filled   = panoramaIndex.ptr<uchar>(y);
+
+                for (int ix = 0; ix < image.cols; ++ix) {
+                    const int x = ix + position.x;
+                    if (indexRow[ix] > 0.0f && (x >= leftSeam || filled[x] == 0)) {
+                        dstRow[3 * x]     = gains[srcRow[3 * ix]];
+                        dstRow[3 * x + 1] = gains[srcRow[3 * ix + 1]];
+                        dstRow[3 * x + 2] = gains[srcRow[3 * ix + 2]];
+                        filled[x] = 1;
+                    }
+                }
+            }
+        });
+    }
+
+    /*
+        Feather narrow bands around seams, panorama rows are split
+        in parallel and each row feathers pairs in order, since bands
+        of different pairs may cover the same pixels (ex. image n+2
+        overlaps image n)
+    */
+    cv::parallel_for_(cv::Range(0, panoramaSize.height), [&](const cv::Range& range) {
+        for (int n = 0; n < numPairs; ++n) {
+            _featherSeam(images[n],     warpImageIndices[n],     gainTables[n].data(),     imagePositions[n],
+                         images[n + 1], warpImageIndices[n + 1], gainTables[n + 1].data(), imagePositions[n + 1],
+                         seams[n], range, &panorama);
+        }
+    });
+
+    *out_blendImage = panorama;
+
+    _log().progress() << "# Finish image blending"
+                      << std::endl;
+}
+
+void SeamImageBlender::_findSeam(
+    const cv::Mat&          image1,
+    const cv::Mat&          imageIndex1,
+    const uchar* const      gains1,
+    const cv::Point&        position1,
+    const cv::Mat&          image2,
+    const cv::Mat&          imageIndex2,
+    const uchar* const      gains2,
+    const cv::Point&        position2,
+    const int               panoramaHeight,
+    std::vector<int>* const out_seam) const {
+
+    const cv::Rect rect1(position1, image1.size());
+    const cv::Rect rect2(position2, image2.size());
+    const cv::Rect overlap = rect1 & rect2;
+
+    // without overlap, image2 simply begins at its left border
+    out_seam->assign(panoramaHeight, rect2.x);
+    if (overlap.area() == 0) {
+        return;
+    }
+
+    const int width  = overlap.width;
+    const int height = overlap.height;
+
+    /*
+        Cost of each overlapping pixel is the sum of absolute
+        color difference, and pixels invalid in either image
+        have a large cost so the seam avoids them
+    */
+    const float invalidCost = 1e5f;
+
+    cv::Mat energy(height, width, CV_32FC1);
+    for (int y = 0; y < height; ++y) {
+        const int y1 = overlap.y + y - position1.y;
+        const int y2 = overlap.y + y - position2.y;
+
+        const uchar* row1      = image1.ptr<uchar>(y1);
+        const uchar* row2      = image2.ptr<uchar>(y2);
+        const float* indexRow1 = imageIndex1.ptr<float>(y1);
+        const float* indexRow2 = imageIndex2.ptr<float>(y2);
+        float*       energyRow = energy.ptr<float>(y);
+
+        for (int x = 0; x < width; ++x) {
+            const int x1 = overlap.x + x - position1.x;
+            const int x2 = overlap.x + x - position2.x;
+
+            if (indexRow1[x1] > 0.0f && indexRow2[x2] > 0.0f) {
+                energyRow[x] = static_cast<float>(std::abs(gains1[row1[3 * x1]]     - gains2[row2[3 * x2]]) +
+                                                  std::abs(gains1[row1[3 * x1 + 1]] - gains2[row2[3 * x2 + 1]]) +
+                                                  std::abs(gains1[row1[3 * x1 + 2]] - gains2[row2[3 * x2 + 2]]));
+            }
+            else {
+                energyRow[x] = invalidCost;
+            }
+        }
+    }
+
+    /*
+        Dynamic programming from top to bottom
+
+        E(y, x) = cost(y, x) + min(E(y-1, x-1), E(y-1, x), E(y-1, x+1))
+    */
+    for (int y = 1; y < height; ++y) {
+        const float* prevRow   = energy.ptr<float>(y - 1);
+        float*       energyRow = energy.ptr<float>(y);
+
+        for (int x = 0; x < width; ++x) {
+            float minPrev = prevRow[x];
+            if (x > 0) {
+                minPrev = std::min(minPrev, prevRow[x - 1]);
+            }
+            if (x < width - 1) {
+                minPrev = std::min(minPrev, prevRow[x + 1]);
+            }
+
+            energyRow[x] += minPrev;
+        }
+    }
+
+    /*
+        Backtrack from the minimum of the last row
+    */
+    std::vector<int> localSeam(height);
+
+    const float* lastRow = energy.ptr<float>(height - 1);
+    localSeam[height - 1] = static_cast<int>(std::min_element(lastRow, lastRow + width) - lastRow);
+    for (int y = height - 2; y >= 0; --y) {
+        const float* energyRow = energy.ptr<float>(y);
+        const int    prevX     = localSeam[y + 1];
+
+        int   bestX      = prevX;
+        float bestEnergy = energyRow[prevX];
+        for (int x = std::max(prevX - 1, 0); x <= std::min(prevX + 1, width - 1); ++x) {
+            if (energyRow[x] < bestEnergy) {
+                bestEnergy = energyRow[x];
+                bestX      = x;
+            }
+        }
+        localSeam[y] = bestX;
+    }
+
+    /*
+        Rows out of overlapping region use seam of nearest row
+    */
+    for (int y = 0; y < panoramaHeight; ++y) {
+        const int localY = std::min(std::max(y - overlap.y, 0), height - 1);
+        (*out_seam)[y] = overlap.x + localSeam[localY];
+    }
+}
+
+void SeamImageBlender::_featherSeam(
+    const cv::Mat&          image1,
+    const cv::Mat&          imageIndex1,
+    const uchar* const      gains1,
+    const cv::Point&        position1,
+    const cv::Mat&          image2,
+    const cv::Mat&          imageIndex2,
+    const uchar* const      gains2,
+    const cv::Point&        position2,
+    const std::vector<int>& seam,
+    const cv::Range&        rows,
+    cv::Mat* const          out_panorama) const {
+
+    const cv::Rect overlap = cv::Rect(position1, image1.size()) & cv::Rect(position2, image2.size());
+    if (overlap.area() == 0 || _featherWidth <= 0) {
+        return;
+    }
+
+    /*
+        In band [seam - featherWidth, seam + featherWidth),
+        weight of image2 grows linearly from 0 to 1
+    */
+    const float bandWidth = 2.0f * _featherWidth;
+    const int beginY = std::max(overlap.y, rows.start);
+    const int endY   = std::min(overlap.y + overlap.height, rows.end);
+    for (int y = beginY; y < endY; ++y) {
+        const int y1 = y - position1.y;
+        const int y2 = y - position2.y;
+
+        const uchar* row1      = image1.ptr<uchar>(y1);
+        const uchar* row2      = image2.ptr<uchar>(y2);
+        const float* indexRow1 = imageIndex1.ptr<float>(y1);
+        const float* indexRow2 = imageIndex2.ptr<float>(y2);
+        uchar*       dstRow    = out_panorama->ptr<uchar>(y);
+
+        const int bandBeginX = std::max(seam[y] - _featherWidth, overlap.x);
+        const int bandEndX   = std::min(seam[y] + _featherWidth, overlap.x + overlap.width);
+        for (int x = bandBeginX; x < bandEndX; ++x) {
+            const int x1 = x - position1.x;
+            const int x2 = x - position2.x;
+            if (indexRow1[x1] <= 0.0f || indexRow2[x2] <= 0.0f) {
+                continue;
+            }
+
+            const float weight = (x - (seam[y] - _featherWidth) + 0.5f) / bandWidth;
+            for (int c = 0; c < 3; ++c) {
+                dstRow[3 * x + c] = cv::saturate_cast<uchar>(
+                    (1.0f - weight) * gains1[row1[3 * x1 + c]] + weight * gains2[row2[3 * x2 + c]]);
+            }
+        }
+    }
+}
+
+} // namespace sis
\ No newline at end of file
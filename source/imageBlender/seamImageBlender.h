@@ -0,0 +1,61 @@
+#pragma once
+
+#include "core/imageBlender.h"
+
+namespace sis {
+
+/*
+    SeamImageBlender: it finds an optimal vertical seam through
+                      each overlapping region with dynamic programming
+                      on color difference, pixels at the left of the seam
+                      come from the left image and the others come from
+                      the right one. Only a narrow band around the seam
+                      is feathered, so moving objects are not ghosted.
+
+    Seams of all image pairs are searched in parallel, and both
+    cost and seam search only use overlapping regions.
+*/
+class SeamImageBlender : public ImageBlender {
+public:
+    SeamImageBlender();
+    SeamImageBlender(const int featherWidth);
+
+private:
+    void _blendImpl(
+        const std::vector<cv::Mat>&        images,
+        const std::vector<ImageAlignment>& imageAlignments,
+        const std::vector<cv::Mat>&        warpImageIndices,
+        const std::vector<float>&          imageGains,
+        cv::Mat* const                     out_blendImage) const override;
+
+    void _findSeam(
+        const cv::Mat&          image1,
+        const cv::Mat&          imageIndex1,
+        const uchar* const      gains1,
+        const cv::Point&        position1,
+        const cv::Mat&          image2,
+        const cv::Mat&          imageIndex2,
+        const uchar* const      gains2,
+        const cv::Point&        position2,
+        const int               panoramaHeight,
+        std::vector<int>* const out_seam) const;
+
+    // feather panorama rows [rows.start, rows.end) only
+    void _featherSeam(
+        const cv::Mat&          image1,
+        const cv::Mat&          imageIndex1,
+        const uchar* const      gains1,
+        const cv::Point&        position1,
+        const cv::Mat&          image2,
+        const cv::Mat&          imageIndex2,
+        const uchar* const      gains2,
+        const cv::Point&        position2,
+        const std::vector<int>& seam,
+        const cv::Range&        rows,
+        cv::Mat* const          out_panorama) const;
+
+    // half width of the feathering band around seams
+    int _featherWidth;
+};
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "imageMatcher/phaseCorrelationImageMatcher.h"
+
+#include "mathUtils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sis {
+
+PhaseCorrelationImageMatcher::PhaseCorrelationImageMatcher() :
+    PhaseCorrelationImageMatcher(0.5f, 3) {
+}
+
+PhaseCorrelationImageMatcher::PhaseCorrelationImageMatcher(const float stripRatio,
+                                                           const int   numLevels) :
+    _stripRatio(stripRatio),
+    _numLevels(numLevels) {
+}
+
+void PhaseCorrelationImageMatcher::_matchImpl(
+    const std::vector<cv::Mat>&                          images,
+    const std::vector<std::vector<cv::Point>>&,
+    const std::vector<std::vector<std::pair<int, int>>>&,
+    std::vector<ImageAlignment>* const                   out_imageAlignments) const {
+
+    const int numImageMatchings = static_cast<int>(images.size()) - 1;
+
+    _log().progress() << "# Begin to match images between image pairs using phase correlation"
+                      << std::endl
+                      << "\r    Progress of image matching: 0/" << numImageMatchings
+                      << std::flush;
+
+    out_imageAlignments->reserve(numImageMatchings);
+
+    for (int n = 0; n < numImageMatchings; ++n) {
+        const cv::Mat& image1 = images[n];
+        const cv::Mat& image2 = images[n + 1];
+
+        /*
+            Build overlap strips in gray scale
+
+            strip1: right part of image1
+            strip2: left part of image2
+
+            both have the same width and height, at least
+            16 pixels wide unless images are narrower
+        */
+        const int minWidth = std::min(image1.cols, image2.cols);
+        const int width    = std::min(std::max(static_cast<int>(minWidth * _stripRatio), 16), minWidth);
+        const int height = std::min(image1.rows, image2.rows);
+
+        cv::Mat gray1;
+        cv::Mat gray2;
+        cv::cvtColor(image1(cv::Rect(image1.cols - width, 0, width, height)), gray1, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(image2(cv::Rect(0, 0, width, height)), gray2, cv::COLOR_BGR2GRAY);
+
+        std::vector<cv::Mat> pyramid1(1);
+        std::vector<cv::Mat> pyramid2(1);
+        gray1.convertTo(pyramid1[0], CV_32FC1);
+        gray2.convertTo(pyramid2[0], CV_32FC1);
+        for (int level = 1; level < _numLevels; ++level) {
+            if (pyramid1.back().cols < 64 || pyramid1.back().rows < 64) {
+                break;
+            }
+
+            cv::Mat down1;
+            cv::Mat down2;
+            cv::pyrDown(pyramid1.back(), down1);
+            cv::pyrDown(pyramid2.back(), down2);
+            pyramid1.push_back(down1);
+            pyramid2.push_back(down2);
+        }
+
+        /*
+            Coarsest level
+
+            shift means strip2's pixel p locates at p + shift in strip1.
+            Because image2 is on the right of image1, x-shift needs
+            to be in [0, width), wrap it back if it is negative.
+        */
+        const int coarsest = static_cast<int>(pyramid1.size()) - 1;
+
+        double      response = 0.0;
+        cv::Point2d shift    = _correlate(pyramid1[coarsest], pyramid2[coarsest], &response);
+        if (shift.x < 0.0) {
+            shift.x += pyramid1[coarsest].cols;
+        }
+
+        /*
+            Finer levels
+
+            Scale shift up and only correlate the predicted
+            overlap region, then add residual shift back
+        */
+        for (int level = coarsest - 1; level >= 0; --level) {
+            shift *= 2.0;
+
+            const cv::Mat& strip1 = pyramid1[level];
+            const cv::Mat& strip2 = pyramid2[level];
+
+            const int dx = static_cast<int>(std::lround(shift.x));
+            const int dy = static_cast<int>(std::lround(shift.y));
+
+            const int overlapWidth  = strip1.cols - std::max(dx, 0);
+            const int overlapHeight = strip1.rows - std::abs(dy);
+            if (dx < 0 || overlapWidth < 16 || overlapHeight < 16) {
+                continue;
+            }
+
+            const cv::Rect region1(dx, std::max(dy, 0), overlapWidth, overlapHeight);
+            const cv::Rect region2(0, std::max(-dy, 0), overlapWidth, overlapHeight);
+
+            double levelResponse = 0.0;
+            const cv::Point2d residual = _correlate(strip1(region1), strip2(region2), &levelResponse);
+
+            shift    = cv::Point2d(dx + residual.x, dy + residual.y);
+            response = levelResponse;
+        }
+
+        /*
+            Change strip shift back to alignment on the concate image
+
+            image1's x = strip1's x + (image1.cols - width)
+            image2's x = strip2's x
+
+            Transform keeps the rounded translation too, images are
+            placed by integer translations, and a sub-pixel transform
+            would only make blenders warp every image
+        */
+        const cv::Point2d move(shift.x + image1.cols - width, shift.y);
+
+        ImageAlignment imageAlignment;
+        imageAlignment.translation = cv::Point(static_cast<int>(std::lround(move.x)) - image1.cols,
+                                               static_cast<int>(std::lround(move.y)));
+        imageAlignment.transform   = mathUtils::getTranslationTransform(image1.cols + imageAlignment.translation.x,
+                                                                        imageAlignment.translation.y);
+        imageAlignment.numInliers  = 0;
+        imageAlignment.residual    = 0.0f;
+        imageAlignment.response    = static_cast<float>(response);
+
+        out_imageAlignments->push_back(imageAlignment);
+
+        _log().progress() << "\r    Progress of image matching: " << (n + 1) << "/" << numImageMatchings
+                          << std::flush;
+    }
+
+    _log().progress() << std::endl
+                      << "# Finish all image matchings"
+                      << std::endl;
+}
+
+bool PhaseCorrelationImageMatcher::isFeatureBased() const {
+    return false;
+}
+
+cv::Point2d PhaseCorrelationImageMatcher::_correlate(
+    const cv::Mat& strip1,
+    const cv::Mat& strip2,
+    double* const  out_response) const {
+
+    /*
+        OpenCV's phaseCorrelate already applies sub-pixel
+        peak refinement (weighted centroid around the peak),
+        we only need to add Hanning window to suppress
+        strip border effect
+    */
+    cv::Mat window;
+    cv::createHanningWindow(window, strip1.size(), CV_32FC1);
+
+    const cv::Point2d shift = cv::phaseCorrelate(strip2, strip1, window, out_response);
+
+    return shift;
+}
+
+} // namespace sis
\ No newline at end of file
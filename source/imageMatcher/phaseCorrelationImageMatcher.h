@@ -0,0 +1,43 @@
+#pragma once
+
+#include "core/imageMatcher.h"
+
+namespace sis {
+
+/*
+    PhaseCorrelationImageMatcher estimates translation of every image pair
+    by FFT phase correlation, it doesn't need any feature.
+
+    It only uses overlap strips (image1's right part and image2's
+    left part), and works coarse-to-fine over an image pyramid:
+    the coarsest level correlates whole strips, and each finer level
+    only correlates the overlap region predicted by the coarser one.
+
+    Peak response of the finest correlated level is stored in
+    ImageAlignment, so failed correlations (ex. low-texture
+    overlaps) are found by the stitcher's suspicious pair check.
+*/
+class PhaseCorrelationImageMatcher : public ImageMatcher {
+public:
+    PhaseCorrelationImageMatcher();
+    PhaseCorrelationImageMatcher(const float stripRatio, const int numLevels);
+
+    bool isFeatureBased() const override;
+
+private:
+    void _matchImpl(
+        const std::vector<cv::Mat>&                          images,
+        const std::vector<std::vector<cv::Point>>&           featurePositions,
+        const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+        std::vector<ImageAlignment>* const                   out_imageAlignments) const override;
+
+    cv::Point2d _correlate(
+        const cv::Mat& strip1,
+        const cv::Mat& strip2,
+        double* const  out_response) const;
+
+    float _stripRatio;
+    int   _numLevels;
+};
+
+} // namespace sis
\ No newline at end of file
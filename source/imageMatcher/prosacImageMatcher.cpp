@@ -0,0 +1,369 @@
+#include "imageMatcher/prosacImageMatcher.h"
+
+#include "mathUtils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sis {
+
+ProsacImageMatcher::ProsacImageMatcher() :
+    ProsacImageMatcher(Model::HOMOGRAPHY) {
+}
+
+ProsacImageMatcher::ProsacImageMatcher(const Model model) :
+    ProsacImageMatcher(model, 3.0f, 2000, 0.99f) {
+}
+
+ProsacImageMatcher::ProsacImageMatcher(const Model model,
+                                       const float inlierThreshold,
+                                       const int   maxIterations,
+                                       const float confidence) :
+    _model(model),
+    _inlierThreshold(inlierThreshold),
+    _maxIterations(maxIterations),
+    _confidence(confidence) {
+}
+
+void ProsacImageMatcher::_matchImpl(
+    const std::vector<cv::Mat>&                          images,
+    const std::vector<std::vector<cv::Point>>&           featurePositions,
+    const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+    std::vector<ImageAlignment>* const                   out_imageAlignments) const {
+
+    const char* modelName = (_model == Model::TRANSLATION) ? "translation" :
+                            (_model == Model::AFFINE)      ? "affine" : "homography";
+
+    _log().progress() << "# Begin to match images between image pairs using PROSAC "
+                      << modelName << " model"
+                      << std::endl
+                      << "\r    Progress of image matching: 0/" << featureMatchings.size()
+                      << std::flush;
+
+    const int numImageMatchings = static_cast<int>(featureMatchings.size());
+    out_imageAlignments->reserve(numImageMatchings);
+
+    const int m = _sampleSize();
+
+    int numAllIterations = 0;
+    for (int n = 0; n < numImageMatchings; ++n) {
+        const std::vector<std::pair<int, int>>& matching = featureMatchings[n];
+        const int numMatchings = static_cast<int>(matching.size());
+
+        const std::vector<cv::Point>& feaPos1 = featurePositions[n];
+        const std::vector<cv::Point>& feaPos2 = featurePositions[n + 1];
+
+        /*
+            Transform maps image2's pixel to image1's pixel,
+            so image2's features are source points.
+
+            Remain: matching is sorted by quality, and this order
+                    is kept in srcPoints and dstPoints.
+        */
+        std::vector<cv::Point2f> srcPoints;
+        std::vector<cv::Point2f> dstPoints;
+        srcPoints.reserve(numMatchings);
+        dstPoints.reserve(numMatchings);
+        for (auto& pair : matching) {
+            srcPoints.push_back(cv::Point2f(feaPos2[pair.first]));
+            dstPoints.push_back(cv::Point2f(feaPos1[pair.second]));
+        }
+
+        ImageAlignment imageAlignment;
+        imageAlignment.transform = mathUtils::getTranslationTransform(images[n].cols, 0.0);
+
+        if (numMatchings >= m) {
+            /*
+                PROSAC sampling schedule
+
+                T_n     : expected number of samples drawn only from
+                          the first n matchings in standard RANSAC
+                T'_n    : iteration count when sampling set grows to n
+
+                At iteration t, if t > T'_n, we grow n by one.
+                Each sample contains the n_th matching and m-1 other
+                matchings from the first n-1 ones, until T'_n falls
+                behind t and it turns to draw m matchings from first n.
+            */
+            int    sampleSetSize = m;
+            double Tn            = static_cast<double>(_maxIterations);
+            for (int i = 0; i < m; ++i) {
+                Tn *= static_cast<double>(sampleSetSize - i) / (numMatchings - i);
+            }
+            int TnPrime = 1;
+
+            int              maxIterations = _maxIterations;
+            int              bestInliers   = -1;
+            float            bestResidual  = 0.0f;
+            cv::Matx33d      bestTransform = imageAlignment.transform;
+            std::vector<int> inliers;
+
+            int t = 0;
+            while (t < maxIterations) {
+                ++t;
+
+                if (t > TnPrime && sampleSetSize < numMatchings) {
+                    const double TnNext = Tn * (sampleSetSize + 1) / (sampleSetSize + 1 - m);
+                    TnPrime += static_cast<int>(std::ceil(TnNext - Tn));
+                    Tn       = TnNext;
+                    ++sampleSetSize;
+                }
+
+                /*
+                    Step 1
+                    Select m samples progressively
+                */
+                int sample[4];
+                int numDrawn = 0;
+                if (TnPrime >= t) {
+                    sample[numDrawn++] = sampleSetSize - 1;
+                }
+
+                const int drawRange = (TnPrime >= t) ? sampleSetSize - 1 : sampleSetSize;
+                while (numDrawn < m) {
+                    const int candidate = mathUtils::nextInt(0, drawRange);
+                    if (std::find(sample, sample + numDrawn, candidate) == sample + numDrawn) {
+                        sample[numDrawn++] = candidate;
+                    }
+                }
+
+                /*
+                    Step 2
+                    Calculate model parameters with m samples
+                */
+                cv::Matx33d transform;
+                if (!_fitMinimal(srcPoints, dstPoints, sample, &transform)) {
+                    continue;
+                }
+
+                /*
+                    Step 3
+                    Count inliers of the fitted model over all matchings
+                */
+                float residual = 0.0f;
+                const int numInliers = _countInliers(srcPoints, dstPoints, transform, nullptr, &residual);
+                if (numInliers > bestInliers ||
+                    (numInliers == bestInliers && residual < bestResidual)) {
+
+                    bestInliers   = numInliers;
+                    bestResidual  = residual;
+                    bestTransform = transform;
+
+                    /*
+                        Adaptive termination, the number of iterations
+                        K = log(1 - p) / log(1 - w^m)
+                    */
+                    const double w  = static_cast<double>(numInliers) / numMatchings;
+                    const double wm = std::pow(w, m);
+                    if (wm >= 1.0) {
+                        maxIterations = t;
+                    }
+                    else if (wm > 0.0) {
+                        const double K = std::log(1.0 - _confidence) / std::log(1.0 - wm);
+                        maxIterations  = std::min(maxIterations, static_cast<int>(std::ceil(K)));
+                    }
+                }
+            }
+            numAllIterations += t;
+            profiler::count("prosac iterations", t);
+
+            /*
+                Re-estimate the model with all inliers of the best
+                hypothesis using least squares
+            */
+            _countInliers(srcPoints, dstPoints, bestTransform, &inliers, &bestResidual);
+
+            cv::Matx33d refineTransform;
+            if (static_cast<int>(inliers.size()) > m &&
+                _fitLeastSquares(srcPoints, dstPoints, inliers, &refineTransform)) {
+
+                float refineResidual = 0.0f;
+                const int refineInliers = _countInliers(srcPoints, dstPoints, refineTransform, nullptr, &refineResidual);
+                if (refineInliers >= static_cast<int>(inliers.size())) {
+                    bestTransform = refineTransform;
+                    bestInliers   = refineInliers;
+                    bestResidual  = refineResidual;
+                }
+            }
+
+            imageAlignment.transform  = bestTransform;
+            imageAlignment.numInliers = std::max(bestInliers, 0);
+            imageAlignment.residual   = bestResidual;
+        }
+
+        imageAlignment.updateTranslation(images[n].cols, images[n + 1].size());
+
+        out_imageAlignments->push_back(imageAlignment);
+
+        _log().progress() << "\r    Progress of image matching: " << (n + 1) << "/" << numImageMatchings
+                          << std::flush;
+    }
+
+    _log().progress() << std::endl
+                      << "# Finish all image matchings, avg: "
+                      << (numAllIterations / static_cast<float>(std::max(numImageMatchings, 1))) << " iterations"
+                      << std::endl;
+}
+
+int ProsacImageMatcher::_sampleSize() const {
+    return (_model == Model::TRANSLATION) ? 1 :
+           (_model == Model::AFFINE)      ? 3 : 4;
+}
+
+bool ProsacImageMatcher::_fitMinimal(
+    const std::vector<cv::Point2f>& srcPoints,
+    const std::vector<cv::Point2f>& dstPoints,
+    const int* const                sample,
+    cv::Matx33d* const              out_transform) const {
+
+    if (_model == Model::TRANSLATION) {
+        const cv::Point2f move = dstPoints[sample[0]] - srcPoints[sample[0]];
+        *out_transform = mathUtils::getTranslationTransform(move.x, move.y);
+
+        return true;
+    }
+
+    const int m = _sampleSize();
+    cv::Point2f src[4];
+    cv::Point2f dst[4];
+    for (int i = 0; i < m; ++i) {
+        src[i] = srcPoints[sample[i]];
+        dst[i] = dstPoints[sample[i]];
+    }
+
+    /*
+        Reject degenerate samples in which
+        any three points are (nearly) collinear
+    */
+    for (int i = 0; i < m; ++i) {
+        for (int j = i + 1; j < m; ++j) {
+            for (int k = j + 1; k < m; ++k) {
+                const cv::Point2f a = src[j] - src[i];
+                const cv::Point2f b = src[k] - src[i];
+                if (std::abs(a.x * b.y - a.y * b.x) < 1.0f) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    cv::Matx33d transform = cv::Matx33d::eye();
+    if (_model == Model::AFFINE) {
+        const cv::Mat affine = cv::getAffineTransform(src, dst);
+        for (int r = 0; r < 2; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                transform(r, c) = affine.at<double>(r, c);
+            }
+        }
+    }
+    else {
+        const cv::Mat homography = cv::getPerspectiveTransform(src, dst);
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                transform(r, c) = homography.at<double>(r, c);
+            }
+        }
+
+        if (!std::isfinite(transform(2, 2)) || std::abs(transform(2, 2)) < 1e-8) {
+            return false;
+        }
+    }
+
+    *out_transform = transform;
+
+    return true;
+}
+
+bool ProsacImageMatcher::_fitLeastSquares(
+    const std::vector<cv::Point2f>& srcPoints,
+    const std::vector<cv::Point2f>& dstPoints,
+    const std::vector<int>&         indices,
+    cv::Matx33d* const              out_transform) const {
+
+    const int numPoints = static_cast<int>(indices.size());
+
+    if (_model == Model::TRANSLATION) {
+        cv::Point2f sumMove(0.0f, 0.0f);
+        for (auto& i : indices) {
+            sumMove += dstPoints[i] - srcPoints[i];
+        }
+        *out_transform = mathUtils::getTranslationTransform(sumMove.x / numPoints, sumMove.y / numPoints);
+
+        return true;
+    }
+
+    /*
+        Build linear system A * h = b
+
+        affine    : 6 unknowns (h00 h01 h02 h10 h11 h12)
+        homography: 8 unknowns with h22 = 1 (DLT)
+    */
+    const int numUnknowns = (_model == Model::AFFINE) ? 6 : 8;
+    cv::Mat A = cv::Mat::zeros(2 * numPoints, numUnknowns, CV_64FC1);
+    cv::Mat b = cv::Mat::zeros(2 * numPoints, 1, CV_64FC1);
+    for (int i = 0; i < numPoints; ++i) {
+        const double x = srcPoints[indices[i]].x;
+        const double y = srcPoints[indices[i]].y;
+        const double u = dstPoints[indices[i]].x;
+        const double v = dstPoints[indices[i]].y;
+
+        double* rowU = A.ptr<double>(2 * i);
+        double* rowV = A.ptr<double>(2 * i + 1);
+
+        rowU[0] = x; rowU[1] = y; rowU[2] = 1.0;
+        rowV[3] = x; rowV[4] = y; rowV[5] = 1.0;
+        if (_model == Model::HOMOGRAPHY) {
+            rowU[6] = -x * u; rowU[7] = -y * u;
+            rowV[6] = -x * v; rowV[7] = -y * v;
+        }
+
+        b.at<double>(2 * i)     = u;
+        b.at<double>(2 * i + 1) = v;
+    }
+
+    cv::Mat h;
+    if (!cv::solve(A, b, h, cv::DECOMP_SVD)) {
+        return false;
+    }
+
+    cv::Matx33d transform = cv::Matx33d::eye();
+    for (int i = 0; i < numUnknowns; ++i) {
+        transform(i / 3, i % 3) = h.at<double>(i);
+    }
+    *out_transform = transform;
+
+    return true;
+}
+
+int ProsacImageMatcher::_countInliers(
+    const std::vector<cv::Point2f>& srcPoints,
+    const std::vector<cv::Point2f>& dstPoints,
+    const cv::Matx33d&              transform,
+    std::vector<int>* const         out_inliers,
+    float* const                    out_residual) const {
+
+    if (out_inliers) {
+        out_inliers->clear();
+    }
+
+    int   numInliers  = 0;
+    float sumResidual = 0.0f;
+    for (std::size_t i = 0; i < srcPoints.size(); ++i) {
+        const cv::Point2f diff = dstPoints[i] - mathUtils::transformPoint(transform, srcPoints[i]);
+        const float dist = std::sqrt(diff.x * diff.x + diff.y * diff.y);
+        if (dist < _inlierThreshold) {
+            ++numInliers;
+            sumResidual += dist;
+
+            if (out_inliers) {
+                out_inliers->push_back(static_cast<int>(i));
+            }
+        }
+    }
+
+    *out_residual = (numInliers > 0) ? sumResidual / numInliers : 0.0f;
+
+    return numInliers;
+}
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "core/imageMatcher.h"
+
+namespace sis {
+
+/*
+    ProsacImageMatcher estimates a translation, affine or homography
+    transform for every image pair with PROSAC (progressive sample consensus).
+
+    Instead of drawing samples uniformly like RANSAC, PROSAC draws them
+    from a progressively larger set of the best feature matchings
+    (featureMatchings are sorted by quality), so it usually finds
+    a good hypothesis in far fewer iterations.
+*/
+class ProsacImageMatcher : public ImageMatcher {
+public:
+    enum class Model {
+        TRANSLATION,
+        AFFINE,
+        HOMOGRAPHY
+    };
+
+    ProsacImageMatcher();
+    ProsacImageMatcher(const Model model);
+    ProsacImageMatcher(const Model model,
+                       const float inlierThreshold,
+                       const int   maxIterations,
+                       const float confidence);
+
+private:
+    void _matchImpl(
+        const std::vector<cv::Mat>&                          images,
+        const std::vector<std::vector<cv::Point>>&           featurePositions,
+        const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
+        std::vector<ImageAlignment>* const                   out_imageAlignments) const override;
+
+    int _sampleSize() const;
+
+    bool _fitMinimal(
+        const std::vector<cv::Point2f>& srcPoints,
+        const std::vector<cv::Point2f>& dstPoints,
+        const int* const                sample,
+        cv::Matx33d* const              out_transform) const;
+
+    bool _fitLeastSquares(
+        const std::vector<cv::Point2f>& srcPoints,
+        const std::vector<cv::Point2f>& dstPoints,
+        const std::vector<int>&         indices,
+        cv::Matx33d* const              out_transform) const;
+
+    int _countInliers(
+        const std::vector<cv::Point2f>& srcPoints,
+        const std::vector<cv::Point2f>& dstPoints,
+        const cv::Matx33d&              transform,
+        std::vector<int>* const         out_inliers,
+        float* const                    out_residual) const;
+
+    Model _model;
+    float _inlierThreshold;
+    int   _maxIterations;
+    float _confidence;
+};
+
+} // namespace sis
\ No newline at end of file
@@ -8,16 +8,16 @@ namespace sis {
 
 RansacImageMatcher::RansacImageMatcher() = default;
 
-void RansacImageMatcher::match(
+void RansacImageMatcher::_matchImpl(
     const std::vector<cv::Mat>&                          images,
     const std::vector<std::vector<cv::Point>>&           featurePositions,
     const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
-    std::vector<cv::Point>* const                        out_imageAlignments) const {
+    std::vector<ImageAlignment>* const                   out_imageAlignments) const {
 
-    std::cout << "# Begin to match images between image pairs"
-              << std::endl
-              << "\r    Progress of image matching: 0/" << featureMatchings.size()
-              << std::flush;
+    _log().progress() << "# Begin to match images between image pairs"
+                      << std::endl
+                      << "\r    Progress of image matching: 0/" << featureMatchings.size()
+                      << std::flush;
 
     const int numImageMatchings = static_cast<int>(featureMatchings.size());
     out_imageAlignments->reserve(numImageMatchings);
@@ -34,7 +34,8 @@ void RansacImageMatcher::match(
                  ex. std::pair<int, int>(3, 10)
                      it means image2's feature 3 matches image1's feature 10
     */
-    const int K = 500;
+    const int   K               = 500;
+    const float inlierThreshold = 3.0f;
     for (int n = 0; n < numImageMatchings; ++n) {
         const std::vector<std::pair<int, int>>& matching = featureMatchings[n];
         const int numMatchings = static_cast<int>(matching.size());
@@ -115,15 +116,40 @@ void RansacImageMatcher::match(
             }
         }
 
-        out_imageAlignments->push_back(alignment);
+        profiler::count("ransac iterations", K);
 
-        std::cout << "\r    Progress of image matching: " << (n + 1) << "/" << numImageMatchings
-                  << std::flush;
+        /*
+            Count inliers of the best alignment, they are
+            used to judge the quality of this image pair
+        */
+        const cv::Point offset(images[n].cols, 0);
+
+        int   numInliers  = 0;
+        float sumResidual = 0.0f;
+        for (auto& pair : matching) {
+            const cv::Point pointDiff = feaPos1[pair.second] - (feaPos2[pair.first] + offset + alignment);
+            const float dist = std::sqrt(static_cast<float>(pointDiff.x * pointDiff.x + pointDiff.y * pointDiff.y));
+            if (dist < inlierThreshold) {
+                ++numInliers;
+                sumResidual += dist;
+            }
+        }
+
+        ImageAlignment imageAlignment;
+        imageAlignment.translation = alignment;
+        imageAlignment.transform   = mathUtils::getTranslationTransform(offset.x + alignment.x, alignment.y);
+        imageAlignment.numInliers  = numInliers;
+        imageAlignment.residual    = (numInliers > 0) ? sumResidual / numInliers : 0.0f;
+
+        out_imageAlignments->push_back(imageAlignment);
+
+        _log().progress() << "\r    Progress of image matching: " << (n + 1) << "/" << numImageMatchings
+                          << std::flush;
     }
 
-    std::cout << std::endl
-              << "# Finish all image matchings"
-              << std::endl;
+    _log().progress() << std::endl
+                      << "# Finish all image matchings"
+                      << std::endl;
 }
 
 } // namespace sis
\ No newline at end of file
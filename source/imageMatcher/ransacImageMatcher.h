@@ -8,11 +8,12 @@ class RansacImageMatcher : public ImageMatcher {
 public:
     RansacImageMatcher();
 
-    void match(
+private:
+    void _matchImpl(
         const std::vector<cv::Mat>&                          images,
         const std::vector<std::vector<cv::Point>>&           featurePositions,
         const std::vector<std::vector<std::pair<int, int>>>& featureMatchings,
-        std::vector<cv::Point>* const                        out_imageAlignments) const override;
+        std::vector<ImageAlignment>* const                   out_imageAlignments) const override;
 };
 
 } // namespace sis
\ No newline at end of file
@@ -4,7 +4,13 @@
 
 namespace sis {
 
-CylindricalImageWarpper::CylindricalImageWarpper() = default;
+CylindricalImageWarpper::CylindricalImageWarpper() :
+    CylindricalImageWarpper(std::make_shared<WarpTableCache>()) {
+}
+
+CylindricalImageWarpper::CylindricalImageWarpper(const std::shared_ptr<WarpTableCache>& tableCache) :
+    _tableCache(tableCache) {
+}
 
 void CylindricalImageWarpper::_warpImpl(
     const std::vector<cv::Mat>& images,
@@ -12,10 +18,10 @@ void CylindricalImageWarpper::_warpImpl(
     std::vector<cv::Mat>* const out_warpImages,
     std::vector<cv::Mat>* const out_warpImageIndices) const {
 
-    std::cout << "# Begin to warp images using cylindrical projection"
-              << std::endl
-              << "\r    Progress of cylindrical warpping: 0/" << images.size()
-              << std::flush;
+    _log().progress() << "# Begin to warp images using cylindrical projection"
+                      << std::endl
+                      << "\r    Progress of cylindrical warpping: 0/" << images.size()
+                      << std::flush;
 
     const std::size_t numImages = images.size();
     out_warpImages->reserve(numImages);
@@ -76,9 +82,19 @@ void CylindricalImageWarpper::_warpImpl(
 
             x = tan(x' / s) * f
             y = y' / s * sqrt(x^2 + f^2)
+
+            x and the scale of y' only depend on x', so they are
+            calculated once per column, and images of the same size
+            and focal length share these tables through the cache
         */
-        for (int iy = 0; iy < warpImage.rows; ++iy) {
-            for (int ix = 0; ix < warpImage.cols; ++ix) {
+        const int warpWidth = warpImage.cols;
+
+        const std::shared_ptr<const WarpTableCache::Table> table = _tableCache->find(
+            image.size(), f, [&](WarpTableCache::Table* const out_table) {
+
+            out_table->xOriginals.resize(warpWidth);
+            out_table->yScales.resize(warpWidth);
+            for (int ix = 0; ix < warpWidth; ++ix) {
                 /*
                     It needs to make image center be the origin,
                     so we need to substract center first, and why
@@ -86,19 +102,27 @@ void CylindricalImageWarpper::_warpImpl(
                     explained recently.
                 */
                 const float xCylindrical = static_cast<float>(ix + offset - xCenter);
-                const float yCylindrical = static_cast<float>(iy - yCenter);
+                const float xOriginal    = f * std::tan(xCylindrical * invS);
 
                 /*
                     Because y will use x to calculate, x needs to be
-                    calculated before y
+                    calculated before y, and center is added back later
                 */
-                float xOriginal = f * std::tan(xCylindrical * invS);
-                float yOriginal = std::sqrt(xOriginal * xOriginal + f * f) * invS * yCylindrical;
+                out_table->xOriginals[ix] = xOriginal + xCenter;
+                out_table->yScales[ix]    = std::sqrt(xOriginal * xOriginal + f * f) * invS;
+            }
+        });
+
+        for (int iy = 0; iy < warpImage.rows; ++iy) {
+            const float yCylindrical = static_cast<float>(iy - yCenter);
+
+            for (int ix = 0; ix < warpImage.cols; ++ix) {
+                const float xOriginal = table->xOriginals[ix];
+                float       yOriginal = table->yScales[ix] * yCylindrical;
 
                 /*
                     Add center back
                 */
-                xOriginal += xCenter;
                 yOriginal += yCenter;
 
                 if (_isOutOfBound(xOriginal, yOriginal, width, height)) {
@@ -132,13 +156,13 @@ void CylindricalImageWarpper::_warpImpl(
         out_warpImages->push_back(warpImage);
         out_warpImageIndices->push_back(warpImageIndex);
 
-        std::cout << "\r    Progress of cylindrical warpping: " << (n + 1) << "/" << numImages
-                  << std::flush;
+        _log().progress() << "\r    Progress of cylindrical warpping: " << (n + 1) << "/" << numImages
+                          << std::flush;
     }
 
-    std::cout << std::endl
-              << "# Finish image warpping"
-              << std::endl;
+    _log().progress() << std::endl
+                      << "# Finish image warpping"
+                      << std::endl;
 }
 
 bool CylindricalImageWarpper::_isOutOfBound(const float x,
@@ -1,12 +1,16 @@
 #pragma once
 
 #include "core/imageWarpper.h"
+#include "core/warpTableCache.h"
+
+#include <memory>
 
 namespace sis {
 
 class CylindricalImageWarpper : public ImageWarpper {
 public:
     CylindricalImageWarpper();
+    CylindricalImageWarpper(const std::shared_ptr<WarpTableCache>& tableCache);
 
 private:
     void _warpImpl(
@@ -19,6 +23,9 @@ private:
                        const float y,
                        const int   width,
                        const int   height) const;
+
+    // inverse warp tables by (image size, focal length)
+    std::shared_ptr<WarpTableCache> _tableCache;
 };
 
 } // namespace sis
\ No newline at end of file
@@ -1,11 +1,52 @@
 #include "commandArgument.h"
+#include "core/batchStitcher.h"
 #include "core/imageStitcher.h"
+#include "core/stitchDaemon.h"
+#include "core/profiler.h"
+#include "panoramaSink/tiffPanoramaSink.h"
 
+#include <cstddef>
+#include <exception>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace sis;
 
+namespace {
+
+// returns false if value isn't a whole number in [minNumber, maxNumber] (ex. "x" or "1G")
+bool parseNumber(
+    const std::string&       value,
+    const unsigned long long minNumber,
+    const unsigned long long maxNumber,
+    unsigned long long* const out_number) {
+
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+
+    try {
+        *out_number = std::stoull(value);
+    }
+    catch (const std::out_of_range&) {
+        return false;
+    }
+
+    return *out_number >= minNumber && *out_number <= maxNumber;
+}
+
+void printUsageError(const std::string& option, const std::string& value) {
+    std::cout << "Invalid " << option << ": <" << value << ">, "
+              << "Image-Stitching -h for further information."
+              << std::endl;
+}
+
+} // anonymous namespace
+
 int main(int argc, char* argv[]) {
     if (argc == 1) {
         std::cout << "Image-Stitching -h for further information."
@@ -21,14 +62,115 @@ int main(int argc, char* argv[]) {
         return EXIT_SUCCESS;
     }
 
-    std::cout << "Image-Stitching, copyright (c)2019-2020 Chia-Yu Chou\n"
-              << std::endl;
+    // stdout of a stdio daemon only carries events
+    const std::string daemonSocket = args.find("daemonSocket");
+    if (daemonSocket != "-") {
+        std::cout << "Image-Stitching, copyright (c)2019-2020 Chia-Yu Chou\n"
+                  << std::endl;
+    }
+
+    const std::string outputFilename = args.find("outputFilename", "./result/panorama_result.png");
+
+    const std::string traceFilename   = args.find("traceFilename");
+    const std::string summaryFilename = args.find("summaryFilename");
+    profiler::setEnabled(!traceFilename.empty() || !summaryFilename.empty());
+
+    const std::string  numThreads = args.find("numThreads");
+    unsigned long long numWorkers = 0;
+    if (!numThreads.empty() && !parseNumber(numThreads, 1, std::numeric_limits<int>::max(), &numWorkers)) {
+        printUsageError("-t <num>", numThreads);
+
+        return EXIT_FAILURE;
+    }
 
-    cv::Mat panorama;
-    ImageStitcher imageStitcher(args);
+    int exitCode = EXIT_SUCCESS;
 
-    imageStitcher.solve(&panorama);
-    cv::imwrite("./result/panorama_result.png", panorama);
+    const std::string batchManifest = args.find("batchManifest");
+    if (!daemonSocket.empty()) {
+        const std::string  maxConcurrentJobs = args.find("maxConcurrentJobs", "1");
+        unsigned long long numJobs           = 0;
+        if (!parseNumber(maxConcurrentJobs, 1, std::numeric_limits<int>::max(), &numJobs)) {
+            printUsageError("-j <num>", maxConcurrentJobs);
+
+            return EXIT_FAILURE;
+        }
+
+        // stdout of a stdio daemon only carries events, so its messages go to stderr
+        const Logger daemonLogger = (daemonSocket == "-") ?
+                                    Logger(nullptr, &std::cerr) : Logger::console();
+
+        StitchDaemon daemon(static_cast<int>(numJobs), daemonLogger);
+        if (daemonSocket == "-") {
+            daemon.serveStdio();
+        }
+        else if (!daemon.serveSocket(daemonSocket)) {
+            exitCode = EXIT_FAILURE;
+        }
+    }
+    else if (!batchManifest.empty()) {
+        const std::string  maxConcurrentJobs = args.find("maxConcurrentJobs", std::to_string(std::thread::hardware_concurrency()));
+        unsigned long long numJobs           = 0;
+        if (!parseNumber(maxConcurrentJobs, 1, std::numeric_limits<int>::max(), &numJobs)) {
+            printUsageError("-j <num>", maxConcurrentJobs);
+
+            return EXIT_FAILURE;
+        }
+
+        // in MB, so the budget in bytes doesn't overflow
+        const std::string  jobMemoryBudget = args.find("jobMemoryBudget", "0");
+        unsigned long long memoryBudget    = 0;
+        if (!parseNumber(jobMemoryBudget, 0, std::numeric_limits<std::size_t>::max() / (1024 * 1024), &memoryBudget)) {
+            printUsageError("-mem <MB>", jobMemoryBudget);
+
+            return EXIT_FAILURE;
+        }
+
+        std::vector<BatchStitcher::Job> jobs;
+        if (!BatchStitcher::readManifest(batchManifest, &jobs)) {
+            return EXIT_FAILURE;
+        }
+
+        const BatchStitcher batchStitcher(static_cast<int>(numJobs), static_cast<std::size_t>(memoryBudget) * 1024 * 1024);
+        if (batchStitcher.run(jobs) > 0) {
+            exitCode = EXIT_FAILURE;
+        }
+    }
+    else {
+        try {
+            ImageStitcher imageStitcher(args);
+
+            // TIFF output is streamed strip by strip,
+            // the whole panorama is never kept in memory
+            const std::size_t extensionPos = outputFilename.find_last_of('.');
+            const std::string extension    = (extensionPos == std::string::npos) ?
+                                             "" : outputFilename.substr(extensionPos);
+
+            if (extension == ".tif" || extension == ".tiff") {
+                TiffPanoramaSink sink(outputFilename);
+                imageStitcher.solve(&sink);
+            }
+            else {
+                cv::Mat panorama;
+                imageStitcher.solve(&panorama);
+                cv::imwrite(outputFilename, panorama);
+            }
+        }
+        catch (const std::exception& exception) {
+            std::cout << exception.what()
+                      << std::endl;
+
+            exitCode = EXIT_FAILURE;
+        }
+    }
+
+    if (!traceFilename.empty() && !profiler::writeChromeTrace(traceFilename)) {
+        std::cout << "Cannot write trace file: " << traceFilename
+                  << std::endl;
+    }
+    if (!summaryFilename.empty() && !profiler::writeSummary(summaryFilename)) {
+        std::cout << "Cannot write summary file: " << summaryFilename
+                  << std::endl;
+    }
 
-    return EXIT_SUCCESS;
+    return exitCode;
 }
\ No newline at end of file
@@ -29,11 +29,28 @@ inline void getTranslationMatrix(int            tx,
     *out_mat = mat;
 }
 
+inline cv::Matx33d getTranslationTransform(const double tx,
+                                           const double ty) {
+
+    return cv::Matx33d(1.0, 0.0, tx,
+                       0.0, 1.0, ty,
+                       0.0, 0.0, 1.0);
+}
+
+inline cv::Point2f transformPoint(const cv::Matx33d& transform,
+                                  const cv::Point2f& point) {
+
+    const double x = transform(0, 0) * point.x + transform(0, 1) * point.y + transform(0, 2);
+    const double y = transform(1, 0) * point.x + transform(1, 1) * point.y + transform(1, 2);
+    const double w = transform(2, 0) * point.x + transform(2, 1) * point.y + transform(2, 2);
+
+    return cv::Point2f(static_cast<float>(x / w), static_cast<float>(y / w));
+}
 
-static std::random_device rd;
 
 inline int nextInt(const int min, const int max) {
-    std::default_random_engine generator = std::default_random_engine(rd());
+    // one engine per thread, image pairs may be matched concurrently
+    thread_local std::default_random_engine generator(std::random_device{}());
 
     std::uniform_int_distribution<int> distribution(min, max - 1);
 
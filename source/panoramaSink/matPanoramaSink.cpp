@@ -0,0 +1,29 @@
+#include "panoramaSink/matPanoramaSink.h"
+
+namespace sis {
+
+MatPanoramaSink::MatPanoramaSink(cv::Mat* const out_panorama) :
+    MatPanoramaSink(out_panorama, 256) {
+}
+
+MatPanoramaSink::MatPanoramaSink(cv::Mat* const out_panorama, const int stripWidth) :
+    _panorama(out_panorama),
+    _stripWidth(stripWidth) {
+}
+
+void MatPanoramaSink::begin(const cv::Size& panoramaSize) {
+    *_panorama = cv::Mat::zeros(panoramaSize, CV_8UC3);
+}
+
+void MatPanoramaSink::write(const cv::Mat& strip, const int stripX) {
+    strip.copyTo((*_panorama)(cv::Rect(stripX, 0, strip.cols, strip.rows)));
+}
+
+void MatPanoramaSink::end() {
+}
+
+int MatPanoramaSink::stripWidth() const {
+    return _stripWidth;
+}
+
+} // namespace sis
\ No newline at end of file
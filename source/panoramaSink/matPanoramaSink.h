@@ -0,0 +1,27 @@
+#pragma once
+
+#include "core/panoramaSink.h"
+
+namespace sis {
+
+/*
+    MatPanoramaSink collects strips into an in-memory panorama,
+    it lets streaming producers output a cv::Mat.
+*/
+class MatPanoramaSink : public PanoramaSink {
+public:
+    MatPanoramaSink(cv::Mat* const out_panorama);
+    MatPanoramaSink(cv::Mat* const out_panorama, const int stripWidth);
+
+    void begin(const cv::Size& panoramaSize) override;
+    void write(const cv::Mat& strip, const int stripX) override;
+    void end() override;
+
+    int stripWidth() const override;
+
+private:
+    cv::Mat* _panorama;
+    int      _stripWidth;
+};
+
+} // namespace sis
\ No newline at end of file
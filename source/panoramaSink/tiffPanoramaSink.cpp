@@ -0,0 +1,214 @@
+#include "panoramaSink/tiffPanoramaSink.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace sis {
+
+TiffPanoramaSink::TiffPanoramaSink(const std::string& filename) :
+    TiffPanoramaSink(filename, 256) {
+}
+
+TiffPanoramaSink::TiffPanoramaSink(const std::string& filename, const int tileSize) :
+    _filename(filename),
+    _tileSize(tileSize),
+    _file(),
+    _panoramaSize(),
+    _numTilesAcross(0),
+    _numTilesDown(0),
+    _isBigTiff(false),
+    _tileOffsets() {
+}
+
+void TiffPanoramaSink::begin(const cv::Size& panoramaSize) {
+    _panoramaSize   = panoramaSize;
+    _numTilesAcross = (panoramaSize.width  + _tileSize - 1) / _tileSize;
+    _numTilesDown   = (panoramaSize.height + _tileSize - 1) / _tileSize;
+
+    /*
+        Classic TIFF uses 32-bit offsets, if tiles (and some
+        space for directory) don't fit in 4GB, use BigTIFF
+    */
+    const std::uint64_t numTiles  = static_cast<std::uint64_t>(_numTilesAcross) * _numTilesDown;
+    const std::uint64_t tileBytes = static_cast<std::uint64_t>(_tileSize) * _tileSize * 3;
+    const std::uint64_t fileBytes = numTiles * tileBytes + numTiles * 16 + 1024;
+    _isBigTiff = fileBytes > 0xFFFFFFFFull;
+
+    _tileOffsets.assign(numTiles, 0);
+
+    _file.open(_filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!_file) {
+        throw std::runtime_error("Panorama file can't open: " + _filename);
+    }
+
+    /*
+        Header, offset of image directory is
+        patched when the panorama ends
+
+        TIFF   : "II" 42 offset(32-bit)
+        BigTIFF: "II" 43 8 0 offset(64-bit)
+    */
+    _file.write("II", 2);
+    if (_isBigTiff) {
+        _writeValue(43, 2);
+        _writeValue(8, 2);
+        _writeValue(0, 2);
+        _writeValue(0, 8);
+    }
+    else {
+        _writeValue(42, 2);
+        _writeValue(0, 4);
+    }
+
+    _checkFile();
+}
+
+void TiffPanoramaSink::write(const cv::Mat& strip, const int stripX) {
+    const int tileX = stripX / _tileSize;
+
+    /*
+        Cut strip into tiles, tiles at right and bottom
+        borders are padded with black pixels
+
+        Remain: TIFF stores RGB, and OpenCV stores BGR
+    */
+    std::vector<char> tile(static_cast<std::size_t>(_tileSize) * _tileSize * 3);
+    for (int tileY = 0; tileY < _numTilesDown; ++tileY) {
+        std::fill(tile.begin(), tile.end(), 0);
+
+        const int beginY = tileY * _tileSize;
+        const int endY   = std::min(beginY + _tileSize, strip.rows);
+        const int width  = std::min(strip.cols, _tileSize);
+        for (int y = beginY; y < endY; ++y) {
+            const uchar* stripRow = strip.ptr<uchar>(y);
+            char*        tileRow  = tile.data() + static_cast<std::size_t>(y - beginY) * _tileSize * 3;
+
+            for (int x = 0; x < width; ++x) {
+                tileRow[3 * x]     = static_cast<char>(stripRow[3 * x + 2]);
+                tileRow[3 * x + 1] = static_cast<char>(stripRow[3 * x + 1]);
+                tileRow[3 * x + 2] = static_cast<char>(stripRow[3 * x]);
+            }
+        }
+
+        _tileOffsets[static_cast<std::size_t>(tileY) * _numTilesAcross + tileX] =
+            static_cast<std::uint64_t>(_file.tellp());
+        _file.write(tile.data(), tile.size());
+    }
+
+    // ex. disk is full, a truncated panorama must not be reported as success
+    _checkFile();
+}
+
+void TiffPanoramaSink::end() {
+    const std::uint64_t ifdOffset = static_cast<std::uint64_t>(_file.tellp());
+
+    /*
+        Image directory, entries need to be sorted by tag.
+        Values which don't fit in an entry are stored
+        in extraData right after the directory.
+    */
+    const std::uint16_t SHORT = 3;
+    const std::uint16_t LONG  = 4;
+    const std::uint16_t LONG8 = 16;
+
+    const std::uint16_t offsetType = _isBigTiff ? LONG8 : LONG;
+    const std::uint64_t tileBytes  = static_cast<std::uint64_t>(_tileSize) * _tileSize * 3;
+
+    const int numEntries = 11;
+    const std::uint64_t ifdSize = _isBigTiff ?
+                                  8 + 20 * numEntries + 8 :
+                                  2 + 12 * numEntries + 4;
+
+    _writeValue(numEntries, _isBigTiff ? 8 : 2);
+
+    std::vector<char> extraData;
+    const std::uint64_t extraDataOffset = ifdOffset + ifdSize;
+    _writeEntry(256, LONG,  { static_cast<std::uint64_t>(_panoramaSize.width) },  &extraData, extraDataOffset); // ImageWidth
+    _writeEntry(257, LONG,  { static_cast<std::uint64_t>(_panoramaSize.height) }, &extraData, extraDataOffset); // ImageLength
+    _writeEntry(258, SHORT, { 8, 8, 8 },                                          &extraData, extraDataOffset); // BitsPerSample
+    _writeEntry(259, SHORT, { 1 },                                                &extraData, extraDataOffset); // Compression: none
+    _writeEntry(262, SHORT, { 2 },                                                &extraData, extraDataOffset); // Photometric: RGB
+    _writeEntry(277, SHORT, { 3 },                                                &extraData, extraDataOffset); // SamplesPerPixel
+    _writeEntry(284, SHORT, { 1 },                                                &extraData, extraDataOffset); // PlanarConfig: chunky
+    _writeEntry(322, LONG,  { static_cast<std::uint64_t>(_tileSize) },            &extraData, extraDataOffset); // TileWidth
+    _writeEntry(323, LONG,  { static_cast<std::uint64_t>(_tileSize) },            &extraData, extraDataOffset); // TileLength
+    _writeEntry(324, offsetType, _tileOffsets,                                    &extraData, extraDataOffset); // TileOffsets
+    _writeEntry(325, offsetType, std::vector<std::uint64_t>(_tileOffsets.size(), tileBytes),
+                &extraData, extraDataOffset);                                                                   // TileByteCounts
+
+    // no next directory
+    _writeValue(0, _isBigTiff ? 8 : 4);
+
+    _file.write(extraData.data(), extraData.size());
+    _checkFile();
+
+    /*
+        Patch offset of image directory in header
+    */
+    _file.seekp(_isBigTiff ? 8 : 4);
+    _writeValue(ifdOffset, _isBigTiff ? 8 : 4);
+    _checkFile();
+
+    // buffered data is written when closing, so it can fail too
+    _file.close();
+    _checkFile();
+}
+
+int TiffPanoramaSink::stripWidth() const {
+    return _tileSize;
+}
+
+void TiffPanoramaSink::_checkFile() const {
+    if (!_file) {
+        throw std::runtime_error("Panorama file can't write: " + _filename);
+    }
+}
+
+void TiffPanoramaSink::_writeValue(const std::uint64_t value, const int numBytes) {
+    // TIFF file uses little-endian ("II")
+    char bytes[8];
+    for (int i = 0; i < numBytes; ++i) {
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+
+    _file.write(bytes, numBytes);
+}
+
+void TiffPanoramaSink::_writeEntry(
+    const std::uint16_t               tag,
+    const std::uint16_t               type,
+    const std::vector<std::uint64_t>& values,
+    std::vector<char>* const          out_extraData,
+    const std::uint64_t               extraDataOffset) {
+
+    const int typeSize   = (type == 3) ? 2 : (type == 4) ? 4 : 8;
+    const int inlineSize = _isBigTiff ? 8 : 4;
+
+    _writeValue(tag, 2);
+    _writeValue(type, 2);
+    _writeValue(values.size(), inlineSize);
+
+    const std::uint64_t valueBytes = values.size() * typeSize;
+    if (valueBytes <= static_cast<std::uint64_t>(inlineSize)) {
+        for (auto& value : values) {
+            _writeValue(value, typeSize);
+        }
+        _writeValue(0, inlineSize - static_cast<int>(valueBytes));
+    }
+    else {
+        _writeValue(extraDataOffset + out_extraData->size(), inlineSize);
+
+        for (auto& value : values) {
+            for (int i = 0; i < typeSize; ++i) {
+                out_extraData->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+            }
+        }
+
+        // keep following values word-aligned
+        if (out_extraData->size() % 2 != 0) {
+            out_extraData->push_back(0);
+        }
+    }
+}
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "core/panoramaSink.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace sis {
+
+/*
+    TiffPanoramaSink encodes panorama to an uncompressed tiled TIFF file
+    incrementally. Each strip is one column of tiles, tiles are written
+    as soon as they arrive, and tile offsets are written with the
+    image directory when the panorama ends.
+
+    It switches to BigTIFF automatically if the file would be
+    larger than 4GB. Failed writes (ex. disk is full) throw
+    std::runtime_error.
+*/
+class TiffPanoramaSink : public PanoramaSink {
+public:
+    TiffPanoramaSink(const std::string& filename);
+    TiffPanoramaSink(const std::string& filename, const int tileSize);
+
+    void begin(const cv::Size& panoramaSize) override;
+    void write(const cv::Mat& strip, const int stripX) override;
+    void end() override;
+
+    int stripWidth() const override;
+
+private:
+    // throws std::runtime_error if any write to file failed
+    void _checkFile() const;
+
+    void _writeValue(const std::uint64_t value, const int numBytes);
+
+    void _writeEntry(
+        const std::uint16_t               tag,
+        const std::uint16_t               type,
+        const std::vector<std::uint64_t>& values,
+        std::vector<char>* const          out_extraData,
+        const std::uint64_t               extraDataOffset);
+
+    std::string   _filename;
+    int           _tileSize;
+    std::ofstream _file;
+
+    cv::Size _panoramaSize;
+    int      _numTilesAcross;
+    int      _numTilesDown;
+    bool     _isBigTiff;
+
+    std::vector<std::uint64_t> _tileOffsets;
+};
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "stitch.h"
+
+#include "commandArgument.h"
+#include "core/imageStitcher.h"
+#include "core/logger.h"
+
+#include <exception>
+
+namespace sis {
+
+bool stitch(
+    const std::vector<cv::Mat>&                         images,
+    const std::vector<float>&                           focalLengths,
+    cv::Mat* const                                      out_panorama,
+    const std::unordered_map<std::string, std::string>& options,
+    std::ostream* const                                 logStream) {
+
+    const Logger logger(logStream, logStream);
+
+    if (images.size() < 2 || images.size() != focalLengths.size()) {
+        logger.warning() << "Stitching needs at least two images, each with a focal length !"
+                         << std::endl;
+
+        return false;
+    }
+
+    for (const auto& image : images) {
+        if (image.empty() || image.type() != CV_8UC3) {
+            logger.warning() << "Images need to be non-empty 8-bit BGR images !"
+                             << std::endl;
+
+            return false;
+        }
+    }
+
+    CommandArgument arguments;
+    for (const auto& option : options) {
+        arguments.insert(option.first, option.second);
+    }
+
+    // nothing is thrown across the library boundary
+    try {
+        const ImageStitcher imageStitcher(images, focalLengths, arguments, logger);
+        imageStitcher.solve(out_panorama);
+    }
+    catch (const std::exception& exception) {
+        logger.warning() << "Stitching fails: " << exception.what()
+                         << std::endl;
+
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace sis
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sis {
+
+/*
+    In-memory entry of the library, images (LEFT-TO-RIGHT) and their
+    focal lengths are stitched into out_panorama, and no file is read
+    or written (except debug images enabled by "debugImages" option).
+
+    options  : the same keys as command line arguments use
+               Ex. { { "imageBlender", "multiband" }, { "numThreads", "4" } }
+
+    logStream: progress, warnings and errors are written to it,
+               nullptr drops them
+
+    It doesn't throw, it returns false if inputs are invalid or
+    stitching fails (ex. an invalid option value or an OpenCV error),
+    and the reason is written to logStream.
+*/
+bool stitch(
+    const std::vector<cv::Mat>&                         images,
+    const std::vector<float>&                           focalLengths,
+    cv::Mat* const                                      out_panorama,
+    const std::unordered_map<std::string, std::string>& options   = {},
+    std::ostream* const                                 logStream = &std::cout);
+
+} // namespace sis
\ No newline at end of file